@@ -0,0 +1,69 @@
+#include "alias-table.h"
+
+AliasTable::AliasTable(const std::vector<float>& weights) :
+	m_bins(weights.size())
+{
+	const size_t n = weights.size();
+	assert(n > 0 && L"Alias table needs at least one entry");
+
+	double sum = 0.0;
+	for (float w : weights)
+	{
+		sum += w;
+	}
+
+	m_totalWeight = static_cast<float>(sum);
+
+	// Scaled probabilities; a degenerate (all zero) distribution falls back to uniform
+	std::vector<double> scaled(n);
+	for (size_t i = 0; i < n; ++i)
+	{
+		const double pmf = sum > 0.0 ? weights[i] / sum : 1.0 / n;
+		m_bins[i].pmf = static_cast<float>(pmf);
+		scaled[i] = pmf * n;
+	}
+
+	std::vector<uint32_t> small, large;
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		(scaled[i] < 1.0 ? small : large).push_back(i);
+	}
+
+	while (!small.empty() && !large.empty())
+	{
+		const uint32_t s = small.back();
+		small.pop_back();
+		const uint32_t l = large.back();
+
+		m_bins[s].probability = static_cast<float>(scaled[s]);
+		m_bins[s].alias = l;
+
+		scaled[l] -= (1.0 - scaled[s]);
+		if (scaled[l] < 1.0)
+		{
+			large.pop_back();
+			small.push_back(l);
+		}
+	}
+
+	// Leftovers are 1 up to rounding error
+	for (uint32_t i : small)
+	{
+		m_bins[i].probability = 1.f;
+		m_bins[i].alias = i;
+	}
+
+	for (uint32_t i : large)
+	{
+		m_bins[i].probability = 1.f;
+		m_bins[i].alias = i;
+	}
+}
+
+uint32_t AliasTable::Sample(float uIndex, float uAlias) const
+{
+	const auto index = std::min(static_cast<uint32_t>(uIndex * m_bins.size()), static_cast<uint32_t>(m_bins.size() - 1));
+
+	const Bin& bin = m_bins[index];
+	return uAlias < bin.probability ? index : bin.alias;
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "stdafx.h"
+
+// Walker/Vose alias table. Draws an index from a discrete distribution in O(1) using two uniform numbers.
+class AliasTable
+{
+public:
+	AliasTable() = default;
+	explicit AliasTable(const std::vector<float>& weights);
+
+	// uIndex picks the bin and uAlias decides between the bin and its alias. Splitting one float between the two
+	// would leave the coin too few bits in large tables, and the drawn distribution would drift from GetPmf().
+	uint32_t Sample(float uIndex, float uAlias) const;
+	float GetPmf(uint32_t index) const { return m_bins[index].pmf; }
+	size_t GetSize() const { return m_bins.size(); }
+	float GetTotalWeight() const { return m_totalWeight; }
+
+private:
+	struct Bin
+	{
+		float probability;	// probability of keeping this bin rather than jumping to the alias
+		uint32_t alias;
+		float pmf;
+	};
+
+	std::vector<Bin> m_bins;
+	float m_totalWeight = 0.f;
+};
\ No newline at end of file
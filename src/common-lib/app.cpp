@@ -1,10 +1,32 @@
 #include "app.h"
 #include "ray-tracing.h"
 
-LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
+LRESULT CALLBACK RayTracingApp::WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
 {
+	auto* app = reinterpret_cast<RayTracingApp*>(GetWindowLongPtr(hWnd, GWLP_USERDATA));
+
 	switch (msg)
 	{
+	case WM_PAINT:
+		if (app)
+		{
+			app->Present(hWnd);
+			return 0;
+		}
+		break;
+
+	case WM_LBUTTONDOWN:
+		if (app)
+		{
+			app->OnClick(static_cast<short>(LOWORD(lParam)), static_cast<short>(HIWORD(lParam)));
+			return 0;
+		}
+		break;
+
+	case WM_ERASEBKGND:
+		// The bitmap covers the client area
+		return 1;
+
 	case WM_DESTROY:
 		PostQuitMessage(0);
 		return 0;
@@ -28,14 +50,18 @@ void RayTracingApp::Initialize(HINSTANCE instanceHandle, int show)
 	desc.lpszClassName = L"Raytracing";
 	RegisterClass(&desc);
 
+	// The window size includes the frame and title bar; the client area is what shows the backbuffer
+	RECT windowRect{ 0, 0, GetBackBufferWidth(), GetBackBufferHeight() };
+	AdjustWindowRect(&windowRect, WS_OVERLAPPEDWINDOW, FALSE);
+
 	m_wndHandle = CreateWindow(
 		L"Raytracing",
 		L"Demo",
 		WS_OVERLAPPEDWINDOW,
 		CW_USEDEFAULT,
 		CW_USEDEFAULT,
-		GetBackBufferWidth(),
-		GetBackBufferHeight(),
+		windowRect.right - windowRect.left,
+		windowRect.bottom - windowRect.top,
 		nullptr,
 		nullptr,
 		instanceHandle,
@@ -51,30 +77,77 @@ void RayTracingApp::Initialize(HINSTANCE instanceHandle, int show)
 	InitBuffers();
 
 	OnInitialize(m_wndHandle);
+
+	// Paint messages present only once Direct2D and the app are ready
+	SetWindowLongPtr(m_wndHandle, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(this));
+}
+
+void RayTracingApp::InitializeHeadless()
+{
+	m_wndHandle = nullptr;
+
+	InitBuffers();
+	OnInitialize(nullptr);
 }
 
 int RayTracingApp::Run() noexcept
 {
+	// The UI thread only handles messages and presents; tracing the next pass overlaps presenting the last one
+	const HWND hWnd = m_wndHandle;
+	m_renderLoop.Start(
+		GetBackBufferWidth(),
+		GetBackBufferHeight(),
+		GetPresentInterval(),
+		[this](XMCOLOR* ldr) { OnRenderPass(ldr); },
+		[hWnd]() { InvalidateRect(hWnd, nullptr, FALSE); });
+
 	MSG msg = { nullptr };
 
-	while (msg.message != WM_QUIT)
+	while (GetMessage(&msg, nullptr, 0, 0) > 0)
 	{
-		if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
-		{
-			TranslateMessage(&msg);
-			DispatchMessage(&msg);
-		}
-		else
-		{
-			OnRender(m_wndHandle);
-			InvalidateRect(m_wndHandle, nullptr, FALSE);
-			UpdateWindow(m_wndHandle);
-		}
+		TranslateMessage(&msg);
+		DispatchMessage(&msg);
 	}
 
+	// Cancel the pass in flight before the app is destroyed
+	m_renderLoop.Stop();
+
 	return static_cast<int>(msg.wParam);
 }
 
+void RayTracingApp::Present(HWND hWnd)
+{
+	PAINTSTRUCT ps;
+	BeginPaint(hWnd, &ps);
+
+	// Without a new image the bitmap still holds the last one, e.g. when the window was uncovered
+	const XMCOLOR* image = m_renderLoop.AcquireLatest();
+	bool copied = false;
+	if (image)
+	{
+		// A destination rect outside the bitmap fails the whole copy, so only the part that fits is copied
+		const D2D1_SIZE_U bitmapSize = m_backbufferBitmap->GetPixelSize();
+		const D2D1_RECT_U rect = D2D1::RectU(0, 0,
+			std::min(bitmapSize.width, static_cast<UINT32>(GetBackBufferWidth())),
+			std::min(bitmapSize.height, static_cast<UINT32>(GetBackBufferHeight())));
+		const HRESULT hr = m_backbufferBitmap->CopyFromMemory(&rect, image, sizeof(XMCOLOR) * GetBackBufferWidth());
+		copied = SUCCEEDED(hr);
+	}
+
+	m_renderTarget->BeginDraw();
+	m_renderTarget->Clear(D2D1::ColorF(D2D1::ColorF::SkyBlue));
+	m_renderTarget->DrawBitmap(m_backbufferBitmap.Get());
+	m_renderTarget->EndDraw();
+
+	EndPaint(hWnd, &ps);
+
+	// Stats describe the image on screen
+	if (copied)
+	{
+		OnPresent(hWnd);
+	}
+}
+
 void RayTracingApp::InitDirect2D(HWND hWnd) noexcept
 {
 	// Factory
@@ -95,7 +168,7 @@ void RayTracingApp::InitDirect2D(HWND hWnd) noexcept
 
 	assert(hr == S_OK);
 
-	// Bitmap
+	// Bitmap at the backbuffer size, so every image fits even when the window could not get a client area that large
 	FLOAT dpiX, dpiY;
 	m_d2dFactory->GetDesktopDpi(&dpiX, &dpiY);
 
@@ -105,15 +178,23 @@ void RayTracingApp::InitDirect2D(HWND hWnd) noexcept
 	desc.dpiX = dpiX;
 	desc.dpiY = dpiY;
 
-	hr = m_renderTarget->CreateBitmap(size, desc, m_backbufferBitmap.GetAddressOf());
+	hr = m_renderTarget->CreateBitmap(D2D1::SizeU(GetBackBufferWidth(), GetBackBufferHeight()), desc, m_backbufferBitmap.GetAddressOf());
 	assert(hr == S_OK);
 }
 
-void RayTracingApp::InitBuffers()
+bool RayTracingApp::ShareFramebuffer(const std::wstring& name)
 {
-	m_backbufferHdr.resize(GetBackBufferWidth() * GetBackBufferHeight());
-	std::fill(m_backbufferHdr.begin(), m_backbufferHdr.end(), XM_Zero);
+	if (!m_sharedFramebuffer.Create(name, GetBackBufferWidth(), GetBackBufferHeight()))
+	{
+		return false;
+	}
+
+	m_renderLoop.ShareImages(&m_sharedFramebuffer);
+	return true;
+}
 
-	m_backbufferLdr.resize(GetBackBufferWidth() * GetBackBufferHeight());
-	std::fill(m_backbufferLdr.begin(), m_backbufferLdr.end(), 0);
+void RayTracingApp::InitBuffers()
+{
+	// Left for the app to clear from its render threads, see Framebuffer
+	m_backbufferHdr.Resize(GetBackBufferWidth(), GetBackBufferHeight());
 }
\ No newline at end of file
@@ -1,30 +1,48 @@
 #pragma once
 
 #include "stdafx.h"
+#include "framebuffer.h"
+#include "render-loop.h"
 
 class RayTracingApp
 {
 public:
 	virtual void Initialize(HINSTANCE instanceHandle, int show);
+	// Buffers and scene without a window or Direct2D, for runs that drive m_renderLoop themselves
+	virtual void InitializeHeadless();
 	virtual int Run() noexcept;
 
 protected:
 	virtual void OnInitialize(HWND hWnd) = 0;
-	virtual void OnRender(HWND hWnd) = 0;
+	// Render thread: one pass of m_renderLoop, see RenderLoop::PassFunction
+	virtual void OnRenderPass(XMCOLOR* ldr) = 0;
+	// UI thread, after the newest image was drawn to the window
+	virtual void OnPresent(HWND hWnd) = 0;
 	virtual int GetBackBufferWidth() const = 0;
 	virtual int GetBackBufferHeight() const = 0;
+	virtual std::chrono::milliseconds GetPresentInterval() const = 0;
+	// UI thread, client coordinates of a left click
+	virtual void OnClick(int x, int y) {}
 
 private:
+	static LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
+
 	void InitDirect2D(HWND hWnd) noexcept;
 	void InitBuffers();
+	void Present(HWND hWnd);
+
+protected:
+	// Publishes the display images in a named shared section as well, e.g. for watching a headless render
+	bool ShareFramebuffer(const std::wstring& name);
 
 protected:
 	Microsoft::WRL::ComPtr<ID2D1Factory> m_d2dFactory;
 	Microsoft::WRL::ComPtr<ID2D1Bitmap> m_backbufferBitmap;
 	Microsoft::WRL::ComPtr<ID2D1HwndRenderTarget> m_renderTarget;
 
-	std::vector<XMVECTOR> m_backbufferHdr;
-	std::vector<PackedVector::XMCOLOR> m_backbufferLdr;
+	Framebuffer m_backbufferHdr;
+	SharedFramebuffer m_sharedFramebuffer;	// outlives the render loop that writes it
+	RenderLoop m_renderLoop;
 
 	HWND m_wndHandle;
 };
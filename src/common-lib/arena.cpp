@@ -0,0 +1,55 @@
+#include "arena.h"
+
+Arena::Arena(const size_t blockSize) :
+	m_blockSize{ blockSize }
+{
+}
+
+void* Arena::Allocate(const size_t size, const size_t alignment)
+{
+	assert((alignment & (alignment - 1)) == 0 && L"Alignment must be a power of two");
+
+	if (!m_blocks.empty())
+	{
+		const Block& block = m_blocks.back();
+		const auto base = reinterpret_cast<uintptr_t>(block.memory.get());
+		const size_t aligned = ((base + m_offset + alignment - 1) & ~(alignment - 1)) - base;
+
+		if (aligned + size <= block.size)
+		{
+			m_bytesUsed += aligned + size - m_offset;
+			m_offset = aligned + size;
+			return block.memory.get() + aligned;
+		}
+	}
+
+	// Oversized requests get a block of their own. Default-initialized so the pages stay untouched.
+	const size_t blockSize = std::max(m_blockSize, size + alignment);
+	m_blocks.push_back(Block{ std::unique_ptr<std::byte[]>(new std::byte[blockSize]), blockSize });
+
+	const auto base = reinterpret_cast<uintptr_t>(m_blocks.back().memory.get());
+	const size_t aligned = ((base + alignment - 1) & ~(alignment - 1)) - base;
+
+	m_offset = aligned + size;
+	m_bytesUsed += m_offset;
+
+	return m_blocks.back().memory.get() + aligned;
+}
+
+void Arena::Reset()
+{
+	m_blocks.clear();
+	m_offset = 0;
+	m_bytesUsed = 0;
+}
+
+size_t Arena::GetBytesReserved() const
+{
+	size_t bytes = 0;
+	for (const Block& block : m_blocks)
+	{
+		bytes += block.size;
+	}
+
+	return bytes;
+}
\ No newline at end of file
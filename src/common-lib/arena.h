@@ -0,0 +1,55 @@
+#pragma once
+
+#include "stdafx.h"
+
+// Monotonic allocator for data that lives as long as the scene. Allocations are carved out of large blocks
+// and released all at once, so millions of small records cost no per-object heap overhead and end up next to
+// each other in memory. Destructors never run, so only trivially destructible types may be placed here.
+// Blocks are not written on allocation: their pages belong to the NUMA node of the thread that first fills them.
+class Arena
+{
+public:
+	static constexpr size_t k_defaultBlockSize = 1 << 20;
+
+	explicit Arena(size_t blockSize = k_defaultBlockSize);
+
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	void* Allocate(size_t size, size_t alignment);
+
+	template <typename T>
+	T* AllocateArray(size_t count)
+	{
+		static_assert(std::is_trivially_destructible_v<T>, "Arena never runs destructors");
+		return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+	}
+
+	template <typename T>
+	T* CopyArray(const T* source, size_t count)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Arena copies are bitwise");
+		T* destination = AllocateArray<T>(count);
+		std::copy_n(source, count, destination);
+		return destination;
+	}
+
+	// Releases every allocation at once
+	void Reset();
+
+	// Bytes handed out, including alignment padding
+	size_t GetBytesUsed() const { return m_bytesUsed; }
+	size_t GetBytesReserved() const;
+
+private:
+	struct Block
+	{
+		std::unique_ptr<std::byte[]> memory;
+		size_t size;
+	};
+
+	std::vector<Block> m_blocks;
+	size_t m_blockSize;
+	size_t m_offset = 0;	// into the last block
+	size_t m_bytesUsed = 0;
+};
\ No newline at end of file
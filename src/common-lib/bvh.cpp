@@ -0,0 +1,1075 @@
+#include "bvh.h"
+
+namespace
+{
+	// Enough for every node format
+	constexpr size_t k_nodeAlignment = 16;
+
+	template <typename T>
+	constexpr float k_quantizationSteps = static_cast<float>(std::numeric_limits<T>::max());
+
+	// Step size of the child bounds inside a decoded box. The extent is padded by a small fraction of the
+	// coordinate magnitude so the last step reaches past the box despite rounding in Decode().
+	template <typename T>
+	XMVECTOR GetScale(const XMVECTOR& boxMin, const XMVECTOR& boxMax)
+	{
+		const XMVECTOR magnitude = XMVectorMax(XMVectorAbs(boxMin), XMVectorAbs(boxMax));
+		return XMVectorMultiplyAdd(magnitude, XMVectorReplicate(1.f / 65536.f), boxMax - boxMin) * (1.f / k_quantizationSteps<T>);
+	}
+
+	// The only place quantized coordinates are expanded, shared by the build and traversal so both see the same boxes
+	template <typename T>
+	XMVECTOR Decode(const XMVECTOR& boxMin, const XMVECTOR& scale, const std::array<T, 3>& q)
+	{
+		return XMVectorMultiplyAdd(XMVectorSet(q[0], q[1], q[2], 0.f), scale, boxMin);
+	}
+
+	// Levels of median splits below a node of count references until every leaf fits
+	int GetMedianSplitDepth(uint32_t count)
+	{
+		int depth = 0;
+		for (; count > Bvh::k_maxLeafSize; count = (count + 1) / 2)
+		{
+			++depth;
+		}
+
+		return depth;
+	}
+
+	uint32_t MakeLeafRef(uint32_t first, uint32_t count)
+	{
+		return Bvh::k_leafFlag | (count << Bvh::k_leafCountShift) | first;
+	}
+
+	constexpr float k_floatMax = std::numeric_limits<float>::max();
+	constexpr uint32_t k_binCount = 32;
+	constexpr int k_maxSahDepth = 40;
+	constexpr float k_minOverlap = 1e-5f;	// overlap, relative to the root's area, that makes spatial splits worth trying
+
+	struct Box
+	{
+		std::array<float, 3> min = { k_floatMax, k_floatMax, k_floatMax };
+		std::array<float, 3> max = { -k_floatMax, -k_floatMax, -k_floatMax };
+
+		void Grow(const Box& other)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				min[axis] = std::min(min[axis], other.min[axis]);
+				max[axis] = std::max(max[axis], other.max[axis]);
+			}
+		}
+
+		void Grow(const std::array<float, 3>& point)
+		{
+			Grow(Box{ point, point });
+		}
+
+		std::array<float, 3> GetCenter() const
+		{
+			return { 0.5f * (min[0] + max[0]), 0.5f * (min[1] + max[1]), 0.5f * (min[2] + max[2]) };
+		}
+
+		// Half the surface area, 0 when empty
+		float GetArea() const
+		{
+			const float dx = max[0] - min[0];
+			const float dy = max[1] - min[1];
+			const float dz = max[2] - min[2];
+			return dx < 0.f || dy < 0.f || dz < 0.f ? 0.f : dx * dy + dy * dz + dz * dx;
+		}
+
+		int GetLargestAxis() const
+		{
+			const float dx = max[0] - min[0];
+			const float dy = max[1] - min[1];
+			const float dz = max[2] - min[2];
+			return dx > dy && dx > dz ? 0 : (dy > dz ? 1 : 2);
+		}
+
+		static Box Intersection(const Box& a, const Box& b)
+		{
+			Box result;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				result.min[axis] = std::max(a.min[axis], b.min[axis]);
+				result.max[axis] = std::min(a.max[axis], b.max[axis]);
+			}
+
+			return result;
+		}
+	};
+
+	Box GetSphereBounds(const Sphere& sphere)
+	{
+		const XMFLOAT3& c = sphere.center;
+		const float r = sphere.radius;
+		return Box{ { c.x - r, c.y - r, c.z - r }, { c.x + r, c.y + r, c.z + r } };
+	}
+
+	// Bounds of the part of a sphere inside a box, or nothing if they do not meet. A point of the sphere is at
+	// least the box distance away from the center on every other axis, which limits its reach along this one.
+	// Evaluated in double precision and rounded outwards: the floor sphere's radius leaves few float bits for
+	// the thin slivers that end up near its surface.
+	std::optional<Box> ClipSphere(const Sphere& sphere, const Box& box)
+	{
+		const double center[3] = { sphere.center.x, sphere.center.y, sphere.center.z };
+		const double radiusSq = static_cast<double>(sphere.radius) * sphere.radius;
+
+		double distanceSq[3];
+		double totalSq = 0.0;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const double distance = std::max({ box.min[axis] - center[axis], center[axis] - box.max[axis], 0.0 });
+			distanceSq[axis] = distance * distance;
+			totalSq += distanceSq[axis];
+		}
+
+		if (totalSq > radiusSq)
+		{
+			return std::nullopt;
+		}
+
+		const double padding = 1e-6 * sphere.radius;
+
+		Box clipped;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const double reach = std::sqrt(radiusSq - (totalSq - distanceSq[axis])) + padding;
+			clipped.min[axis] = std::max(box.min[axis], std::nextafter(static_cast<float>(center[axis] - reach), -k_floatMax));
+			clipped.max[axis] = std::min(box.max[axis], std::nextafter(static_cast<float>(center[axis] + reach), k_floatMax));
+		}
+
+		return clipped;
+	}
+
+	uint32_t GetBin(float value, float start, float extent)
+	{
+		const auto bin = static_cast<int>((value - start) / extent * k_binCount);
+		return static_cast<uint32_t>(std::clamp(bin, 0, static_cast<int>(k_binCount) - 1));
+	}
+
+	float GetBinPlane(uint32_t bin, float start, float extent)
+	{
+		return start + extent * static_cast<float>(bin) / k_binCount;
+	}
+
+	// Costs are SAH costs scaled by the parent's area, which is the same for every candidate of a node
+	struct SahSweep
+	{
+		float cost = k_floatMax;
+		uint32_t bin = 0;	// last bin on the left
+		float overlapArea = 0.f;
+	};
+
+	struct ObjectSplit
+	{
+		float cost = k_floatMax;
+		int axis = -1;
+		uint32_t bin = 0;
+		float overlapArea = 0.f;
+	};
+
+	struct SpatialSplit
+	{
+		float cost = k_floatMax;
+		int axis = -1;
+		float position = 0.f;
+	};
+
+	struct Reference
+	{
+		uint32_t sphere;
+		Box bounds;	// part of the sphere this reference covers
+	};
+
+	struct BuildState
+	{
+		const std::vector<Sphere>& spheres;
+		const BvhSettings& settings;
+		std::vector<Bvh::Node> nodes;
+		std::vector<Sphere> ordered;
+		float rootArea;
+		int64_t duplicationBudget;
+		int64_t referenceCount;	// references across all nodes, duplicates included; leaves encode their offsets in fewer bits
+	};
+
+	template <size_t N>
+	SahSweep Sweep(const std::array<Box, N>& binBounds, const std::array<uint32_t, N>& leftCounts, const std::array<uint32_t, N>& rightCounts)
+	{
+		// Right to left: area and count of everything right of each plane
+		std::array<float, N> rightArea;
+		std::array<uint32_t, N> rightCount;
+		std::array<Box, N> rightBox;
+
+		Box accumulated;
+		uint32_t accumulatedCount = 0;
+		for (size_t i = N - 1; i > 0; --i)
+		{
+			accumulated.Grow(binBounds[i]);
+			accumulatedCount += rightCounts[i];
+			rightArea[i] = accumulated.GetArea();
+			rightCount[i] = accumulatedCount;
+			rightBox[i] = accumulated;
+		}
+
+		SahSweep best;
+		accumulated = Box{};
+		accumulatedCount = 0;
+
+		for (size_t i = 0; i + 1 < N; ++i)
+		{
+			accumulated.Grow(binBounds[i]);
+			accumulatedCount += leftCounts[i];
+
+			if (accumulatedCount == 0 || rightCount[i + 1] == 0)
+			{
+				continue;
+			}
+
+			const float cost = accumulated.GetArea() * accumulatedCount + rightArea[i + 1] * rightCount[i + 1];
+			if (cost < best.cost)
+			{
+				best.cost = cost;
+				best.bin = static_cast<uint32_t>(i);
+				best.overlapArea = Box::Intersection(accumulated, rightBox[i + 1]).GetArea();
+			}
+		}
+
+		return best;
+	}
+
+	ObjectSplit FindObjectSplit(const std::vector<Reference>& references, const Box& centroidBounds)
+	{
+		ObjectSplit best;
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+			if (!(extent > 0.f))
+			{
+				continue;
+			}
+
+			std::array<Box, k_binCount> binBounds;
+			std::array<uint32_t, k_binCount> binCounts{};
+
+			for (const Reference& reference : references)
+			{
+				const uint32_t bin = GetBin(reference.bounds.GetCenter()[axis], centroidBounds.min[axis], extent);
+				binBounds[bin].Grow(reference.bounds);
+				++binCounts[bin];
+			}
+
+			const SahSweep sweep = Sweep(binBounds, binCounts, binCounts);
+			if (sweep.cost < best.cost)
+			{
+				best.cost = sweep.cost;
+				best.axis = axis;
+				best.bin = sweep.bin;
+				best.overlapArea = sweep.overlapArea;
+			}
+		}
+
+		return best;
+	}
+
+	SpatialSplit FindSpatialSplit(const std::vector<Sphere>& spheres, const std::vector<Reference>& references, const Box& bounds)
+	{
+		SpatialSplit best;
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const float extent = bounds.max[axis] - bounds.min[axis];
+			if (!(extent > 0.f))
+			{
+				continue;
+			}
+
+			std::array<Box, k_binCount> binBounds;
+			std::array<uint32_t, k_binCount> entries{};
+			std::array<uint32_t, k_binCount> exits{};
+
+			for (const Reference& reference : references)
+			{
+				const uint32_t first = GetBin(reference.bounds.min[axis], bounds.min[axis], extent);
+				const uint32_t last = GetBin(reference.bounds.max[axis], bounds.min[axis], extent);
+
+				// Each bin receives the part of the sphere inside its slab
+				for (uint32_t bin = first; bin <= last; ++bin)
+				{
+					Box slab = reference.bounds;
+					slab.min[axis] = std::max(slab.min[axis], bin == first ? slab.min[axis] : GetBinPlane(bin, bounds.min[axis], extent));
+					slab.max[axis] = std::min(slab.max[axis], bin == last ? slab.max[axis] : GetBinPlane(bin + 1, bounds.min[axis], extent));
+
+					if (const std::optional<Box> clipped = ClipSphere(spheres[reference.sphere], slab))
+					{
+						binBounds[bin].Grow(*clipped);
+					}
+				}
+
+				++entries[first];
+				++exits[last];
+			}
+
+			const SahSweep sweep = Sweep(binBounds, entries, exits);
+			if (sweep.cost < best.cost)
+			{
+				best.cost = sweep.cost;
+				best.axis = axis;
+				best.position = GetBinPlane(sweep.bin + 1, bounds.min[axis], extent);
+			}
+		}
+
+		return best;
+	}
+
+	void PerformObjectSplit(const std::vector<Reference>& references, const Box& centroidBounds, const ObjectSplit& split, std::vector<Reference>& left, std::vector<Reference>& right)
+	{
+		const float extent = centroidBounds.max[split.axis] - centroidBounds.min[split.axis];
+
+		for (const Reference& reference : references)
+		{
+			const uint32_t bin = GetBin(reference.bounds.GetCenter()[split.axis], centroidBounds.min[split.axis], extent);
+			(bin <= split.bin ? left : right).push_back(reference);
+		}
+	}
+
+	void PerformSpatialSplit(const std::vector<Sphere>& spheres, const std::vector<Reference>& references, const SpatialSplit& split, std::vector<Reference>& left, std::vector<Reference>& right)
+	{
+		const int axis = split.axis;
+
+		for (const Reference& reference : references)
+		{
+			if (reference.bounds.max[axis] <= split.position)
+			{
+				left.push_back(reference);
+			}
+			else if (reference.bounds.min[axis] >= split.position)
+			{
+				right.push_back(reference);
+			}
+			else
+			{
+				// Straddling references are clipped to each side. A side the sphere does not actually reach is skipped.
+				Box leftBox = reference.bounds;
+				Box rightBox = reference.bounds;
+				leftBox.max[axis] = split.position;
+				rightBox.min[axis] = split.position;
+
+				if (const std::optional<Box> clipped = ClipSphere(spheres[reference.sphere], leftBox))
+				{
+					left.push_back(Reference{ reference.sphere, *clipped });
+				}
+
+				if (const std::optional<Box> clipped = ClipSphere(spheres[reference.sphere], rightBox))
+				{
+					right.push_back(Reference{ reference.sphere, *clipped });
+				}
+			}
+		}
+	}
+
+	uint32_t BuildRecursive(BuildState& state, std::vector<Reference>& references, const int depth)
+	{
+		const auto nodeIndex = static_cast<uint32_t>(state.nodes.size());
+		state.nodes.emplace_back();
+
+		Box bounds;
+		Box centroidBounds;
+		for (const Reference& reference : references)
+		{
+			bounds.Grow(reference.bounds);
+			centroidBounds.Grow(reference.bounds.GetCenter());
+		}
+
+		Bvh::Node node{};
+		node.min = XMFLOAT3(bounds.min[0], bounds.min[1], bounds.min[2]);
+		node.max = XMFLOAT3(bounds.max[0], bounds.max[1], bounds.max[2]);
+
+		const auto count = static_cast<uint32_t>(references.size());
+
+		if (count <= Bvh::k_maxLeafSize)
+		{
+			assert(depth <= static_cast<int>(Bvh::k_maxDepth) && L"BVH deeper than the traversal stacks");
+
+			node.offset = static_cast<uint32_t>(state.ordered.size());
+			node.count = count;
+
+			for (const Reference& reference : references)
+			{
+				state.ordered.push_back(state.spheres[reference.sphere]);
+			}
+
+			state.nodes[nodeIndex] = node;
+			return nodeIndex;
+		}
+
+		std::vector<Reference> left;
+		std::vector<Reference> right;
+
+		// Past this depth the tree is finished with balanced splits. Both children of a SAH split are smaller than
+		// their parent, so stopping while median splits below the children still fit bounds every leaf's depth
+		// by k_maxDepth, whatever spatial splits duplicated.
+		if (depth < k_maxSahDepth && depth + 1 + GetMedianSplitDepth(count) <= static_cast<int>(Bvh::k_maxDepth))
+		{
+			const ObjectSplit objectSplit = FindObjectSplit(references, centroidBounds);
+
+			// Spatial splits only pay off where children overlap noticeably, and only while the budget lasts
+			SpatialSplit spatialSplit;
+			if (state.settings.spatialSplits && state.duplicationBudget > 0 && objectSplit.overlapArea > k_minOverlap * state.rootArea)
+			{
+				spatialSplit = FindSpatialSplit(state.spheres, references, bounds);
+			}
+
+			if (spatialSplit.cost < objectSplit.cost)
+			{
+				PerformSpatialSplit(state.spheres, references, spatialSplit, left, right);
+				const int64_t duplicates = static_cast<int64_t>(left.size() + right.size()) - count;
+
+				// A split that does not shrink both sides would recurse forever, and one that takes the references
+				// past k_maxPrimitives would run leaf offsets into the count bits
+				if (left.size() >= count || right.size() >= count || left.empty() || right.empty() ||
+					state.referenceCount + duplicates >= static_cast<int64_t>(Bvh::k_maxPrimitives))
+				{
+					left.clear();
+					right.clear();
+				}
+				else
+				{
+					state.duplicationBudget -= duplicates;
+					state.referenceCount += duplicates;
+				}
+			}
+			else if (objectSplit.axis >= 0)
+			{
+				PerformObjectSplit(references, centroidBounds, objectSplit, left, right);
+			}
+		}
+
+		if (left.empty() || right.empty())
+		{
+			// Median split along the widest extent of the centers
+			left.clear();
+			right.clear();
+
+			const int axis = centroidBounds.GetLargestAxis();
+			const auto middle = references.begin() + count / 2;
+			std::nth_element(references.begin(), middle, references.end(), [axis](const Reference& a, const Reference& b)
+			{
+				return a.bounds.GetCenter()[axis] < b.bounds.GetCenter()[axis];
+			});
+
+			left.assign(references.begin(), middle);
+			right.assign(middle, references.end());
+		}
+
+		// The parent's references are no longer needed while the children are built
+		references = {};
+
+		BuildRecursive(state, left, depth + 1);
+		node.offset = BuildRecursive(state, right, depth + 1);
+		node.count = 0;
+
+		state.nodes[nodeIndex] = node;
+		return nodeIndex;
+	}
+}
+
+void Bvh::Build(const std::vector<Sphere>& spheres, Arena& arena, const BvhSettings& settings)
+{
+	assert(spheres.size() < k_maxPrimitives && L"Too many primitives for the leaf encoding");
+
+	std::vector<Reference> references;
+	references.reserve(spheres.size());
+
+	Box rootBounds;
+	for (uint32_t i = 0; i < spheres.size(); ++i)
+	{
+		const Reference reference{ i, GetSphereBounds(spheres[i]) };
+		rootBounds.Grow(reference.bounds);
+		references.push_back(reference);
+	}
+
+	BuildState state{ spheres, settings, {}, {}, rootBounds.GetArea(), static_cast<int64_t>(settings.duplicationBudget * spheres.size()), static_cast<int64_t>(spheres.size()) };
+	state.nodes.reserve(2 * spheres.size());
+	state.ordered.reserve(spheres.size());
+
+	if (!references.empty())
+	{
+		BuildRecursive(state, references, 0);
+	}
+
+	assert(state.ordered.size() < k_maxPrimitives && L"Too many sphere references for the leaf encoding");
+
+	const std::vector<Node>& nodes = state.nodes;
+
+	m_layout = settings.layout;
+	m_sphereCount = static_cast<uint32_t>(spheres.size());
+	m_referenceCount = static_cast<uint32_t>(state.ordered.size());
+	m_primitives = arena.CopyArray(state.ordered.data(), state.ordered.size());
+
+	if (!nodes.empty())
+	{
+		m_rootMin = nodes[0].min;
+		m_rootMax = nodes[0].max;
+	}
+
+	if (m_layout == BvhLayout::Full || nodes.empty())
+	{
+		m_layout = BvhLayout::Full;
+		m_nodeCount = static_cast<uint32_t>(nodes.size());
+		m_nodes = arena.CopyArray(nodes.data(), nodes.size());
+		return;
+	}
+
+	auto quantizeAll = [this, &nodes, &arena](auto& quantized)
+	{
+		m_root = Quantize(nodes, 0, XMLoadFloat3(&m_rootMin), XMLoadFloat3(&m_rootMax), quantized);
+		m_nodeCount = static_cast<uint32_t>(quantized.size());
+		m_nodes = arena.CopyArray(quantized.data(), quantized.size());
+	};
+
+	if (m_layout == BvhLayout::Quantized16)
+	{
+		std::vector<QuantizedNode<uint16_t>> quantized;
+		quantizeAll(quantized);
+	}
+	else
+	{
+		std::vector<QuantizedNode<uint8_t>> quantized;
+		quantizeAll(quantized);
+	}
+}
+
+template <typename T>
+uint32_t Bvh::Quantize(const std::vector<Node>& nodes, const uint32_t index, const XMVECTOR& boxMin, const XMVECTOR& boxMax, std::vector<QuantizedNode<T>>& out) const
+{
+	const Node& node = nodes[index];
+
+	if (node.count > 0)
+	{
+		return MakeLeafRef(node.offset, node.count);
+	}
+
+	const auto outIndex = static_cast<uint32_t>(out.size());
+	out.emplace_back();
+
+	const XMVECTOR scale = GetScale<T>(boxMin, boxMax);
+	const uint32_t children[2] = { index + 1, node.offset };
+
+	QuantizedNode<T> quantized{};
+
+	for (int c = 0; c < 2; ++c)
+	{
+		const Node& child = nodes[children[c]];
+		std::array<T, 3>& qMin = quantized.childMin[c];
+		std::array<T, 3>& qMax = quantized.childMax[c];
+
+		XMFLOAT3 start, end;
+		XMStoreFloat3(&start, (XMLoadFloat3(&child.min) - boxMin) / scale);
+		XMStoreFloat3(&end, (XMLoadFloat3(&child.max) - boxMin) / scale);
+
+		const float exactMin[3] = { child.min.x, child.min.y, child.min.z };
+		const float exactMax[3] = { child.max.x, child.max.y, child.max.z };
+		const float startSteps[3] = { start.x, start.y, start.z };
+		const float endSteps[3] = { end.x, end.y, end.z };
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			// Degenerate extents divide to NaN, which fails both comparisons and lands on the box edges
+			qMin[axis] = static_cast<T>(startSteps[axis] > 0.f ? std::min(std::floor(startSteps[axis]), k_quantizationSteps<T>) : 0.f);
+			qMax[axis] = static_cast<T>(endSteps[axis] < k_quantizationSteps<T> ? std::max(std::ceil(endSteps[axis]), 0.f) : k_quantizationSteps<T>);
+
+			// Round outwards against the decode arithmetic itself. Decode(0) is the box minimum and the
+			// padded scale puts the last step past the box maximum, so both loops terminate inside the range.
+			while (qMin[axis] > 0 && XMVectorGetByIndex(Decode(boxMin, scale, qMin), axis) > exactMin[axis])
+			{
+				--qMin[axis];
+			}
+
+			while (qMax[axis] < std::numeric_limits<T>::max() && XMVectorGetByIndex(Decode(boxMin, scale, qMax), axis) < exactMax[axis])
+			{
+				++qMax[axis];
+			}
+		}
+
+		quantized.child[c] = Quantize(nodes, children[c], Decode(boxMin, scale, qMin), Decode(boxMin, scale, qMax), out);
+	}
+
+	out[outIndex] = quantized;
+	return outIndex;
+}
+
+Bvh Bvh::CopyTo(Arena& arena) const
+{
+	Bvh copy = *this;
+
+	void* nodes = arena.Allocate(m_nodeCount * GetNodeSize(), k_nodeAlignment);
+	std::memcpy(nodes, m_nodes, m_nodeCount * GetNodeSize());
+
+	copy.m_nodes = nodes;
+	copy.m_primitives = arena.CopyArray(m_primitives, m_referenceCount);
+
+	return copy;
+}
+
+size_t Bvh::GetNodeSize() const
+{
+	switch (m_layout)
+	{
+	case BvhLayout::Quantized16:
+		return sizeof(QuantizedNode<uint16_t>);
+	case BvhLayout::Quantized8:
+		return sizeof(QuantizedNode<uint8_t>);
+	case BvhLayout::Full:
+	default:
+		return sizeof(Node);
+	}
+}
+
+bool Bvh::IntersectBounds(const XMVECTOR& boxMin, const XMVECTOR& boxMax, const XMVECTOR& origin, const XMVECTOR& invDirection, float tMax, float& outTEnter)
+{
+	// Slab test
+	const XMVECTOR t0 = (boxMin - origin) * invDirection;
+	const XMVECTOR t1 = (boxMax - origin) * invDirection;
+
+	XMFLOAT3 tNear, tFar;
+	XMStoreFloat3(&tNear, XMVectorMin(t0, t1));
+	XMStoreFloat3(&tFar, XMVectorMax(t0, t1));
+
+	outTEnter = std::max({ tNear.x, tNear.y, tNear.z, 0.f });
+	const float tExit = std::min({ tFar.x, tFar.y, tFar.z, tMax });
+
+	return outTEnter <= tExit;
+}
+
+bool Bvh::IntersectLeaf(const Ray& ray, uint32_t first, uint32_t count, float& closest, Payload& payload, TraversalStats* stats) const
+{
+	bool hit = false;
+
+	if (stats)
+	{
+		stats->primitives += count;
+	}
+
+	for (uint32_t i = first; i < first + count; ++i)
+	{
+		Payload candidate;
+		if (m_primitives[i].Intersect(ray, candidate) && XMVectorGetX(candidate.t) < closest)
+		{
+			closest = XMVectorGetX(candidate.t);
+			payload = candidate;
+			hit = true;
+		}
+	}
+
+	return hit;
+}
+
+bool Bvh::Intersect(const Ray& ray, Payload& payload, TraversalStats* stats) const
+{
+	switch (m_layout)
+	{
+	case BvhLayout::Quantized16:
+		return IntersectQuantized<uint16_t>(ray, payload, stats);
+	case BvhLayout::Quantized8:
+		return IntersectQuantized<uint8_t>(ray, payload, stats);
+	case BvhLayout::Full:
+	default:
+		return IntersectFull(ray, payload, stats);
+	}
+}
+
+bool Bvh::IntersectFull(const Ray& ray, Payload& payload, TraversalStats* stats) const
+{
+	if (m_nodeCount == 0)
+	{
+		return false;
+	}
+
+	const auto* nodes = static_cast<const Node*>(m_nodes);
+	const XMVECTOR invDirection = XMVectorReciprocal(ray.direction);
+
+	float closest = std::numeric_limits<float>::max();
+	bool hit = false;
+
+	// Deferred far children with their entry distance, so they can be skipped once a closer hit is known
+	struct StackEntry
+	{
+		uint32_t index;
+		float tEnter;
+	};
+
+	StackEntry stack[k_maxDepth];
+	uint32_t stackSize = 0;
+	uint32_t index = 0;
+
+	for (;;)
+	{
+		const Node& node = nodes[index];
+
+		if (stats)
+		{
+			++stats->nodes;
+		}
+
+		if (node.count > 0)
+		{
+			hit |= IntersectLeaf(ray, node.offset, node.count, closest, payload, stats);
+		}
+		else
+		{
+			const uint32_t first = index + 1;
+			const uint32_t second = node.offset;
+
+			float tFirst, tSecond;
+			const bool hitFirst = IntersectBounds(XMLoadFloat3(&nodes[first].min), XMLoadFloat3(&nodes[first].max), ray.origin, invDirection, closest, tFirst);
+			const bool hitSecond = IntersectBounds(XMLoadFloat3(&nodes[second].min), XMLoadFloat3(&nodes[second].max), ray.origin, invDirection, closest, tSecond);
+
+			if (hitFirst && hitSecond)
+			{
+				const bool firstIsNearer = tFirst <= tSecond;
+				stack[stackSize++] = firstIsNearer ? StackEntry{ second, tSecond } : StackEntry{ first, tFirst };
+				index = firstIsNearer ? first : second;
+				continue;
+			}
+			else if (hitFirst || hitSecond)
+			{
+				index = hitFirst ? first : second;
+				continue;
+			}
+		}
+
+		while (stackSize > 0 && stack[stackSize - 1].tEnter > closest)
+		{
+			--stackSize;
+		}
+
+		if (stackSize == 0)
+		{
+			break;
+		}
+
+		index = stack[--stackSize].index;
+	}
+
+	return hit;
+}
+
+template <typename T>
+bool Bvh::IntersectQuantized(const Ray& ray, Payload& payload, TraversalStats* stats) const
+{
+	const auto* nodes = static_cast<const QuantizedNode<T>*>(m_nodes);
+	const XMVECTOR invDirection = XMVectorReciprocal(ray.direction);
+
+	float closest = std::numeric_limits<float>::max();
+	bool hit = false;
+
+	// Children are decoded relative to their parent's box, so deferred entries carry their own decoded box
+	struct StackEntry
+	{
+		uint32_t ref;
+		float tEnter;
+		XMFLOAT3 boxMin;
+		XMFLOAT3 boxMax;
+	};
+
+	StackEntry stack[k_maxDepth];
+	uint32_t stackSize = 0;
+
+	uint32_t ref = m_root;
+	XMVECTOR boxMin = XMLoadFloat3(&m_rootMin);
+	XMVECTOR boxMax = XMLoadFloat3(&m_rootMax);
+
+	for (;;)
+	{
+		if (ref & k_leafFlag)
+		{
+			const uint32_t count = (ref & ~k_leafFlag) >> k_leafCountShift;
+			hit |= IntersectLeaf(ray, ref & (k_maxPrimitives - 1), count, closest, payload, stats);
+		}
+		else
+		{
+			const QuantizedNode<T>& node = nodes[ref];
+
+			if (stats)
+			{
+				++stats->nodes;
+			}
+			const XMVECTOR scale = GetScale<T>(boxMin, boxMax);
+
+			XMVECTOR childMin[2], childMax[2];
+			float tEnter[2];
+			bool hitChild[2];
+
+			for (int c = 0; c < 2; ++c)
+			{
+				childMin[c] = Decode(boxMin, scale, node.childMin[c]);
+				childMax[c] = Decode(boxMin, scale, node.childMax[c]);
+				hitChild[c] = IntersectBounds(childMin[c], childMax[c], ray.origin, invDirection, closest, tEnter[c]);
+			}
+
+			if (hitChild[0] && hitChild[1])
+			{
+				const int nearer = tEnter[0] <= tEnter[1] ? 0 : 1;
+				const int farther = 1 - nearer;
+
+				StackEntry& entry = stack[stackSize++];
+				entry.ref = node.child[farther];
+				entry.tEnter = tEnter[farther];
+				XMStoreFloat3(&entry.boxMin, childMin[farther]);
+				XMStoreFloat3(&entry.boxMax, childMax[farther]);
+
+				ref = node.child[nearer];
+				boxMin = childMin[nearer];
+				boxMax = childMax[nearer];
+				continue;
+			}
+			else if (hitChild[0] || hitChild[1])
+			{
+				const int c = hitChild[0] ? 0 : 1;
+				ref = node.child[c];
+				boxMin = childMin[c];
+				boxMax = childMax[c];
+				continue;
+			}
+		}
+
+		while (stackSize > 0 && stack[stackSize - 1].tEnter > closest)
+		{
+			--stackSize;
+		}
+
+		if (stackSize == 0)
+		{
+			break;
+		}
+
+		const StackEntry& entry = stack[--stackSize];
+		ref = entry.ref;
+		boxMin = XMLoadFloat3(&entry.boxMin);
+		boxMax = XMLoadFloat3(&entry.boxMax);
+	}
+
+	return hit;
+}
+
+void Bvh::IntersectPacket(const RayPacket& packet, std::optional<Payload>* outHits, TraversalStats* stats) const
+{
+	PacketBounds bounds;
+
+	if (m_layout != BvhLayout::Full || m_nodeCount == 0 || !GetPacketBounds(packet, bounds))
+	{
+		for (uint32_t i = 0; i < packet.count; ++i)
+		{
+			Payload payload;
+			outHits[i] = Intersect(packet.GetRay(i), payload, stats) ? std::optional<Payload>(payload) : std::nullopt;
+		}
+
+		return;
+	}
+
+	const auto* nodes = static_cast<const Node*>(m_nodes);
+
+	// Each ray's closest hit so far. The farthest of them bounds the whole packet: a node entered beyond it holds
+	// nothing closer for any ray.
+	alignas(16) std::array<float, RayPacket::k_maxRays> closest;
+	std::array<uint32_t, RayPacket::k_maxRays> closestSphere;
+	closest.fill(std::numeric_limits<float>::max());
+	closestSphere.fill(k_invalidId);
+	float packetClosest = std::numeric_limits<float>::max();
+
+	struct StackEntry
+	{
+		uint32_t index;
+		float tEnter;
+	};
+
+	StackEntry stack[k_maxDepth];
+	uint32_t stackSize = 0;
+	uint32_t index = 0;
+
+	for (;;)
+	{
+		const Node& node = nodes[index];
+
+		if (stats)
+		{
+			++stats->nodes;
+		}
+
+		if (node.count > 0)
+		{
+			if (IntersectLeaf(packet, node.offset, node.count, closest.data(), closestSphere.data(), stats))
+			{
+				packetClosest = *std::max_element(closest.cbegin(), closest.cbegin() + packet.count);
+			}
+		}
+		else
+		{
+			const uint32_t first = index + 1;
+			const uint32_t second = node.offset;
+
+			float tFirst, tSecond;
+			const bool hitFirst = IntersectBounds(XMLoadFloat3(&nodes[first].min), XMLoadFloat3(&nodes[first].max), bounds, packetClosest, tFirst);
+			const bool hitSecond = IntersectBounds(XMLoadFloat3(&nodes[second].min), XMLoadFloat3(&nodes[second].max), bounds, packetClosest, tSecond);
+
+			if (hitFirst && hitSecond)
+			{
+				const bool firstIsNearer = tFirst <= tSecond;
+				stack[stackSize++] = firstIsNearer ? StackEntry{ second, tSecond } : StackEntry{ first, tFirst };
+				index = firstIsNearer ? first : second;
+				continue;
+			}
+			else if (hitFirst || hitSecond)
+			{
+				index = hitFirst ? first : second;
+				continue;
+			}
+		}
+
+		while (stackSize > 0 && stack[stackSize - 1].tEnter > packetClosest)
+		{
+			--stackSize;
+		}
+
+		if (stackSize == 0)
+		{
+			break;
+		}
+
+		index = stack[--stackSize].index;
+	}
+
+	// Payloads only for the winning spheres. Sphere::Intersect repeats the test in its own arithmetic; should it
+	// disagree at a grazing hit, the ray is traced on its own.
+	for (uint32_t i = 0; i < packet.count; ++i)
+	{
+		outHits[i] = std::nullopt;
+
+		if (closestSphere[i] != k_invalidId)
+		{
+			const Ray ray = packet.GetRay(i);
+			Payload payload;
+
+			if (m_primitives[closestSphere[i]].Intersect(ray, payload) || Intersect(ray, payload, stats))
+			{
+				outHits[i] = payload;
+			}
+		}
+	}
+}
+
+bool Bvh::GetPacketBounds(const RayPacket& packet, PacketBounds& outBounds)
+{
+	const std::array<const float*, 3> origins{ packet.originX.data(), packet.originY.data(), packet.originZ.data() };
+	const std::array<const float*, 3> directions{ packet.directionX.data(), packet.directionY.data(), packet.directionZ.data() };
+
+	XMFLOAT3 mirror, originMin, originMax, invDirectionMin, invDirectionMax;
+	float* const mirrorAxes[3] = { &mirror.x, &mirror.y, &mirror.z };
+	float* const originMinAxes[3] = { &originMin.x, &originMin.y, &originMin.z };
+	float* const originMaxAxes[3] = { &originMax.x, &originMax.y, &originMax.z };
+	float* const invMinAxes[3] = { &invDirectionMin.x, &invDirectionMin.y, &invDirectionMin.z };
+	float* const invMaxAxes[3] = { &invDirectionMax.x, &invDirectionMax.y, &invDirectionMax.z };
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		const auto [dMin, dMax] = std::minmax_element(directions[axis], directions[axis] + packet.count);
+
+		// A packet spread across an axis plane has unbounded inverse directions
+		if (!(*dMin > 0.f || *dMax < 0.f))
+		{
+			return false;
+		}
+
+		const float sign = *dMin > 0.f ? 1.f : -1.f;
+		const auto [oMin, oMax] = std::minmax_element(origins[axis], origins[axis] + packet.count);
+
+		*mirrorAxes[axis] = sign;
+		*originMinAxes[axis] = sign > 0.f ? *oMin : -*oMax;
+		*originMaxAxes[axis] = sign > 0.f ? *oMax : -*oMin;
+		*invMinAxes[axis] = 1.f / std::max(std::abs(*dMin), std::abs(*dMax));
+		*invMaxAxes[axis] = 1.f / std::min(std::abs(*dMin), std::abs(*dMax));
+	}
+
+	outBounds.mirror = XMLoadFloat3(&mirror);
+	outBounds.originMin = XMLoadFloat3(&originMin);
+	outBounds.originMax = XMLoadFloat3(&originMax);
+	outBounds.invDirectionMin = XMLoadFloat3(&invDirectionMin);
+	outBounds.invDirectionMax = XMLoadFloat3(&invDirectionMax);
+
+	return true;
+}
+
+bool Bvh::IntersectBounds(const XMVECTOR& boxMin, const XMVECTOR& boxMax, const PacketBounds& packet, float tMax, float& outTEnter)
+{
+	// Box in the mirrored space
+	const XMVECTOR a = boxMin * packet.mirror;
+	const XMVECTOR b = boxMax * packet.mirror;
+	const XMVECTOR mirroredMin = XMVectorMin(a, b);
+	const XMVECTOR mirroredMax = XMVectorMax(a, b);
+
+	// Slab test in interval arithmetic: the lowest entry and the highest exit distance over all rays. Every ray
+	// enters at or after tNear and leaves at or before tFar, so none hits the box if tNear > tFar.
+	const XMVECTOR nearOffset = mirroredMin - packet.originMax;
+	const XMVECTOR farOffset = mirroredMax - packet.originMin;
+	const XMVECTOR t0 = XMVectorSelect(nearOffset * packet.invDirectionMax, nearOffset * packet.invDirectionMin, XMVectorGreaterOrEqual(nearOffset, XM_Zero));
+	const XMVECTOR t1 = XMVectorSelect(farOffset * packet.invDirectionMin, farOffset * packet.invDirectionMax, XMVectorGreaterOrEqual(farOffset, XM_Zero));
+
+	XMFLOAT3 tNear, tFar;
+	XMStoreFloat3(&tNear, t0);
+	XMStoreFloat3(&tFar, t1);
+
+	outTEnter = std::max({ tNear.x, tNear.y, tNear.z, 0.f });
+	const float tExit = std::min({ tFar.x, tFar.y, tFar.z, tMax });
+
+	return outTEnter <= tExit;
+}
+
+bool Bvh::IntersectLeaf(const RayPacket& packet, uint32_t first, uint32_t count, float* closest, uint32_t* closestSphere, TraversalStats* stats) const
+{
+	// Same bias as Sphere::Intersect
+	constexpr float k_bias = 0.001f;
+
+	bool hit = false;
+
+	if (stats)
+	{
+		stats->primitives += static_cast<uint64_t>(count) * packet.count;
+	}
+
+	for (uint32_t s = first; s < first + count; ++s)
+	{
+		const Sphere& sphere = m_primitives[s];
+		const float radiusSquared = sphere.radius * sphere.radius;
+
+		// Branch free over the rays, so the loop vectorizes
+		for (uint32_t i = 0; i < packet.count; ++i)
+		{
+			const float ocX = packet.originX[i] - sphere.center.x;
+			const float ocY = packet.originY[i] - sphere.center.y;
+			const float ocZ = packet.originZ[i] - sphere.center.z;
+			const float dX = packet.directionX[i];
+			const float dY = packet.directionY[i];
+			const float dZ = packet.directionZ[i];
+
+			const float a = dX * dX + dY * dY + dZ * dZ;
+			const float b = ocX * dX + ocY * dY + ocZ * dZ;
+			const float c = ocX * ocX + ocY * ocY + ocZ * ocZ - radiusSquared;
+			const float discriminant = b * b - a * c;
+
+			const float root = std::sqrt(std::max(discriminant, 0.f));
+			const float tNear = (-b - root) / a;
+			const float tFar = (-b + root) / a;
+			const float t = tNear > k_bias ? tNear : tFar;
+
+			const bool closer = discriminant > 0.f && t > k_bias && t < closest[i];
+			closest[i] = closer ? t : closest[i];
+			closestSphere[i] = closer ? s : closestSphere[i];
+			hit |= closer;
+		}
+	}
+
+	return hit;
+}
\ No newline at end of file
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "stdafx.h"
+#include "ray-tracing.h"
+#include "arena.h"
+
+enum class BvhLayout : uint32_t
+{
+	Full,			// float bounds in every node
+	Quantized16,	// each interior node holds its children's bounds in 16-bit steps of its own box
+	Quantized8		// same with 8-bit steps: smallest, at the cost of looser boxes
+};
+
+struct BvhSettings
+{
+	BvhLayout layout = BvhLayout::Full;
+	bool spatialSplits = true;		// split sphere references at planes when that lowers the SAH cost
+	float duplicationBudget = 0.5f;	// extra references spatial splits may create, relative to the sphere count
+};
+
+// Bounding volume hierarchy over spheres, flattened into arena storage. Nodes are laid out depth first so the
+// first child of an interior node immediately follows it, and the spheres are stored in leaf order so a leaf
+// refers to a contiguous run of them. Traversal visits the nearer child first and skips nodes beyond the
+// closest hit found so far.
+// The builder minimizes the surface area heuristic over binned object splits and, as in SBVH (Stich et al.
+// 2009), spatial splits that clip a sphere into the parts on either side of a plane. Clipping uses the exact
+// bounds of the sphere inside the box, so a huge sphere such as a floor contributes only thin slivers to the
+// nodes near its surface instead of overlapping the whole tree. A sphere split this way is stored in every
+// leaf that references it.
+// The quantized layouts drop leaf nodes and store child bounds relative to the parent's decoded box, which
+// traversal carries down the stack. Quantization rounds outwards against the exact decode arithmetic used
+// during traversal, so a decoded box always contains its primitives.
+class Bvh
+{
+public:
+	struct Node
+	{
+		XMFLOAT3 min;
+		uint32_t offset;	// interior nodes: index of the second child. Leaves: first sphere.
+		XMFLOAT3 max;
+		uint32_t count;		// spheres in a leaf, 0 for interior nodes
+	};
+
+	template <typename T>
+	struct QuantizedNode
+	{
+		std::array<T, 3> childMin[2];
+		std::array<T, 3> childMax[2];
+		uint32_t child[2];	// interior node index, or k_leafFlag | count << k_leafCountShift | first sphere
+	};
+
+	static constexpr uint32_t k_maxLeafSize = 2;
+	static constexpr uint32_t k_maxDepth = 64;	// leaves at most this many levels below the root; sizes the traversal stacks
+	static constexpr uint32_t k_leafFlag = 1u << 31;
+	static constexpr uint32_t k_leafCountShift = 28;
+	static constexpr uint32_t k_maxPrimitives = 1u << k_leafCountShift;
+
+	// Optional per-ray counters, for comparing builds
+	struct TraversalStats
+	{
+		uint64_t nodes = 0;
+		uint64_t primitives = 0;
+	};
+
+	// Copies the spheres into the arena in leaf order
+	void Build(const std::vector<Sphere>& spheres, Arena& arena, const BvhSettings& settings = BvhSettings{});
+
+	// Same hierarchy with nodes and spheres copied into another arena, e.g. one local to a NUMA node
+	Bvh CopyTo(Arena& arena) const;
+
+	bool Intersect(const Ray& ray, Payload& payload, TraversalStats* stats = nullptr) const;
+
+	// Closest hits of a packet of coherent rays such as the primary rays of a pixel block. The packet traverses the
+	// tree once: a node is culled when interval arithmetic over all of the packet's origins and directions shows
+	// that no ray can enter it, and leaves test every ray. Packets whose directions differ in sign on some axis
+	// have no such bounds and trace their rays one by one, as do the quantized layouts.
+	void IntersectPacket(const RayPacket& packet, std::optional<Payload>* outHits, TraversalStats* stats = nullptr) const;
+
+	BvhLayout GetLayout() const { return m_layout; }
+	uint32_t GetNodeCount() const { return m_nodeCount; }
+	size_t GetNodeSize() const;
+	uint32_t GetSphereCount() const { return m_sphereCount; }
+	uint32_t GetReferenceCount() const { return m_referenceCount; }	// stored spheres, counting duplicates from spatial splits
+	size_t GetMemoryUsage() const { return m_nodeCount * GetNodeSize() + m_referenceCount * sizeof(Sphere); }
+	// Box around all spheres; a point at the origin for an empty tree
+	void GetBounds(XMFLOAT3& outMin, XMFLOAT3& outMax) const { outMin = m_rootMin; outMax = m_rootMax; }
+
+private:
+	// Returns the reference to nodes[index] whose decoded box is boxMin, boxMax
+	template <typename T>
+	uint32_t Quantize(const std::vector<Node>& nodes, uint32_t index, const XMVECTOR& boxMin, const XMVECTOR& boxMax, std::vector<QuantizedNode<T>>& out) const;
+
+	bool IntersectFull(const Ray& ray, Payload& payload, TraversalStats* stats) const;
+	template <typename T>
+	bool IntersectQuantized(const Ray& ray, Payload& payload, TraversalStats* stats) const;
+	bool IntersectLeaf(const Ray& ray, uint32_t first, uint32_t count, float& closest, Payload& payload, TraversalStats* stats) const;
+	static bool IntersectBounds(const XMVECTOR& boxMin, const XMVECTOR& boxMax, const XMVECTOR& origin, const XMVECTOR& invDirection, float tMax, float& outTEnter);
+
+	// Intervals of a packet's origins and inverse directions, mirrored on the axes where the directions are negative
+	// so that every inverse direction is positive
+	struct PacketBounds
+	{
+		XMVECTOR mirror;	// -1 on mirrored axes, 1 elsewhere
+		XMVECTOR originMin;
+		XMVECTOR originMax;
+		XMVECTOR invDirectionMin;
+		XMVECTOR invDirectionMax;
+	};
+
+	// False when the directions of the packet differ in sign on some axis
+	static bool GetPacketBounds(const RayPacket& packet, PacketBounds& outBounds);
+	// outTEnter is a lower bound of the entry distance of every ray of the packet
+	static bool IntersectBounds(const XMVECTOR& boxMin, const XMVECTOR& boxMax, const PacketBounds& packet, float tMax, float& outTEnter);
+	// Keeps the distance and sphere of each ray's closest hit
+	bool IntersectLeaf(const RayPacket& packet, uint32_t first, uint32_t count, float* closest, uint32_t* closestSphere, TraversalStats* stats) const;
+
+private:
+	BvhLayout m_layout = BvhLayout::Full;
+	const void* m_nodes = nullptr;	// Node or QuantizedNode<T> depending on the layout
+	const Sphere* m_primitives = nullptr;
+	uint32_t m_nodeCount = 0;
+	uint32_t m_sphereCount = 0;
+	uint32_t m_referenceCount = 0;
+	XMFLOAT3 m_rootMin{ 0.f, 0.f, 0.f };	// also the box the quantized layouts decode from
+	XMFLOAT3 m_rootMax{ 0.f, 0.f, 0.f };
+
+	// Quantized layouts
+	uint32_t m_root = 0;
+};
\ No newline at end of file
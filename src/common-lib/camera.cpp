@@ -47,6 +47,52 @@ Ray Camera::GetRay(XMFLOAT2 uv, XMFLOAT2 offset) const
 	return Ray{ origin, XMVector3Normalize(focalPoint - origin) };
 }
 
+void Camera::GetRays(const XMFLOAT2* uv, const XMFLOAT2* offset, const uint32_t count, RayPacket& outPacket) const
+{
+	assert(count <= RayPacket::k_maxRays && L"Too many rays for one packet");
+
+	XMFLOAT3 o, x, y, plane;
+	XMStoreFloat3(&o, m_origin);
+	XMStoreFloat3(&x, m_x);
+	XMStoreFloat3(&y, m_y);
+	XMStoreFloat3(&plane, m_originImagePlane);
+
+	const float lensScale = 0.5f * m_aperture;
+
+	outPacket.count = count;
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const float ndcX = 2.f * uv[i].x - 1.f;
+		const float ndcY = -2.f * uv[i].y + 1.f;
+
+		// Primary ray to the image plane determines the focal point
+		const float px = plane.x + ndcX * x.x + ndcY * y.x - o.x;
+		const float py = plane.y + ndcX * x.y + ndcY * y.y - o.y;
+		const float pz = plane.z + ndcX * x.z + ndcY * y.z - o.z;
+		const float focalScale = m_focalLength / std::sqrt(px * px + py * py + pz * pz);
+
+		// Secondary ray from the lens sample through the focal point
+		const float rx = lensScale * offset[i].x;
+		const float ry = lensScale * offset[i].y;
+		const float ox = o.x + rx * x.x + ry * y.x;
+		const float oy = o.y + rx * x.y + ry * y.y;
+		const float oz = o.z + rx * x.z + ry * y.z;
+
+		const float dx = o.x + focalScale * px - ox;
+		const float dy = o.y + focalScale * py - oy;
+		const float dz = o.z + focalScale * pz - oz;
+		const float invLength = 1.f / std::sqrt(dx * dx + dy * dy + dz * dz);
+
+		outPacket.originX[i] = ox;
+		outPacket.originY[i] = oy;
+		outPacket.originZ[i] = oz;
+		outPacket.directionX[i] = dx * invLength;
+		outPacket.directionY[i] = dy * invLength;
+		outPacket.directionZ[i] = dz * invLength;
+	}
+}
+
 XMVECTOR Camera::GetOrigin() const
 {
 	return m_origin;
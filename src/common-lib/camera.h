@@ -8,6 +8,8 @@ class Camera
 public:
 	Camera(XMVECTOR origin, XMVECTOR lookAt, float verticalFOV, float aspectRatio, float focalLength, float aperture);
 	Ray GetRay(XMFLOAT2 uv, XMFLOAT2 offset) const;
+	// The same rays for a block of samples, computed a component at a time so the loops vectorize
+	void GetRays(const XMFLOAT2* uv, const XMFLOAT2* offset, uint32_t count, RayPacket& outPacket) const;
 	XMVECTOR GetOrigin() const;
 
 private:
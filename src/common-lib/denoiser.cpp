@@ -0,0 +1,225 @@
+#include "denoiser.h"
+
+namespace
+{
+	// B3 spline
+	constexpr float k_kernel[5] = { 1.f / 16.f, 1.f / 4.f, 3.f / 8.f, 1.f / 4.f, 1.f / 16.f };
+
+	XMVECTOR LoadPlane(const std::vector<float>& plane, size_t index)
+	{
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&plane[index]));
+	}
+
+	void StorePlane(std::vector<float>& plane, size_t index, const XMVECTOR& value)
+	{
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&plane[index]), value);
+	}
+
+	void ForEachIndex(uint32_t count, const std::function<void(uint32_t)>& function)
+	{
+		std::vector<uint32_t> indices(count);
+		std::iota(indices.begin(), indices.end(), 0u);
+		std::for_each(std::execution::par, indices.cbegin(), indices.cend(), function);
+	}
+}
+
+Denoiser::Denoiser(const DenoiserSettings& settings) :
+	m_settings{ settings }
+{
+	// Taps reach two steps out and the last iteration steps 2^(iterations - 1) pixels. Rounded up to whole vectors.
+	m_apron = m_settings.iterations > 0 ? ((2u << (m_settings.iterations - 1)) + 3u) & ~3u : 0u;
+}
+
+void Denoiser::Denoise(const Framebuffer& input, Framebuffer& output)
+{
+	assert(input.HasAovs() && L"Denoiser needs albedo, normal and depth AOVs");
+
+	if (input.GetWidth() != m_width || input.GetHeight() != m_height)
+	{
+		Allocate(input.GetWidth(), input.GetHeight());
+	}
+
+	if (output.GetWidth() != m_width || output.GetHeight() != m_height)
+	{
+		output.Resize(m_width, m_height);
+		output.Clear();
+	}
+
+	Gather(input);
+
+	for (uint32_t iteration = 0; iteration < m_settings.iterations; ++iteration)
+	{
+		const Planes& source = m_color[iteration % 2];
+		Planes& destination = m_color[(iteration + 1) % 2];
+
+		ForEachIndex(m_height, [this, iteration, &source, &destination](uint32_t y)
+		{
+			FilterRow(y, iteration, source, destination);
+		});
+	}
+
+	Scatter(m_color[m_settings.iterations % 2], input, output);
+}
+
+void Denoiser::Allocate(uint32_t width, uint32_t height)
+{
+	m_width = width;
+	m_height = height;
+	m_stride = m_apron + ((width + 3u) & ~3u) + m_apron;
+
+	const size_t size = static_cast<size_t>(m_stride) * height;
+
+	for (Planes* planes : { &m_color[0], &m_color[1], &m_albedo, &m_normal })
+	{
+		planes->x.assign(size, 0.f);
+		planes->y.assign(size, 0.f);
+		planes->z.assign(size, 0.f);
+	}
+
+	m_depth.assign(size, 0.f);
+	m_valid.assign(size, 0.f);
+
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		std::fill_n(&m_valid[GetIndex(0, y)], width, 1.f);
+	}
+}
+
+void Denoiser::Gather(const Framebuffer& input)
+{
+	ForEachIndex(input.GetTileCount(), [this, &input](uint32_t tileIndex)
+	{
+		const Framebuffer::Tile& tile = input.GetTile(tileIndex);
+		const Framebuffer::AovTile& aovTile = input.GetAovTile(tileIndex);
+		const PixelRect rect = input.GetTileRect(tileIndex);
+		const uint32_t count = rect.right - rect.left;
+
+		for (uint32_t y = rect.top; y < rect.bottom; ++y)
+		{
+			const uint32_t source = (y - rect.top) * Framebuffer::k_tileSize;
+			const size_t destination = GetIndex(rect.left, y);
+
+			std::copy_n(&tile.r[source], count, &m_color[0].x[destination]);
+			std::copy_n(&tile.g[source], count, &m_color[0].y[destination]);
+			std::copy_n(&tile.b[source], count, &m_color[0].z[destination]);
+			std::copy_n(&aovTile.albedoR[source], count, &m_albedo.x[destination]);
+			std::copy_n(&aovTile.albedoG[source], count, &m_albedo.y[destination]);
+			std::copy_n(&aovTile.albedoB[source], count, &m_albedo.z[destination]);
+			std::copy_n(&aovTile.normalX[source], count, &m_normal.x[destination]);
+			std::copy_n(&aovTile.normalY[source], count, &m_normal.y[destination]);
+			std::copy_n(&aovTile.normalZ[source], count, &m_normal.z[destination]);
+			std::copy_n(&aovTile.depth[source], count, &m_depth[destination]);
+		}
+	});
+}
+
+void Denoiser::FilterRow(uint32_t y, uint32_t iteration, const Planes& source, Planes& destination) const
+{
+	const int step = 1 << iteration;
+	const float colorSigma = m_settings.colorSigma / static_cast<float>(step);
+
+	const XMVECTOR invColorSigmaSq = XMVectorReplicate(1.f / (colorSigma * colorSigma));
+	const XMVECTOR invNormalSigmaSq = XMVectorReplicate(1.f / (m_settings.normalSigma * m_settings.normalSigma));
+	const XMVECTOR invAlbedoSigmaSq = XMVectorReplicate(1.f / (m_settings.albedoSigma * m_settings.albedoSigma));
+	const XMVECTOR depthSigma = XMVectorReplicate(m_settings.depthSigma);
+	const XMVECTOR minDepth = XMVectorReplicate(1e-3f);
+	const XMVECTOR minWeight = XMVectorReplicate(1e-12f);
+
+	// Four neighbouring pixels per iteration; the padding absorbs the row tail
+	for (uint32_t x = 0; x < m_width; x += 4)
+	{
+		const size_t p = GetIndex(x, y);
+
+		const XMVECTOR colorR = LoadPlane(source.x, p);
+		const XMVECTOR colorG = LoadPlane(source.y, p);
+		const XMVECTOR colorB = LoadPlane(source.z, p);
+		const XMVECTOR albedoR = LoadPlane(m_albedo.x, p);
+		const XMVECTOR albedoG = LoadPlane(m_albedo.y, p);
+		const XMVECTOR albedoB = LoadPlane(m_albedo.z, p);
+		const XMVECTOR normalX = LoadPlane(m_normal.x, p);
+		const XMVECTOR normalY = LoadPlane(m_normal.y, p);
+		const XMVECTOR normalZ = LoadPlane(m_normal.z, p);
+		const XMVECTOR depth = LoadPlane(m_depth, p);
+
+		// Depth differences are judged relative to the center depth, and below relative to the tap distance
+		const XMVECTOR invDepthScale = XMVectorReciprocal(depthSigma * XMVectorMax(depth, minDepth));
+
+		XMVECTOR sumR = XM_Zero;
+		XMVECTOR sumG = XM_Zero;
+		XMVECTOR sumB = XM_Zero;
+		XMVECTOR sumWeight = XM_Zero;
+
+		for (int dy = -2; dy <= 2; ++dy)
+		{
+			const int qy = static_cast<int>(y) + dy * step;
+			if (qy < 0 || qy >= static_cast<int>(m_height))
+			{
+				continue;
+			}
+
+			for (int dx = -2; dx <= 2; ++dx)
+			{
+				// Chebyshev distance of the tap in pixels; the center tap has no depth difference
+				const int tapDistance = std::max({ std::abs(dx), std::abs(dy), 1 }) * step;
+				const float invTapDistance = 1.f / static_cast<float>(tapDistance);
+				const auto q = static_cast<size_t>(static_cast<ptrdiff_t>(GetIndex(x, qy)) + dx * step);
+
+				const XMVECTOR qColorR = LoadPlane(source.x, q);
+				const XMVECTOR qColorG = LoadPlane(source.y, q);
+				const XMVECTOR qColorB = LoadPlane(source.z, q);
+
+				const XMVECTOR dColorR = colorR - qColorR;
+				const XMVECTOR dColorG = colorG - qColorG;
+				const XMVECTOR dColorB = colorB - qColorB;
+				const XMVECTOR dAlbedoR = albedoR - LoadPlane(m_albedo.x, q);
+				const XMVECTOR dAlbedoG = albedoG - LoadPlane(m_albedo.y, q);
+				const XMVECTOR dAlbedoB = albedoB - LoadPlane(m_albedo.z, q);
+				const XMVECTOR dNormalX = normalX - LoadPlane(m_normal.x, q);
+				const XMVECTOR dNormalY = normalY - LoadPlane(m_normal.y, q);
+				const XMVECTOR dNormalZ = normalZ - LoadPlane(m_normal.z, q);
+				const XMVECTOR dDepth = XMVectorAbs(depth - LoadPlane(m_depth, q));
+
+				// All edge stopping terms share a single exponential
+				XMVECTOR distance = (dColorR * dColorR + dColorG * dColorG + dColorB * dColorB) * invColorSigmaSq;
+				distance += (dAlbedoR * dAlbedoR + dAlbedoG * dAlbedoG + dAlbedoB * dAlbedoB) * invAlbedoSigmaSq;
+				distance += (dNormalX * dNormalX + dNormalY * dNormalY + dNormalZ * dNormalZ) * invNormalSigmaSq;
+				distance += dDepth * invDepthScale * invTapDistance;
+
+				const float kernel = k_kernel[dx + 2] * k_kernel[dy + 2];
+				const XMVECTOR weight = kernel * LoadPlane(m_valid, q) * XMVectorExpE(-distance);
+
+				sumR += weight * qColorR;
+				sumG += weight * qColorG;
+				sumB += weight * qColorB;
+				sumWeight += weight;
+			}
+		}
+
+		const XMVECTOR invSumWeight = XMVectorReciprocal(XMVectorMax(sumWeight, minWeight));
+		StorePlane(destination.x, p, sumR * invSumWeight);
+		StorePlane(destination.y, p, sumG * invSumWeight);
+		StorePlane(destination.z, p, sumB * invSumWeight);
+	}
+}
+
+void Denoiser::Scatter(const Planes& source, const Framebuffer& input, Framebuffer& output) const
+{
+	ForEachIndex(output.GetTileCount(), [this, &source, &input, &output](uint32_t tileIndex)
+	{
+		Framebuffer::Tile& tile = output.GetTile(tileIndex);
+		const PixelRect rect = output.GetTileRect(tileIndex);
+		const uint32_t count = rect.right - rect.left;
+
+		for (uint32_t y = rect.top; y < rect.bottom; ++y)
+		{
+			const size_t from = GetIndex(rect.left, y);
+			const uint32_t to = (y - rect.top) * Framebuffer::k_tileSize;
+
+			std::copy_n(&source.x[from], count, &tile.r[to]);
+			std::copy_n(&source.y[from], count, &tile.g[to]);
+			std::copy_n(&source.z[from], count, &tile.b[to]);
+		}
+
+		tile.sampleCount = input.GetTile(tileIndex).sampleCount;
+	});
+}
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include "framebuffer.h"
+
+void Framebuffer::TileAccumulator::Add(uint32_t localIndex, const XMVECTOR& color)
+{
+	XMFLOAT3 c;
+	XMStoreFloat3(&c, color);
+
+	r[localIndex] += c.x;
+	g[localIndex] += c.y;
+	b[localIndex] += c.z;
+}
+
+void Framebuffer::TileAccumulator::AddAovs(uint32_t localIndex, const SurfaceAovs& surface)
+{
+	XMFLOAT3 albedo, normal;
+	XMStoreFloat3(&albedo, surface.albedo);
+	XMStoreFloat3(&normal, surface.normal);
+
+	aovs[0][localIndex] += albedo.x;
+	aovs[1][localIndex] += albedo.y;
+	aovs[2][localIndex] += albedo.z;
+	aovs[3][localIndex] += normal.x;
+	aovs[4][localIndex] += normal.y;
+	aovs[5][localIndex] += normal.z;
+	aovs[6][localIndex] += surface.depth;
+}
+
+void Framebuffer::Resize(uint32_t width, uint32_t height, bool withAovs)
+{
+	m_width = width;
+	m_height = height;
+	m_tileCountX = (width + k_tileSize - 1) / k_tileSize;
+
+	const uint32_t tileCountY = (height + k_tileSize - 1) / k_tileSize;
+	m_tiles.resize(static_cast<size_t>(m_tileCountX) * tileCountY);
+	m_aovTiles.resize(withAovs ? m_tiles.size() : 0);
+}
+
+void Framebuffer::Clear()
+{
+	for (uint32_t tileIndex = 0; tileIndex < GetTileCount(); ++tileIndex)
+	{
+		ClearTile(tileIndex);
+	}
+}
+
+void Framebuffer::ClearTile(uint32_t tileIndex)
+{
+	Tile& tile = m_tiles[tileIndex];
+	tile.r.fill(0.f);
+	tile.g.fill(0.f);
+	tile.b.fill(0.f);
+	tile.sampleCount = 0;
+
+	if (HasAovs())
+	{
+		AovTile& aovTile = m_aovTiles[tileIndex];
+		for (auto* plane : { &aovTile.albedoR, &aovTile.albedoG, &aovTile.albedoB, &aovTile.normalX, &aovTile.normalY, &aovTile.normalZ, &aovTile.depth })
+		{
+			plane->fill(0.f);
+		}
+	}
+}
+
+PixelRect Framebuffer::GetTileRect(uint32_t tileIndex) const
+{
+	const uint32_t left = (tileIndex % m_tileCountX) * k_tileSize;
+	const uint32_t top = (tileIndex / m_tileCountX) * k_tileSize;
+
+	return PixelRect{ left, top, std::min(left + k_tileSize, m_width), std::min(top + k_tileSize, m_height) };
+}
+
+XMVECTOR Framebuffer::GetPixel(uint32_t x, uint32_t y) const
+{
+	const Tile& tile = m_tiles[(y / k_tileSize) * m_tileCountX + x / k_tileSize];
+	const uint32_t localIndex = (y % k_tileSize) * k_tileSize + x % k_tileSize;
+
+	return XMVectorSet(tile.r[localIndex], tile.g[localIndex], tile.b[localIndex], 1.f);
+}
+
+void Framebuffer::Flush(uint32_t tileIndex, const TileAccumulator& accumulator)
+{
+	Tile& tile = m_tiles[tileIndex];
+
+	if (accumulator.sampleCount == 0)
+	{
+		return;
+	}
+
+	// Running mean: mean += (batch mean - mean) * batch / total
+	const uint32_t totalCount = tile.sampleCount + accumulator.sampleCount;
+	const double invBatch = 1.0 / accumulator.sampleCount;
+	const double weight = static_cast<double>(accumulator.sampleCount) / totalCount;
+
+	for (uint32_t i = 0; i < k_tilePixels; ++i)
+	{
+		tile.r[i] = static_cast<float>(tile.r[i] + (accumulator.r[i] * invBatch - tile.r[i]) * weight);
+		tile.g[i] = static_cast<float>(tile.g[i] + (accumulator.g[i] * invBatch - tile.g[i]) * weight);
+		tile.b[i] = static_cast<float>(tile.b[i] + (accumulator.b[i] * invBatch - tile.b[i]) * weight);
+	}
+
+	if (HasAovs())
+	{
+		AovTile& aovTile = m_aovTiles[tileIndex];
+		std::array<float, k_tilePixels>* planes[] = { &aovTile.albedoR, &aovTile.albedoG, &aovTile.albedoB, &aovTile.normalX, &aovTile.normalY, &aovTile.normalZ, &aovTile.depth };
+
+		for (size_t plane = 0; plane < accumulator.aovs.size(); ++plane)
+		{
+			std::array<float, k_tilePixels>& mean = *planes[plane];
+			for (uint32_t i = 0; i < k_tilePixels; ++i)
+			{
+				mean[i] = static_cast<float>(mean[i] + (accumulator.aovs[plane][i] * invBatch - mean[i]) * weight);
+			}
+		}
+	}
+
+	tile.sampleCount = totalCount;
+}
+
+size_t Framebuffer::GetMemoryUsage() const
+{
+	return m_tiles.capacity() * sizeof(Tile) + m_aovTiles.capacity() * sizeof(AovTile);
+}
+
+float Framebuffer::GetBytesPerPixel() const
+{
+	const size_t pixelCount = static_cast<size_t>(m_width) * m_height;
+	return pixelCount > 0 ? static_cast<float>(GetMemoryUsage()) / pixelCount : 0.f;
+}
\ No newline at end of file
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "stdafx.h"
+
+// Half-open pixel rectangle [left, right) x [top, bottom)
+struct PixelRect
+{
+	uint32_t left;
+	uint32_t top;
+	uint32_t right;
+	uint32_t bottom;
+};
+
+// First-hit surface attributes of a primary ray, used to guide the denoiser. Misses leave everything zero.
+struct SurfaceAovs
+{
+	XMVECTOR albedo = XM_Zero;
+	XMVECTOR normal = XM_Zero;
+	float depth = 0.f;
+};
+
+// HDR accumulation buffer stored as square tiles. Each tile keeps the running mean of its pixels in
+// separate R, G and B planes and occupies whole cache lines. A tile is written only by the thread that
+// traced it, so workers never share a cache line. Samples are summed in double precision per tile and
+// folded into the stored mean on Flush(), so the mean stays accurate after many thousands of samples.
+// Optionally the same tiling holds the running mean of albedo, normal and depth AOVs.
+// Resize() leaves the tiles untouched; the OS places a page on the NUMA node of the thread that first writes
+// it, so tiles should be cleared by the workers that will trace them.
+class Framebuffer
+{
+public:
+	static constexpr uint32_t k_tileSize = 16;
+	static constexpr uint32_t k_tilePixels = k_tileSize * k_tileSize;
+
+	struct alignas(64) Tile
+	{
+		std::array<float, k_tilePixels> r;
+		std::array<float, k_tilePixels> g;
+		std::array<float, k_tilePixels> b;
+		uint32_t sampleCount;
+	};
+
+	struct alignas(64) AovTile
+	{
+		std::array<float, k_tilePixels> albedoR;
+		std::array<float, k_tilePixels> albedoG;
+		std::array<float, k_tilePixels> albedoB;
+		std::array<float, k_tilePixels> normalX;
+		std::array<float, k_tilePixels> normalY;
+		std::array<float, k_tilePixels> normalZ;
+		std::array<float, k_tilePixels> depth;
+	};
+
+	// Thread-local sums for one tile, indexed like the tile planes. Every pixel receives sampleCount samples.
+	struct TileAccumulator
+	{
+		std::array<double, k_tilePixels> r;
+		std::array<double, k_tilePixels> g;
+		std::array<double, k_tilePixels> b;
+		std::array<std::array<double, k_tilePixels>, 7> aovs;	// same order as the AovTile planes
+		uint32_t sampleCount;
+
+		void Add(uint32_t localIndex, const XMVECTOR& color);
+		void AddAovs(uint32_t localIndex, const SurfaceAovs& surface);
+	};
+
+	// Tile contents are undefined until cleared
+	void Resize(uint32_t width, uint32_t height, bool withAovs = false);
+	void Clear();
+	void ClearTile(uint32_t tileIndex);
+
+	uint32_t GetWidth() const { return m_width; }
+	uint32_t GetHeight() const { return m_height; }
+	uint32_t GetTileCount() const { return static_cast<uint32_t>(m_tiles.size()); }
+	uint32_t GetTileCountX() const { return m_tileCountX; }
+
+	// Pixels covered by a tile, clipped to the image
+	PixelRect GetTileRect(uint32_t tileIndex) const;
+	const Tile& GetTile(uint32_t tileIndex) const { return m_tiles[tileIndex]; }
+	Tile& GetTile(uint32_t tileIndex) { return m_tiles[tileIndex]; }
+	bool HasAovs() const { return !m_aovTiles.empty(); }
+	const AovTile& GetAovTile(uint32_t tileIndex) const { return m_aovTiles[tileIndex]; }
+	XMVECTOR GetPixel(uint32_t x, uint32_t y) const;
+
+	// Only the thread that owns the tile may flush into it
+	void Flush(uint32_t tileIndex, const TileAccumulator& accumulator);
+
+	size_t GetMemoryUsage() const;
+	float GetBytesPerPixel() const;
+
+private:
+	// Default-initializes elements instead of zeroing them, so resizing does not touch the new pages
+	template <typename T>
+	struct UninitializedAllocator : std::allocator<T>
+	{
+		template <typename U>
+		struct rebind
+		{
+			using other = UninitializedAllocator<U>;
+		};
+
+		UninitializedAllocator() = default;
+
+		template <typename U>
+		UninitializedAllocator(const UninitializedAllocator<U>&) noexcept {}
+
+		template <typename U>
+		void construct(U* p) noexcept
+		{
+			::new (static_cast<void*>(p)) U;
+		}
+	};
+
+	std::vector<Tile, UninitializedAllocator<Tile>> m_tiles;
+	std::vector<AovTile, UninitializedAllocator<AovTile>> m_aovTiles;
+	uint32_t m_width = 0;
+	uint32_t m_height = 0;
+	uint32_t m_tileCountX = 0;
+};
\ No newline at end of file
@@ -0,0 +1,271 @@
+#include "image-io.h"
+
+namespace
+{
+	XMFLOAT3 DecodeRgbe(const uint8_t rgbe[4])
+	{
+		if (rgbe[3] == 0)
+		{
+			return XMFLOAT3(0.f, 0.f, 0.f);
+		}
+
+		const float scale = std::ldexp(1.f, static_cast<int>(rgbe[3]) - (128 + 8));
+		return XMFLOAT3(rgbe[0] * scale, rgbe[1] * scale, rgbe[2] * scale);
+	}
+
+	bool ReadHdrScanline(std::ifstream& file, uint32_t width, std::vector<uint8_t>& outRgbe)
+	{
+		uint8_t header[4];
+		file.read(reinterpret_cast<char*>(header), 4);
+
+		const bool isRle = header[0] == 2 && header[1] == 2 && (header[2] & 0x80) == 0 && width >= 8 && width < 32768;
+
+		if (!isRle)
+		{
+			// Flat scanline
+			std::copy(header, header + 4, outRgbe.begin());
+			file.read(reinterpret_cast<char*>(outRgbe.data() + 4), 4ull * (width - 1));
+			return static_cast<bool>(file);
+		}
+
+		if (((header[2] << 8) | header[3]) != static_cast<int>(width))
+		{
+			return false;
+		}
+
+		// Each of the four channels is run length encoded separately
+		for (uint32_t channel = 0; channel < 4; ++channel)
+		{
+			uint32_t x = 0;
+			while (x < width)
+			{
+				uint8_t count = static_cast<uint8_t>(file.get());
+
+				if (count > 128)
+				{
+					count -= 128;
+					const uint8_t value = static_cast<uint8_t>(file.get());
+					for (uint8_t i = 0; i < count && x < width; ++i, ++x)
+					{
+						outRgbe[4 * x + channel] = value;
+					}
+				}
+				else
+				{
+					for (uint8_t i = 0; i < count && x < width; ++i, ++x)
+					{
+						outRgbe[4 * x + channel] = static_cast<uint8_t>(file.get());
+					}
+				}
+
+				if (!file || count == 0)
+				{
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+}
+
+bool ImageIO::ReadPpm(const std::string& path, std::vector<XMCOLOR>& outTexels, uint32_t& outWidth, uint32_t& outHeight)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	// Header tokens, skipping '#' comments
+	auto readToken = [&file]() -> std::string
+	{
+		std::string token;
+		while (file >> token && token[0] == '#')
+		{
+			file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+		}
+		return token;
+	};
+
+	// Decimal digits only, so a malformed header fails instead of wrapping or throwing
+	auto readNumber = [&readToken](uint32_t& value) -> bool
+	{
+		const std::string token = readToken();
+		if (token.empty() || !std::all_of(token.cbegin(), token.cend(), [](char c) { return c >= '0' && c <= '9'; }))
+		{
+			return false;
+		}
+
+		std::istringstream number(token);
+		return static_cast<bool>(number >> value);
+	};
+
+	if (readToken() != "P6")
+	{
+		return false;
+	}
+
+	uint32_t maxValue;
+	if (!readNumber(outWidth) || !readNumber(outHeight) || !readNumber(maxValue))
+	{
+		return false;
+	}
+	file.get();
+
+	if (maxValue != 255 || outWidth == 0 || outHeight == 0)
+	{
+		return false;
+	}
+
+	std::vector<uint8_t> rgb(3ull * outWidth * outHeight);
+	file.read(reinterpret_cast<char*>(rgb.data()), rgb.size());
+
+	outTexels.resize(static_cast<size_t>(outWidth) * outHeight);
+	for (size_t i = 0; i < outTexels.size(); ++i)
+	{
+		outTexels[i].r = rgb[3 * i + 0];
+		outTexels[i].g = rgb[3 * i + 1];
+		outTexels[i].b = rgb[3 * i + 2];
+		outTexels[i].a = 255;
+	}
+
+	return static_cast<bool>(file);
+}
+
+bool ImageIO::WritePpm(const std::string& path, const std::vector<XMCOLOR>& texels, uint32_t width, uint32_t height)
+{
+	assert(texels.size() == static_cast<size_t>(width) * height);
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	file << "P6\n" << width << " " << height << "\n255\n";
+
+	std::vector<uint8_t> rgb(3 * texels.size());
+	for (size_t i = 0; i < texels.size(); ++i)
+	{
+		rgb[3 * i + 0] = static_cast<uint8_t>(texels[i].r);
+		rgb[3 * i + 1] = static_cast<uint8_t>(texels[i].g);
+		rgb[3 * i + 2] = static_cast<uint8_t>(texels[i].b);
+	}
+
+	file.write(reinterpret_cast<const char*>(rgb.data()), rgb.size());
+	return static_cast<bool>(file);
+}
+
+bool ImageIO::ReadRadianceHdr(const std::string& path, std::vector<XMFLOAT3>& outTexels, uint32_t& outWidth, uint32_t& outHeight)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	std::string line;
+	std::getline(file, line);
+	if (line.rfind("#?", 0) != 0)
+	{
+		return false;
+	}
+
+	// Header lines until an empty line, then the resolution string
+	bool isRgbe = false;
+	while (std::getline(file, line) && !line.empty())
+	{
+		isRgbe |= (line == "FORMAT=32-bit_rle_rgbe");
+	}
+
+	if (!isRgbe || !std::getline(file, line))
+	{
+		return false;
+	}
+
+	// Only the standard top-to-bottom, left-to-right orientation is supported
+	std::istringstream resolution(line);
+	std::string yLabel, xLabel;
+	if (!(resolution >> yLabel >> outHeight >> xLabel >> outWidth) || yLabel != "-Y" || xLabel != "+X" ||
+		outWidth == 0 || outHeight == 0)
+	{
+		return false;
+	}
+
+	outTexels.resize(static_cast<size_t>(outWidth) * outHeight);
+	std::vector<uint8_t> scanline(4ull * outWidth);
+
+	for (uint32_t y = 0; y < outHeight; ++y)
+	{
+		if (!ReadHdrScanline(file, outWidth, scanline))
+		{
+			return false;
+		}
+
+		for (uint32_t x = 0; x < outWidth; ++x)
+		{
+			outTexels[static_cast<size_t>(y) * outWidth + x] = DecodeRgbe(&scanline[4 * x]);
+		}
+	}
+
+	return true;
+}
+
+bool ImageIO::ReadPfm(const std::string& path, std::vector<XMFLOAT3>& outTexels, uint32_t& outWidth, uint32_t& outHeight)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	std::string magic;
+	float scale = 0.f;
+	if (!(file >> magic >> outWidth >> outHeight >> scale) || magic != "PF" || outWidth == 0 || outHeight == 0)
+	{
+		return false;
+	}
+	file.get();
+
+	// A negative scale marks little endian data, the only kind written here
+	if (scale >= 0.f)
+	{
+		return false;
+	}
+
+	outTexels.resize(static_cast<size_t>(outWidth) * outHeight);
+
+	// Scanlines are stored bottom to top
+	for (uint32_t y = outHeight; y-- > 0;)
+	{
+		file.read(reinterpret_cast<char*>(&outTexels[static_cast<size_t>(y) * outWidth]), sizeof(XMFLOAT3) * outWidth);
+	}
+
+	return static_cast<bool>(file);
+}
+
+bool ImageIO::WritePfm(const std::string& path, const std::vector<XMFLOAT3>& texels, uint32_t width, uint32_t height)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	return WritePfm(file, texels, width, height);
+}
+
+bool ImageIO::WritePfm(std::ostream& stream, const std::vector<XMFLOAT3>& texels, uint32_t width, uint32_t height)
+{
+	assert(texels.size() == static_cast<size_t>(width) * height);
+
+	stream << "PF\n" << width << " " << height << "\n-1.0\n";
+
+	for (uint32_t y = height; y-- > 0;)
+	{
+		stream.write(reinterpret_cast<const char*>(&texels[static_cast<size_t>(y) * width]), sizeof(XMFLOAT3) * width);
+	}
+
+	return static_cast<bool>(stream);
+}
\ No newline at end of file
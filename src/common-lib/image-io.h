@@ -0,0 +1,19 @@
+#pragma once
+
+#include "stdafx.h"
+
+namespace ImageIO
+{
+	// Binary PPM (P6), 8 bits per channel
+	bool ReadPpm(const std::string& path, std::vector<XMCOLOR>& outTexels, uint32_t& outWidth, uint32_t& outHeight);
+	bool WritePpm(const std::string& path, const std::vector<XMCOLOR>& texels, uint32_t width, uint32_t height);
+
+	// Radiance RGBE (.hdr), flat or new-style run length encoded scanlines
+	bool ReadRadianceHdr(const std::string& path, std::vector<XMFLOAT3>& outTexels, uint32_t& outWidth, uint32_t& outHeight);
+
+	// Portable float map (PF), 32-bit float RGB. Lossless, unlike RGBE, so suited to reference images.
+	bool ReadPfm(const std::string& path, std::vector<XMFLOAT3>& outTexels, uint32_t& outWidth, uint32_t& outHeight);
+	bool WritePfm(const std::string& path, const std::vector<XMFLOAT3>& texels, uint32_t width, uint32_t height);
+	// E.g. into a buffer that is sent to another process
+	bool WritePfm(std::ostream& stream, const std::vector<XMFLOAT3>& texels, uint32_t width, uint32_t height);
+};
\ No newline at end of file
@@ -0,0 +1,252 @@
+#include "light-bvh.h"
+
+namespace
+{
+	XMVECTOR RotateAbout(const XMVECTOR& v, const XMVECTOR& axis, float angle)
+	{
+		// Rodrigues' rotation formula
+		const float c = std::cos(angle);
+		const float s = std::sin(angle);
+		return c * v + s * XMVector3Cross(axis, v) + (1.f - c) * XMVector3Dot(axis, v) * axis;
+	}
+}
+
+void LightBvh::Build(const std::vector<std::unique_ptr<Light>>& lights)
+{
+	m_nodes.clear();
+	m_infiniteLights.clear();
+	m_bitTrails.assign(lights.size(), k_noTrail);
+
+	std::vector<BuildEntry> entries;
+	for (uint32_t i = 0; i < lights.size(); ++i)
+	{
+		if (auto bounds = lights[i]->GetBounds(); bounds && bounds->power > 0.f)
+		{
+			entries.push_back(BuildEntry{ i, *bounds });
+		}
+		else if (!bounds)
+		{
+			m_infiniteLights.push_back(i);
+		}
+	}
+
+	if (!entries.empty())
+	{
+		m_nodes.reserve(2 * entries.size() - 1);
+		BuildRecursive(entries.begin(), entries.end(), 0, 0);
+	}
+}
+
+uint32_t LightBvh::BuildRecursive(std::vector<BuildEntry>::iterator begin, std::vector<BuildEntry>::iterator end, uint64_t bitTrail, int depth)
+{
+	assert(depth < 64 && L"Light BVH too deep for the bit trail");
+
+	const auto nodeIndex = static_cast<uint32_t>(m_nodes.size());
+	const size_t n = std::distance(begin, end);
+
+	if (n == 1)
+	{
+		m_nodes.push_back(Node{ begin->bounds, 0, begin->lightId });
+		m_bitTrails[begin->lightId] = bitTrail;
+		return nodeIndex;
+	}
+
+	// Split at the median centroid along the axis of largest centroid extent
+	XMVECTOR centroidMin = XMVectorReplicate(std::numeric_limits<float>::max());
+	XMVECTOR centroidMax = -centroidMin;
+	for (auto it = begin; it != end; ++it)
+	{
+		const XMVECTOR centroid = 0.5f * (XMLoadFloat3(&it->bounds.boundsMin) + XMLoadFloat3(&it->bounds.boundsMax));
+		centroidMin = XMVectorMin(centroidMin, centroid);
+		centroidMax = XMVectorMax(centroidMax, centroid);
+	}
+
+	XMFLOAT3 extent;
+	XMStoreFloat3(&extent, centroidMax - centroidMin);
+	const int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+
+	auto centroidOnAxis = [axis](const BuildEntry& e)
+	{
+		const float* lo = &e.bounds.boundsMin.x;
+		const float* hi = &e.bounds.boundsMax.x;
+		return lo[axis] + hi[axis];
+	};
+
+	const auto mid = begin + n / 2;
+	std::nth_element(begin, mid, end, [&centroidOnAxis](const BuildEntry& a, const BuildEntry& b)
+	{
+		return centroidOnAxis(a) < centroidOnAxis(b);
+	});
+
+	m_nodes.push_back(Node{});
+	const uint32_t left = BuildRecursive(begin, mid, bitTrail, depth + 1);
+	const uint32_t right = BuildRecursive(mid, end, bitTrail | (1ull << depth), depth + 1);
+
+	m_nodes[nodeIndex].bounds = Union(m_nodes[left].bounds, m_nodes[right].bounds);
+	m_nodes[nodeIndex].secondChild = right;
+	m_nodes[nodeIndex].lightId = k_invalidId;
+
+	return nodeIndex;
+}
+
+uint32_t LightBvh::Sample(const XMVECTOR& pos, float u, float& outPmf) const
+{
+	XMFLOAT3 p;
+	XMStoreFloat3(&p, pos);
+
+	if (m_nodes.empty() || Importance(m_nodes[0].bounds, p) <= 0.f)
+	{
+		return k_invalidId;
+	}
+
+	uint32_t index = 0;
+	float pmf = 1.f;
+
+	while (m_nodes[index].lightId == k_invalidId)
+	{
+		const uint32_t children[2] = { index + 1, m_nodes[index].secondChild };
+		const float w0 = Importance(m_nodes[children[0]].bounds, p);
+		const float w1 = Importance(m_nodes[children[1]].bounds, p);
+
+		if (w0 <= 0.f && w1 <= 0.f)
+		{
+			return k_invalidId;
+		}
+
+		// Pick a child and remap u so it can be reused further down
+		const float p0 = w0 / (w0 + w1);
+		if (u < p0)
+		{
+			index = children[0];
+			u = std::min(u / p0, 0.99999994f);
+			pmf *= p0;
+		}
+		else
+		{
+			index = children[1];
+			u = std::min((u - p0) / (1.f - p0), 0.99999994f);
+			pmf *= 1.f - p0;
+		}
+	}
+
+	outPmf = pmf;
+	return m_nodes[index].lightId;
+}
+
+float LightBvh::Pmf(const XMVECTOR& pos, uint32_t lightId) const
+{
+	if (lightId >= m_bitTrails.size() || m_bitTrails[lightId] == k_noTrail)
+	{
+		return 0.f;
+	}
+
+	XMFLOAT3 p;
+	XMStoreFloat3(&p, pos);
+
+	uint64_t bits = m_bitTrails[lightId];
+	uint32_t index = 0;
+	float pmf = 1.f;
+
+	// Replay the decisions Sample() would have made on the way to this light
+	while (m_nodes[index].lightId == k_invalidId)
+	{
+		const uint32_t children[2] = { index + 1, m_nodes[index].secondChild };
+		const float w0 = Importance(m_nodes[children[0]].bounds, p);
+		const float w1 = Importance(m_nodes[children[1]].bounds, p);
+
+		if (w0 <= 0.f && w1 <= 0.f)
+		{
+			return 0.f;
+		}
+
+		const uint32_t choice = bits & 1;
+		pmf *= (choice ? w1 : w0) / (w0 + w1);
+		index = children[choice];
+		bits >>= 1;
+	}
+
+	return pmf;
+}
+
+float LightBvh::Importance(const LightBounds& bounds, const XMFLOAT3& pos)
+{
+	const XMVECTOR boundsMin = XMLoadFloat3(&bounds.boundsMin);
+	const XMVECTOR boundsMax = XMLoadFloat3(&bounds.boundsMax);
+	const XMVECTOR p = XMLoadFloat3(&pos);
+	const XMVECTOR center = 0.5f * (boundsMin + boundsMax);
+
+	// Clamp the distance so points close to or inside the bounds do not blow up the estimate
+	const float halfDiagonalSq = XMVectorGetX(XMVector3LengthSq(0.5f * (boundsMax - boundsMin)));
+	const float distanceSq = std::max(XMVectorGetX(XMVector3LengthSq(p - center)), halfDiagonalSq);
+
+	if (bounds.cosThetaO <= -1.f)
+	{
+		// Emits in every direction
+		return bounds.power / std::max(distanceSq, 1e-6f);
+	}
+
+	// Angle between the emission axis and the shading point, reduced by the cone spread and the angle the bounds subtend
+	const XMVECTOR toPoint = XMVector3Normalize(p - center);
+	const float cosThetaW = std::clamp(XMVectorGetX(XMVector3Dot(XMLoadFloat3(&bounds.axis), toPoint)), -1.f, 1.f);
+	const float sinThetaBSq = std::min(halfDiagonalSq / distanceSq, 1.f);
+	const float thetaB = std::asin(std::sqrt(sinThetaBSq));
+
+	const float thetaPrime = std::max(0.f, std::acos(cosThetaW) - std::acos(bounds.cosThetaO) - thetaB);
+	const float cosThetaPrime = std::cos(thetaPrime);
+
+	if (cosThetaPrime <= bounds.cosThetaE)
+	{
+		return 0.f;
+	}
+
+	return bounds.power * cosThetaPrime / std::max(distanceSq, 1e-6f);
+}
+
+LightBounds LightBvh::Union(const LightBounds& a, const LightBounds& b)
+{
+	LightBounds result;
+	XMStoreFloat3(&result.boundsMin, XMVectorMin(XMLoadFloat3(&a.boundsMin), XMLoadFloat3(&b.boundsMin)));
+	XMStoreFloat3(&result.boundsMax, XMVectorMax(XMLoadFloat3(&a.boundsMax), XMLoadFloat3(&b.boundsMax)));
+	result.power = a.power + b.power;
+	result.cosThetaE = std::min(a.cosThetaE, b.cosThetaE);
+	result.axis = a.axis;
+	result.cosThetaO = -1.f;
+
+	if (a.cosThetaO <= -1.f || b.cosThetaO <= -1.f)
+	{
+		return result;
+	}
+
+	// Smallest cone containing both emission cones
+	const XMVECTOR axisA = XMLoadFloat3(&a.axis);
+	const XMVECTOR axisB = XMLoadFloat3(&b.axis);
+	const float thetaA = std::acos(std::clamp(a.cosThetaO, -1.f, 1.f));
+	const float thetaB = std::acos(std::clamp(b.cosThetaO, -1.f, 1.f));
+	const float thetaD = std::acos(std::clamp(XMVectorGetX(XMVector3Dot(axisA, axisB)), -1.f, 1.f));
+
+	if (std::min(thetaD + thetaB, XM_PI) <= thetaA)
+	{
+		result.axis = a.axis;
+		result.cosThetaO = a.cosThetaO;
+		return result;
+	}
+
+	if (std::min(thetaD + thetaA, XM_PI) <= thetaB)
+	{
+		result.axis = b.axis;
+		result.cosThetaO = b.cosThetaO;
+		return result;
+	}
+
+	const float thetaO = 0.5f * (thetaA + thetaD + thetaB);
+	const XMVECTOR rotationAxis = XMVector3Cross(axisA, axisB);
+
+	if (thetaO >= XM_PI || XMVectorGetX(XMVector3LengthSq(rotationAxis)) < 1e-12f)
+	{
+		return result;
+	}
+
+	XMStoreFloat3(&result.axis, RotateAbout(axisA, XMVector3Normalize(rotationAxis), thetaO - thetaA));
+	result.cosThetaO = std::cos(thetaO);
+	return result;
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "stdafx.h"
+#include "light.h"
+
+// Bounding volume hierarchy over lights with finite extent. Each node stores the spatial bounds, total power
+// and emission cone of the lights below it. A shading point descends the tree once, choosing a child in
+// proportion to its estimated contribution, so picking a light costs O(log n) regardless of the light count.
+// Lights without bounds (sun, sky) are kept in a separate list and evaluated at every shading point.
+class LightBvh
+{
+public:
+	void Build(const std::vector<std::unique_ptr<Light>>& lights);
+
+	const std::vector<uint32_t>& GetInfiniteLights() const { return m_infiniteLights; }
+
+	// Returns k_invalidId when no bounded light can contribute to pos
+	uint32_t Sample(const XMVECTOR& pos, float u, float& outPmf) const;
+	float Pmf(const XMVECTOR& pos, uint32_t lightId) const;
+
+	size_t GetNodeCount() const { return m_nodes.size(); }
+
+private:
+	struct Node
+	{
+		LightBounds bounds;
+		uint32_t secondChild;	// interior nodes: the first child immediately follows its parent
+		uint32_t lightId;		// leaves: index into the light list, k_invalidId for interior nodes
+	};
+
+	// Trail of lights that are not in the tree: unbounded or powerless. Real trails never set bit 63, since
+	// the tree is less than 64 levels deep.
+	static constexpr uint64_t k_noTrail = ~uint64_t{ 0 };
+
+	struct BuildEntry
+	{
+		uint32_t lightId;
+		LightBounds bounds;
+	};
+
+	uint32_t BuildRecursive(std::vector<BuildEntry>::iterator begin, std::vector<BuildEntry>::iterator end, uint64_t bitTrail, int depth);
+	static float Importance(const LightBounds& bounds, const XMFLOAT3& pos);
+	static LightBounds Union(const LightBounds& a, const LightBounds& b);
+
+private:
+	std::vector<Node> m_nodes;
+	std::vector<uint32_t> m_infiniteLights;
+	// Per light id, the left/right decisions from the root, LSB first. Light ids are dense, so a plain array keeps
+	// Pmf at one load before its O(log n) replay.
+	std::vector<uint64_t> m_bitTrails;
+};
\ No newline at end of file
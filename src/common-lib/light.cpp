@@ -8,7 +8,31 @@ DirectionalLight::DirectionalLight(const XMVECTOR& dir, const XMCOLOR& color, co
 	m_color = XMLoadColor(&color);
 }
 
-XMVECTOR DirectionalLight::Shade(const class Material* material, const Payload& payload, const XMVECTOR& viewOrigin) const
+XMVECTOR Light::ShadeAnalytic(const Material& material, const Payload& payload, const XMVECTOR& lightDir, const XMVECTOR& radiance, const XMVECTOR& viewOrigin)
+{
+	XMVECTOR albedo = material.GetAlbedo(payload.uv, payload.uvFootprint);
+	XMVECTOR f0 = material.GetReflectance(payload.uv, payload.uvFootprint);
+	XMVECTOR smoothness = material.GetSmoothness(payload.uv);
+
+	// Incoming light
+	XMVECTOR nDotL = XMVectorSaturate(XMVector3Dot(payload.normal, lightDir));
+	XMVECTOR radianceIn = radiance * nDotL;
+
+	// Diffuse
+	XMVECTOR diffuseBRDF = albedo;
+
+	// Specular
+	XMVECTOR viewDir = XMVector3Normalize(viewOrigin - payload.pos);
+	XMVECTOR halfVector = XMVector3Normalize(lightDir + viewDir);
+	XMVECTOR nDotH = XMVectorSaturate(XMVector3Dot(payload.normal, halfVector));
+	XMVECTOR nDotV = XMVectorSaturate(XMVector3Dot(viewDir, payload.normal));
+	XMVECTOR reflectance = f0 + (XM_One - f0) * XMVectorPow(XM_One - nDotV, XMVectorReplicate(5.f));
+	XMVECTOR specularBRDF = reflectance * 0.125f * (smoothness + XMVectorReplicate(8.f)) * XMVectorPow(nDotH, smoothness);
+
+	return radianceIn * (diffuseBRDF + specularBRDF);
+}
+
+XMVECTOR DirectionalLight::Shade(const Material& material, const Ray& ray, const Payload& payload, SampleContext& sampler, const XMVECTOR& viewOrigin, float selectionPmf) const
 {
 	Ray shadowRay{ payload.pos, m_direction };
 
@@ -18,25 +42,245 @@ XMVECTOR DirectionalLight::Shade(const class Material* material, const Payload&
 	}
 	else
 	{
-		XMVECTOR albedo = material->GetAlbedo(payload.uv);
-		XMVECTOR f0 = material->GetReflectance(payload.uv);
-		XMVECTOR smoothness = material->GetSmoothness(payload.uv);
+		return ShadeAnalytic(material, payload, m_direction, m_luminance * m_color, viewOrigin) / selectionPmf;
+	}
+}
+
+PointLight::PointLight(const XMVECTOR& pos, const XMCOLOR& color, const float intensity, std::function<bool(const Ray& ray, Payload& payload)> closestIntersection) :
+	m_position{ pos }, m_intensity{ intensity }, Intersect{ std::move(closestIntersection) }
+{
+	m_color = XMLoadColor(&color);
+}
+
+XMVECTOR PointLight::Shade(const Material& material, const Ray& ray, const Payload& payload, SampleContext& sampler, const XMVECTOR& viewOrigin, float selectionPmf) const
+{
+	const XMVECTOR toLight = m_position - payload.pos;
+	const float distanceSq = XMVectorGetX(XMVector3LengthSq(toLight));
+	const float distance = std::sqrt(distanceSq);
+	const XMVECTOR lightDir = toLight / distance;
+
+	// Occluded if anything is hit before the light
+	Payload blocker{};
+	if (Intersect(Ray{ payload.pos, lightDir }, blocker) && XMVectorGetX(blocker.t) < distance)
+	{
+		return XM_Zero;
+	}
+
+	return ShadeAnalytic(material, payload, lightDir, (m_intensity / distanceSq) * m_color, viewOrigin) / selectionPmf;
+}
+
+std::optional<LightBounds> PointLight::GetBounds() const
+{
+	XMFLOAT3 p;
+	XMStoreFloat3(&p, m_position);
+
+	XMFLOAT3 c;
+	XMStoreFloat3(&c, m_color);
+
+	const float power = 4.f * XM_PI * m_intensity * (0.2126f * c.x + 0.7152f * c.y + 0.0722f * c.z);
+	return LightBounds{ p, p, XMFLOAT3(0.f, 0.f, 1.f), -1.f, 0.f, power };
+}
+
+EnvironmentLight::EnvironmentLight(std::vector<XMFLOAT3>&& radiance, uint32_t width, uint32_t height, const float luminance, std::function<bool(const Ray& ray)> lightOcclusionTest) :
+	m_radiance{ std::move(radiance) }, m_width{ width }, m_height{ height }, m_luminance{ luminance }, IsOccluded{ std::move(lightOcclusionTest) }
+{
+	// Texel weights are luminance scaled by the solid angle the texel row covers
+	std::vector<float> weights(m_radiance.size());
+	for (uint32_t y = 0; y < m_height; ++y)
+	{
+		const float sinTheta = std::sin(XM_PI * (y + 0.5f) / m_height);
+
+		for (uint32_t x = 0; x < m_width; ++x)
+		{
+			const XMFLOAT3& c = m_radiance[y * m_width + x];
+			weights[y * m_width + x] = (0.2126f * c.x + 0.7152f * c.y + 0.0722f * c.z) * sinTheta;
+		}
+	}
+
+	m_distribution = AliasTable{ weights };
+}
+
+uint32_t EnvironmentLight::GetTexelIndex(const XMVECTOR& dir) const
+{
+	XMFLOAT3 d;
+	XMStoreFloat3(&d, dir);
+
+	const float u = (std::atan2(d.z, d.x) + XM_PI) / (2.f * XM_PI);
+	const float v = std::acos(std::clamp(d.y, -1.f, 1.f)) / XM_PI;
+
+	const auto x = std::min(static_cast<uint32_t>(u * m_width), m_width - 1);
+	const auto y = std::min(static_cast<uint32_t>(v * m_height), m_height - 1);
+
+	return y * m_width + x;
+}
+
+XMVECTOR EnvironmentLight::Evaluate(const XMVECTOR& dir) const
+{
+	return m_luminance * XMLoadFloat3(&m_radiance[GetTexelIndex(dir)]);
+}
+
+float EnvironmentLight::Pdf(const Ray& ray) const
+{
+	const XMVECTOR& dir = ray.direction;
+
+	// Texels are sampled uniformly in (u,v), so the solid angle density picks up the lat-long Jacobian 2*pi^2*sin(theta)
+	const float cosTheta = std::clamp(XMVectorGetY(dir), -1.f, 1.f);
+	const float sinTheta = std::sqrt(1.f - cosTheta * cosTheta);
+
+	if (sinTheta <= 0.f)
+	{
+		return 0.f;
+	}
+
+	const float pmf = m_distribution.GetPmf(GetTexelIndex(dir));
+	return pmf * m_width * m_height / (2.f * XM_PI * XM_PI * sinTheta);
+}
+
+XMVECTOR EnvironmentLight::Sample(XMFLOAT2 uTexel, XMFLOAT2 uJitter, XMVECTOR& outDir, float& outPdf) const
+{
+	const uint32_t index = m_distribution.Sample(uTexel.x, uTexel.y);
+	const uint32_t x = index % m_width;
+	const uint32_t y = index / m_width;
+
+	// Uniform position inside the texel
+	const float theta = XM_PI * (y + uJitter.y) / m_height;
+	const float phi = 2.f * XM_PI * (x + uJitter.x) / m_width - XM_PI;
+	const float sinTheta = std::sin(theta);
+
+	outDir = XMVectorSet(sinTheta * std::cos(phi), std::cos(theta), sinTheta * std::sin(phi), 0.f);
+	outPdf = sinTheta > 0.f ? m_distribution.GetPmf(index) * m_width * m_height / (2.f * XM_PI * XM_PI * sinTheta) : 0.f;
+
+	return m_luminance * XMLoadFloat3(&m_radiance[index]);
+}
+
+XMVECTOR EnvironmentLight::Shade(const Material& material, const Ray& ray, const Payload& payload, SampleContext& sampler, const XMVECTOR& viewOrigin, float selectionPmf) const
+{
+	// Only the diffuse lobe has a non-delta sampling strategy to combine with. Mirror reflection and refraction
+	// reach the environment through Scatter() with full weight.
+	const float diffuseProbability = material.GetDiffuseScatterProbability(ray, payload);
+	if (diffuseProbability <= 0.f)
+	{
+		return XM_Zero;
+	}
+
+	const XMFLOAT2 texelSample = sampler.Next2D();
+	const XMFLOAT2 jitterSample = sampler.Next2D();
+
+	XMVECTOR lightDir;
+	float lightPdf;
+	const XMVECTOR radianceIn = Sample(texelSample, jitterSample, lightDir, lightPdf);
+
+	if (lightPdf <= 0.f || !XMVector3Greater(XMVector3Dot(payload.normal, lightDir), XM_Zero))
+	{
+		return XM_Zero;
+	}
+
+	if (IsOccluded(Ray{ payload.pos, lightDir }))
+	{
+		return XM_Zero;
+	}
 
-		// Incoming light
-		XMVECTOR nDotL = XMVectorSaturate(XMVector3Dot(payload.normal, m_direction));
-		XMVECTOR radianceIn = m_luminance * m_color * nDotL;
+	// The diffuse scatter estimator weights incoming radiance by the albedo at the uniform hemisphere density,
+	// so the equivalent light sampled estimate is albedo * L * hemispherePdf / lightPdf.
+	const float misWeight = PowerHeuristic(lightPdf, Sampler::k_hemispherePdf);
+	const XMVECTOR albedo = material.GetAlbedo(payload.uv, payload.uvFootprint);
 
-		// Diffuse
-		XMVECTOR diffuseBRDF = albedo;
+	return diffuseProbability * albedo * radianceIn * (Sampler::k_hemispherePdf * misWeight / (selectionPmf * lightPdf));
+}
 
-		// Specular
-		XMVECTOR viewDir = XMVector3Normalize(viewOrigin - payload.pos);
-		XMVECTOR halfVector = XMVector3Normalize(m_direction + viewDir);
-		XMVECTOR nDotH = XMVectorSaturate(XMVector3Dot(payload.normal, halfVector));
-		XMVECTOR nDotV = XMVectorSaturate(XMVector3Dot(viewDir, payload.normal));
-		XMVECTOR reflectance = f0 + (XM_One - f0) * XMVectorPow(XM_One - nDotV, XMVectorReplicate(5.f));
-		XMVECTOR specularBRDF = reflectance * 0.125f * (smoothness + XMVectorReplicate(8.f)) * XMVectorPow(nDotH, smoothness);
+SphereLight::SphereLight(const Sphere& sphere, uint32_t lightId, const MaterialTable& materials, std::function<bool(const Ray& ray, Payload& payload)> closestIntersection) :
+	m_center{ sphere.GetCenter() }, m_radius{ sphere.radius }, m_lightId{ lightId }, m_materialId{ sphere.materialId }, m_materials{ materials }, Intersect{ std::move(closestIntersection) }
+{
+}
+
+float SphereLight::Pdf(const Ray& ray) const
+{
+	const float distanceSq = XMVectorGetX(XMVector3LengthSq(m_center - ray.origin));
+	const float radiusSq = m_radius * m_radius;
 
-		return radianceIn * (diffuseBRDF + specularBRDF);
+	if (distanceSq <= radiusSq)
+	{
+		return 0.f;
 	}
+
+	const float cosThetaMax = std::sqrt(1.f - radiusSq / distanceSq);
+	return 1.f / (2.f * XM_PI * (1.f - cosThetaMax));
+}
+
+std::optional<LightBounds> SphereLight::GetBounds() const
+{
+	XMFLOAT3 c;
+	XMStoreFloat3(&c, m_center);
+
+	const Material& material = m_materials.Get(m_materialId);
+	XMFLOAT3 color;
+	XMStoreFloat3(&color, material.texture.Evaluate(XMFLOAT2(0.5f, 0.5f)));
+
+	// Lambertian emitter: power = pi * radiance * area. Normals cover every direction.
+	const float radiance = material.luminance * (0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z);
+	const float power = XM_PI * radiance * 4.f * XM_PI * m_radius * m_radius;
+
+	return LightBounds{
+		XMFLOAT3(c.x - m_radius, c.y - m_radius, c.z - m_radius),
+		XMFLOAT3(c.x + m_radius, c.y + m_radius, c.z + m_radius),
+		XMFLOAT3(0.f, 0.f, 1.f), -1.f, 0.f, power };
+}
+
+XMVECTOR SphereLight::Shade(const Material& material, const Ray& ray, const Payload& payload, SampleContext& sampler, const XMVECTOR& viewOrigin, float selectionPmf) const
+{
+	const float diffuseProbability = material.GetDiffuseScatterProbability(ray, payload);
+	if (diffuseProbability <= 0.f)
+	{
+		return XM_Zero;
+	}
+
+	const XMVECTOR toCenter = m_center - payload.pos;
+	const float distanceSq = XMVectorGetX(XMVector3LengthSq(toCenter));
+	const float radiusSq = m_radius * m_radius;
+
+	if (distanceSq <= radiusSq)
+	{
+		return XM_Zero;
+	}
+
+	// Uniform direction inside the cone subtended by the sphere
+	const XMFLOAT2 u = sampler.Next2D();
+	const float u1 = u.x;
+	const float u2 = u.y;
+
+	const float cosThetaMax = std::sqrt(1.f - radiusSq / distanceSq);
+	const float cosTheta = 1.f - u1 * (1.f - cosThetaMax);
+	const float sinTheta = std::sqrt(std::max(0.f, 1.f - cosTheta * cosTheta));
+	const float phi = 2.f * XM_PI * u2;
+	const float lightPdf = 1.f / (2.f * XM_PI * (1.f - cosThetaMax));
+
+	// Orthonormal basis about the cone axis
+	const XMVECTOR b3 = toCenter / std::sqrt(distanceSq);
+	XMFLOAT3 temp;
+	XMStoreFloat3(&temp, b3);
+	const XMVECTOR up = std::abs(temp.x) < 0.5f ? XMVECTORF32{ 1.0f, 0.0f, 0.0f } : XMVECTORF32{ 0.0f, 1.0f, 0.0f };
+	const XMVECTOR b1 = XMVector3Normalize(XMVector3Cross(up, b3));
+	const XMVECTOR b2 = XMVector3Cross(b3, b1);
+
+	const XMVECTOR lightDir = XMVector3Normalize((sinTheta * std::cos(phi)) * b1 + (sinTheta * std::sin(phi)) * b2 + cosTheta * b3);
+
+	if (!XMVector3Greater(XMVector3Dot(payload.normal, lightDir), XM_Zero))
+	{
+		return XM_Zero;
+	}
+
+	// Visible only if the closest hit along the sample direction is this light
+	Payload lightHit{};
+	if (!Intersect(Ray{ payload.pos, lightDir }, lightHit) || lightHit.lightId != m_lightId)
+	{
+		return XM_Zero;
+	}
+
+	const XMVECTOR radianceIn = m_materials.Emit(lightHit.materialId, lightHit);
+
+	// Same estimator convention as EnvironmentLight::Shade. The density includes the probability of picking this light.
+	const float misWeight = PowerHeuristic(selectionPmf * lightPdf, Sampler::k_hemispherePdf);
+	const XMVECTOR albedo = material.GetAlbedo(payload.uv, payload.uvFootprint);
+
+	return diffuseProbability * albedo * radianceIn * (Sampler::k_hemispherePdf * misWeight / (selectionPmf * lightPdf));
 }
\ No newline at end of file
@@ -2,22 +2,114 @@
 
 #include "stdafx.h"
 #include "ray-tracing.h"
+#include "alias-table.h"
+#include "sampler.h"
+
+// Power heuristic (beta = 2) weight for a sample drawn from strategy A when strategy B could also have produced it
+inline float PowerHeuristic(float pdfA, float pdfB)
+{
+	const float a = pdfA * pdfA;
+	const float b = pdfB * pdfB;
+	return (a + b) > 0.f ? a / (a + b) : 0.f;
+}
+
+// Spatial and directional bounds of a light's emission, used to build the light BVH
+struct LightBounds
+{
+	XMFLOAT3 boundsMin;
+	XMFLOAT3 boundsMax;
+	XMFLOAT3 axis;		// principal emission direction
+	float cosThetaO;	// spread of surface normals around the axis (-1 = all directions)
+	float cosThetaE;	// additional emission spread beyond each normal
+	float power;		// total emitted power (luminance)
+};
 
 class Light
 {
 public:
-	virtual XMVECTOR Shade(const class Material* material, const Payload& payload, const XMVECTOR& viewOrigin) const = 0;
+	// selectionPmf is the probability with which this light was picked for the shading point. The returned
+	// estimate is already divided by it.
+	virtual XMVECTOR Shade(const struct Material& material, const Ray& ray, const Payload& payload, SampleContext& sampler, const XMVECTOR& viewOrigin, float selectionPmf) const = 0;
+
+	// Solid angle density with which Shade() would have sampled ray.direction from ray.origin. Zero for delta lights.
+	virtual float Pdf(const Ray& ray) const { return 0.f; }
+
+	// Lights without bounds (sun, sky) are evaluated at every shading point; the rest go into the light BVH
+	virtual std::optional<LightBounds> GetBounds() const { return std::nullopt; }
+
+protected:
+	// Lambert diffuse plus normalized Blinn-Phong specular for a delta light arriving from lightDir
+	static XMVECTOR ShadeAnalytic(const struct Material& material, const Payload& payload, const XMVECTOR& lightDir, const XMVECTOR& radiance, const XMVECTOR& viewOrigin);
 };
 
 class DirectionalLight : public Light
 {
 public:
 	DirectionalLight(const XMVECTOR& dir, const XMCOLOR& color, const float luminance, std::function<bool(const Ray& ray)> lightOcclusionTest);
-	XMVECTOR Shade(const class Material* material, const Payload& payload, const XMVECTOR& viewOrigin) const override;
+	XMVECTOR Shade(const struct Material& material, const Ray& ray, const Payload& payload, SampleContext& sampler, const XMVECTOR& viewOrigin, float selectionPmf) const override;
 
 private:
 	XMVECTOR m_direction;
 	XMVECTOR m_color;
 	float m_luminance;
 	std::function<bool(const Ray& ray)> IsOccluded;
+};
+
+class PointLight : public Light
+{
+public:
+	PointLight(const XMVECTOR& pos, const XMCOLOR& color, const float intensity, std::function<bool(const Ray& ray, Payload& payload)> closestIntersection);
+	XMVECTOR Shade(const struct Material& material, const Ray& ray, const Payload& payload, SampleContext& sampler, const XMVECTOR& viewOrigin, float selectionPmf) const override;
+	std::optional<LightBounds> GetBounds() const override;
+
+private:
+	XMVECTOR m_position;
+	XMVECTOR m_color;
+	float m_intensity;
+	std::function<bool(const Ray& ray, Payload& payload)> Intersect;
+};
+
+// Infinitely distant light backed by a lat-long radiance map (+y up). Directions are importance sampled
+// in proportion to texel luminance through an alias table over all texels, and combined with the
+// diffuse scatter direction using multiple importance sampling.
+class EnvironmentLight : public Light
+{
+public:
+	EnvironmentLight(std::vector<XMFLOAT3>&& radiance, uint32_t width, uint32_t height, const float luminance, std::function<bool(const Ray& ray)> lightOcclusionTest);
+	XMVECTOR Shade(const struct Material& material, const Ray& ray, const Payload& payload, SampleContext& sampler, const XMVECTOR& viewOrigin, float selectionPmf) const override;
+
+	XMVECTOR Evaluate(const XMVECTOR& dir) const;
+	float Pdf(const Ray& ray) const override;
+	// uTexel picks the texel through the alias table, uJitter the position inside it
+	XMVECTOR Sample(XMFLOAT2 uTexel, XMFLOAT2 uJitter, XMVECTOR& outDir, float& outPdf) const;
+
+private:
+	uint32_t GetTexelIndex(const XMVECTOR& dir) const;
+
+private:
+	std::vector<XMFLOAT3> m_radiance;
+	uint32_t m_width;
+	uint32_t m_height;
+	float m_luminance;
+	AliasTable m_distribution;
+	std::function<bool(const Ray& ray)> IsOccluded;
+};
+
+// Emissive sphere registered as an area light. Directions are sampled uniformly inside the cone the sphere
+// subtends from the shading point, and combined with the diffuse scatter direction using multiple importance sampling.
+class SphereLight : public Light
+{
+public:
+	SphereLight(const struct Sphere& sphere, uint32_t lightId, const class MaterialTable& materials, std::function<bool(const Ray& ray, Payload& payload)> closestIntersection);
+	XMVECTOR Shade(const struct Material& material, const Ray& ray, const Payload& payload, SampleContext& sampler, const XMVECTOR& viewOrigin, float selectionPmf) const override;
+	float Pdf(const Ray& ray) const override;
+	std::optional<LightBounds> GetBounds() const override;
+
+private:
+	XMVECTOR m_center;
+	float m_radius;
+	uint32_t m_lightId;
+	uint32_t m_materialId;
+	const class MaterialTable& m_materials;
+	std::function<bool(const Ray& ray, Payload& payload)> Intersect;
 };
\ No newline at end of file
@@ -1,47 +1,179 @@
 #include "material.h"
-#include "quasi-random.h"
 
-XMVECTOR Material::Shade(const Payload& payload, const std::vector<std::unique_ptr<Light>>& lights, const XMVECTOR& viewOrigin) const
+// Diffuse bounces scatter over the whole hemisphere, so the ray cone is widened aggressively.
+// This lets incoherent secondary rays fetch from coarse mip levels.
+static constexpr float k_diffuseConeSpread = 0.5f;
+
+Material Material::DielectricOpaque(const Texture& albedo, const float smoothness)
+{
+	return Material{ MaterialType::DielectricOpaque, albedo, smoothness, 1.f, 0.f };
+}
+
+Material Material::Metal(const Texture& reflectance, const float smoothness)
+{
+	return Material{ MaterialType::Metal, reflectance, smoothness, 1.f, 0.f };
+}
+
+Material Material::DielectricTransparent(const float smoothness, const float ior)
+{
+	return Material{ MaterialType::DielectricTransparent, Texture::Const(XMCOLOR{ 0u }), smoothness, ior, 0.f };
+}
+
+Material Material::Emissive(const float luminance, const Texture& color)
+{
+	return Material{ MaterialType::Emissive, color, 0.f, 1.f, luminance };
+}
+
+XMVECTOR Material::GetAlbedo(XMFLOAT2 uv, float uvFootprint) const
+{
+	switch (type)
+	{
+	case MaterialType::DielectricOpaque:
+		return texture.Evaluate(uv, uvFootprint);
+	case MaterialType::Metal:					// all refracted light gets absorbed
+	case MaterialType::DielectricTransparent:	// refracted light gets transmitted
+	case MaterialType::Emissive:
+	default:
+		return XM_Zero;
+	}
+}
+
+XMVECTOR Material::GetReflectance(XMFLOAT2 uv, float uvFootprint) const
+{
+	switch (type)
+	{
+	case MaterialType::Metal:
+		return texture.Evaluate(uv, uvFootprint);
+	case MaterialType::DielectricOpaque:
+	case MaterialType::DielectricTransparent:
+		return XMVECTORF32{ 0.04f, 0.04f, 0.04f, 1.f }; // 4% reflectance for dielectrics
+	case MaterialType::Emissive:
+	default:
+		return XM_Zero;
+	}
+}
+
+XMVECTOR Material::GetSmoothness(XMFLOAT2 uv) const
+{
+	return XMVectorReplicate(smoothness);
+}
+
+float Material::GetDiffuseScatterProbability(const Ray& ray, const Payload& payload) const
 {
-	XMVECTOR directLighting = XM_Zero;
-	for (const auto& light : lights)
+	const XMVECTOR nDotV = XMVector3Dot(-ray.direction, payload.normal);
+
+	if (type != MaterialType::DielectricOpaque || !XMVector3Greater(nDotV, XM_Zero))
 	{
-		directLighting += light->Shade(this, payload, viewOrigin);
+		return 0.f;
 	}
 
-	return directLighting;
+	// The diffuse branch is taken when the random number is not below the fresnel reflectance in all channels
+	const XMVECTOR f0 = GetReflectance(payload.uv, payload.uvFootprint);
+	const XMVECTOR reflectance = f0 + (XM_One - f0) * XMVectorPow(XM_One - XMVectorSaturate(nDotV), XMVectorReplicate(5.f));
+
+	XMFLOAT3 r;
+	XMStoreFloat3(&r, reflectance);
+	return 1.f - std::min({ r.x, r.y, r.z });
+}
+
+bool operator==(const Material& a, const Material& b)
+{
+	return std::memcmp(&a, &b, sizeof(Material)) == 0;
 }
 
-DielectricOpaque::DielectricOpaque(const Texture* albedo, const XMVECTOR& smoothness) :
-	m_albedo{ albedo }, m_smoothness{ smoothness }
+size_t MaterialHash::operator()(const Material& material) const
 {
+	// FNV-1a over the raw record. Material has no padding, so equal records hash equally.
+	static_assert(sizeof(Material) == sizeof(MaterialType) + sizeof(Texture) + 3 * sizeof(float), "Material must not contain padding");
+
+	const auto* bytes = reinterpret_cast<const uint8_t*>(&material);
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < sizeof(Material); ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+
+	return static_cast<size_t>(hash);
 }
 
-bool DielectricOpaque::Scatter(const Ray& ray, const Payload& hit, XMVECTOR& outAttenuation, Ray& outRay) const
+uint32_t MaterialTable::Add(const Material& material)
+{
+	if (auto it = m_lookup.find(material); it != m_lookup.end())
+	{
+		return it->second;
+	}
+
+	const auto id = static_cast<uint32_t>(m_materials.size());
+	m_materials.push_back(material);
+	m_lookup.emplace(material, id);
+
+	return id;
+}
+
+size_t MaterialTable::GetMemoryUsage() const
+{
+	return m_materials.capacity() * sizeof(Material);
+}
+
+uint32_t MaterialTable::GetFeatures() const
+{
+	uint32_t features = 0;
+
+	for (const Material& material : m_materials)
+	{
+		if (material.type == MaterialType::Emissive)
+		{
+			features |= SceneFeature::Emissive;
+		}
+		else if (material.type == MaterialType::DielectricTransparent)
+		{
+			features |= SceneFeature::Transmission;
+		}
+	}
+
+	return features;
+}
+
+XMVECTOR MaterialTable::Emit(const uint32_t id, const Payload& payload) const
+{
+	const Material& material = m_materials[id];
+
+	if (material.type == MaterialType::Emissive)
+	{
+		return material.luminance * material.texture.Evaluate(payload.uv, payload.uvFootprint);
+	}
+	else
+	{
+		return XM_Zero;
+	}
+}
+
+bool MaterialTable::ScatterDielectricOpaque(const Material& material, const Ray& ray, const Payload& hit, SampleContext& sampler, XMVECTOR& outAttenuation, Ray& outRay, float& outPdf) const
 {
 	if (XMVector3Greater(XMVector3Dot(-ray.direction, hit.normal), XM_Zero))
 	{
 		// Use ray direction to calculate incident angle. This is same as view direction for primary rays.
-		XMVECTOR f0 = GetReflectance(hit.uv);
+		XMVECTOR f0 = material.GetReflectance(hit.uv);
 		XMVECTOR nDotV = XMVectorSaturate(XMVector3Dot(-ray.direction, hit.normal));
 		XMVECTOR reflectance = f0 + (XM_One - f0) * XMVectorPow(XM_One - nDotV, XMVectorReplicate(5.f));
-		
-		const XMVECTOR rand = XMVectorReplicate(Random::HaltonSample(m_reflectionProbabilitySampleIndex++, 3));
+
+		const XMVECTOR rand = XMVectorReplicate(sampler.Next1D());
 		bool bReflect = XMVector3Greater(reflectance, rand);
 
 		if (bReflect)
 		{
 			outAttenuation = XM_One;
 			const XMVECTOR reflectDir = XMVector3Normalize(XMVector3Reflect(ray.direction, hit.normal));
-			outRay = { hit.pos, reflectDir };
+			outRay = { hit.pos, reflectDir, hit.footprint, ray.coneSpread };
 			return true;
 		}
 		else
 		{
-			outAttenuation = m_albedo->Evaluate(hit.uv);
+			outAttenuation = material.texture.Evaluate(hit.uv, hit.uvFootprint);
 
 			// Random sample direction in unit hemisphere
-			XMFLOAT3 dir = Random::HaltonSampleHemisphere(m_sampleIndex++, 5, 7);
+			XMFLOAT3 dir = Sampler::SampleHemisphere(sampler.Next2D());
 
 			// Orthonormal basis about hit normal
 			XMVECTOR b3 = hit.normal;
@@ -53,7 +185,8 @@ bool DielectricOpaque::Scatter(const Ray& ray, const Payload& hit, XMVECTOR& out
 
 			// Project sample direction into ortho basis
 			const XMVECTOR scatterDir = dir.x * b1 + dir.y * b2 + dir.z * b3;
-			outRay = { hit.pos, XMVector3Normalize(scatterDir) };
+			outRay = { hit.pos, XMVector3Normalize(scatterDir), hit.footprint, k_diffuseConeSpread };
+			outPdf = Sampler::k_hemispherePdf;
 
 			return true;
 		}
@@ -64,30 +197,25 @@ bool DielectricOpaque::Scatter(const Ray& ray, const Payload& hit, XMVECTOR& out
 	}
 }
 
-Metal::Metal(const Texture* reflectance, const XMVECTOR& smoothness) :
-	m_reflectance{ reflectance }, m_smoothness{ smoothness }
-{
-}
-
-bool Metal::Scatter(const Ray& ray, const Payload& hit, XMVECTOR& outAttenuation, Ray& outRay) const
+bool MaterialTable::ScatterMetal(const Material& material, const Ray& ray, const Payload& hit, SampleContext& sampler, XMVECTOR& outAttenuation, Ray& outRay, float& outPdf) const
 {
 	if (XMVector3Greater(XMVector3Dot(-ray.direction, hit.normal), XM_Zero))
 	{
 		// Use ray direction to calculate incident angle. This is same as view direction for primary rays.
-		XMVECTOR f0 = GetReflectance(hit.uv);
+		XMVECTOR f0 = material.texture.Evaluate(hit.uv, hit.uvFootprint);
 		XMVECTOR nDotV = XMVectorSaturate(XMVector3Dot(-ray.direction, hit.normal));
 		XMVECTOR reflectance = f0 + (XM_One - f0) * XMVectorPow(XM_One - nDotV, XMVectorReplicate(5.f));
 
 		uint32_t bReflect;
-		const XMVECTOR rand = XMVectorReplicate(Random::HaltonSample(m_reflectionProbabilitySampleIndex++, 3));
+		const XMVECTOR rand = XMVectorReplicate(sampler.Next1D());
 		XMVectorGreaterR(&bReflect, reflectance, rand);
 
 		if (XMComparisonAnyTrue(bReflect))
 		{
-			outAttenuation = m_reflectance->Evaluate(hit.uv);
+			outAttenuation = f0;
 
 			const XMVECTOR reflectDir = XMVector3Normalize(XMVector3Reflect(ray.direction, hit.normal));
-			outRay = { hit.pos, reflectDir };
+			outRay = { hit.pos, reflectDir, hit.footprint, ray.coneSpread };
 
 			return true;
 		}
@@ -102,16 +230,12 @@ bool Metal::Scatter(const Ray& ray, const Payload& hit, XMVECTOR& outAttenuation
 	}
 }
 
-DielectricTransparent::DielectricTransparent(const XMVECTOR& smoothness, const float ior) :
-	m_smoothness{ smoothness }
-{
-	m_ior = XMVectorReplicate(ior);
-}
-
-bool DielectricTransparent::Scatter(const Ray& ray, const Payload& hit, XMVECTOR& outAttenuation, Ray& outRay) const
+bool MaterialTable::ScatterDielectricTransparent(const Material& material, const Ray& ray, const Payload& hit, SampleContext& sampler, XMVECTOR& outAttenuation, Ray& outRay, float& outPdf) const
 {
 	// Attenuation of 1 for glass (no absorption)
-	outAttenuation = { 1.f, 1.f, 1.f };
+	outAttenuation = XM_One;
+
+	const XMVECTOR ior = XMVectorReplicate(material.ior);
 
 	XMVECTOR outwardNormal{};
 	XMVECTOR niOverNt{};
@@ -122,14 +246,14 @@ bool DielectricTransparent::Scatter(const Ray& ray, const Payload& hit, XMVECTOR
 	{
 		// Air-to-medium
 		outwardNormal = -hit.normal;
-		niOverNt = m_ior;
+		niOverNt = ior;
 		cosineIncidentAngle = XMVector3Dot(ray.direction, hit.normal);
 	}
 	else
 	{
 		// Medium-to-air
 		outwardNormal = hit.normal;
-		niOverNt = XMVectorReciprocalEst(m_ior);
+		niOverNt = XMVectorReciprocalEst(ior);
 		cosineIncidentAngle = XMVector3Dot(ray.direction, -hit.normal);
 	}
 
@@ -140,7 +264,7 @@ bool DielectricTransparent::Scatter(const Ray& ray, const Payload& hit, XMVECTOR
 	if (canRefract)
 	{
 		// Valid refraction, but can still be reflected based on fresnel term
-		reflectionProbability = XMFresnelTerm(cosineIncidentAngle, m_ior);
+		reflectionProbability = XMFresnelTerm(cosineIncidentAngle, ior);
 	}
 	else
 	{
@@ -148,28 +272,17 @@ bool DielectricTransparent::Scatter(const Ray& ray, const Payload& hit, XMVECTOR
 		reflectionProbability = XM_One;
 	}
 
-	const XMVECTOR rand = XMVectorReplicate(Random::HaltonSample(m_sampleIndex++, 7));
+	const XMVECTOR rand = XMVectorReplicate(sampler.Next1D());
 
 	if (XMVector3Greater(reflectionProbability, rand))
 	{
 		const XMVECTOR reflectDir = XMVector3Normalize(XMVector3Reflect(ray.direction, hit.normal));
-		outRay = { hit.pos, reflectDir };
+		outRay = { hit.pos, reflectDir, hit.footprint, ray.coneSpread };
 		return true;
 	}
 	else
 	{
-		outRay = { hit.pos, XMVector3Normalize(refractDir) };
+		outRay = { hit.pos, XMVector3Normalize(refractDir), hit.footprint, ray.coneSpread };
 		return true;
 	}
-}
-
-Emissive::Emissive(const float luminance, const Texture* color) :
-	m_luminance{ luminance }, 
-	m_color { color }
-{
-}
-
-XMVECTOR Emissive::Emit(const Payload& payload) const
-{
-	return m_luminance * m_color->Evaluate(payload.uv);
 }
\ No newline at end of file
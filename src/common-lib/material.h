@@ -4,81 +4,135 @@
 #include "ray-tracing.h"
 #include "texture.h"
 #include "light.h"
+#include "light-bvh.h"
+#include "sampler.h"
+#include "scene-features.h"
 
-class Material
+enum class MaterialType : uint32_t
 {
-public:
-	virtual bool Scatter(const Ray& ray, const Payload& payload, XMVECTOR& outAttenuation, Ray& outRay) const = 0;
-	virtual XMVECTOR Shade(const Payload& payload, const std::vector<std::unique_ptr<Light>>& lights, const XMVECTOR& viewOrigin) const;
-	virtual XMVECTOR Emit(const Payload& payload) const = 0;
+	DielectricOpaque,
+	Metal,
+	DielectricTransparent,
+	Emissive
+};
+
+// Plain-data material record. Every field is always initialized by the factory functions so that
+// two materials with identical parameters compare (and hash) equal byte for byte.
+struct Material
+{
+	MaterialType type;
+	Texture texture;	// albedo for opaque dielectrics, reflectance for metals, color for emissives
+	float smoothness;
+	float ior;
+	float luminance;
+
+	static Material DielectricOpaque(const Texture& albedo, float smoothness);
+	static Material Metal(const Texture& reflectance, float smoothness);
+	static Material DielectricTransparent(float smoothness, float ior);
+	static Material Emissive(float luminance, const Texture& color);
 
 	// Property getters
-	virtual XMVECTOR GetAlbedo(XMFLOAT2 uv) const = 0;
-	virtual XMVECTOR GetReflectance(XMFLOAT2 uv) const = 0;
-	virtual XMVECTOR GetSmoothness(XMFLOAT2 uv) const = 0;
+	XMVECTOR GetAlbedo(XMFLOAT2 uv, float uvFootprint = 0.f) const;
+	XMVECTOR GetReflectance(XMFLOAT2 uv, float uvFootprint = 0.f) const;
+	XMVECTOR GetSmoothness(XMFLOAT2 uv) const;
+
+	// Probability that Scatter() takes the diffuse (uniform hemisphere) branch for this incoming ray
+	float GetDiffuseScatterProbability(const Ray& ray, const Payload& payload) const;
 };
 
-class Metal : public Material
-{
-public:
-	Metal(const Texture* reflectance, const XMVECTOR& smoothness);
-	bool Scatter(const Ray& ray, const Payload& payload, XMVECTOR& outAttenuation, Ray& outRay) const override;
-	XMVECTOR Emit(const Payload& payload) const override { return XM_Zero; }
-	XMVECTOR GetAlbedo(XMFLOAT2 uv) const override { return XM_Zero; } // all refracted light gets absorbed
-	XMVECTOR GetReflectance(XMFLOAT2 uv) const override { return m_reflectance->Evaluate(uv); }
-	XMVECTOR GetSmoothness(XMFLOAT2 uv) const override { return m_smoothness; }
+bool operator==(const Material& a, const Material& b);
 
-private:
-	const Texture* m_reflectance;
-	XMVECTOR m_smoothness;
-	mutable std::atomic<uint64_t> m_reflectionProbabilitySampleIndex = 0u;
+struct MaterialHash
+{
+	size_t operator()(const Material& material) const;
 };
 
-class DielectricOpaque : public Material
+// Flat, deduplicated material storage. Primitives reference materials through the 32-bit index
+// returned by Add() and all evaluation goes through a switch on the material type.
+class MaterialTable
 {
 public:
-	DielectricOpaque(const Texture* albedo, const XMVECTOR& smoothness);
-	bool Scatter(const Ray& ray, const Payload& payload, XMVECTOR& outAttenuation, Ray& outRay) const override;
-	XMVECTOR Emit(const Payload& payload) const override { return XM_Zero; }
-	XMVECTOR GetAlbedo(XMFLOAT2 uv) const override { return m_albedo->Evaluate(uv); }
-	XMVECTOR GetReflectance(XMFLOAT2 uv) const override { return XMVECTORF32{ 0.04f, 0.04f, 0.04f, 1.f }; } // 4% reflectance for dielectrics
-	XMVECTOR GetSmoothness(XMFLOAT2 uv) const override { return m_smoothness; }
+	uint32_t Add(const Material& material);
+	const Material& Get(uint32_t id) const { return m_materials[id]; }
+	size_t GetCount() const { return m_materials.size(); }
+	size_t GetMemoryUsage() const;
+
+	// SceneFeature bits covering every material in the table
+	uint32_t GetFeatures() const;
+
+	// outPdf is the solid angle density of the scattered direction, or 0 for delta (mirror/refraction) events.
+	// Features must include every feature of the materials referenced through id.
+	template <uint32_t Features>
+	bool Scatter(uint32_t id, const Ray& ray, const Payload& payload, SampleContext& sampler, XMVECTOR& outAttenuation, Ray& outRay, float& outPdf) const;
+	template <uint32_t Features>
+	XMVECTOR Shade(uint32_t id, const Ray& ray, const Payload& payload, SampleContext& sampler, const std::vector<std::unique_ptr<Light>>& lights, const LightBvh& lightBvh, const XMVECTOR& viewOrigin) const;
+	XMVECTOR Emit(uint32_t id, const Payload& payload) const;
+
+private:
+	bool ScatterDielectricOpaque(const Material& material, const Ray& ray, const Payload& hit, SampleContext& sampler, XMVECTOR& outAttenuation, Ray& outRay, float& outPdf) const;
+	bool ScatterMetal(const Material& material, const Ray& ray, const Payload& hit, SampleContext& sampler, XMVECTOR& outAttenuation, Ray& outRay, float& outPdf) const;
+	bool ScatterDielectricTransparent(const Material& material, const Ray& ray, const Payload& hit, SampleContext& sampler, XMVECTOR& outAttenuation, Ray& outRay, float& outPdf) const;
 
 private:
-	const Texture* m_albedo;
-	XMVECTOR m_smoothness;
-	mutable std::atomic<uint64_t> m_sampleIndex = 0u;
-	mutable std::atomic<uint64_t> m_reflectionProbabilitySampleIndex = 0u;
+	std::vector<Material> m_materials;
+	std::unordered_map<Material, uint32_t, MaterialHash> m_lookup;
 };
 
-class DielectricTransparent : public Material
+template <uint32_t Features>
+bool MaterialTable::Scatter(const uint32_t id, const Ray& ray, const Payload& payload, SampleContext& sampler, XMVECTOR& outAttenuation, Ray& outRay, float& outPdf) const
 {
-public:
-	DielectricTransparent(const XMVECTOR& smoothness, float ior);
-	bool Scatter(const Ray& ray, const Payload& payload, XMVECTOR& outAttenuation, Ray& outRay) const override;
-	XMVECTOR Emit(const Payload& payload) const override { return XM_Zero; }
-	XMVECTOR GetAlbedo(XMFLOAT2 uv) const override { return XM_Zero; } // refracted light gets transmitted
-	XMVECTOR GetReflectance(XMFLOAT2 uv) const override { return XMVECTORF32{ 0.04f, 0.04f, 0.04f, 1.f }; } // 4% reflectance for dielectrics
-	XMVECTOR GetSmoothness(XMFLOAT2 uv) const override { return m_smoothness; }
+	const Material& material = m_materials[id];
+	outPdf = 0.f;
 
-private:
-	XMVECTOR m_smoothness;
-	XMVECTOR m_ior;
-	mutable std::atomic<uint64_t> m_sampleIndex = 0u;
-};
+	switch (material.type)
+	{
+	case MaterialType::DielectricOpaque:
+		return ScatterDielectricOpaque(material, ray, payload, sampler, outAttenuation, outRay, outPdf);
+	case MaterialType::Metal:
+		return ScatterMetal(material, ray, payload, sampler, outAttenuation, outRay, outPdf);
+	case MaterialType::DielectricTransparent:
+		if constexpr ((Features & SceneFeature::Transmission) != 0)
+		{
+			return ScatterDielectricTransparent(material, ray, payload, sampler, outAttenuation, outRay, outPdf);
+		}
+		[[fallthrough]];
+	case MaterialType::Emissive:
+	default:
+		return false;
+	}
+}
 
-class Emissive : public Material
+template <uint32_t Features>
+XMVECTOR MaterialTable::Shade(const uint32_t id, const Ray& ray, const Payload& payload, SampleContext& sampler, const std::vector<std::unique_ptr<Light>>& lights, const LightBvh& lightBvh, const XMVECTOR& viewOrigin) const
 {
-public:
-	Emissive(const float luminance, const Texture* color);
-	XMVECTOR Emit(const Payload& payload) const override;
+	const Material& material = m_materials[id];
 
-	bool Scatter(const Ray& ray, const Payload& payload, XMVECTOR& outAttenuation, Ray& outRay) const override { return false; }
-	XMVECTOR GetAlbedo(XMFLOAT2 uv) const override { return XM_Zero; }
-	XMVECTOR GetReflectance(XMFLOAT2 uv) const override { return XM_Zero; }
-	XMVECTOR GetSmoothness(XMFLOAT2 uv) const override { return XM_Zero; }
+	// Emissive surfaces have neither albedo nor reflectance, so there is no need to trace shadow rays
+	if constexpr ((Features & SceneFeature::Emissive) != 0)
+	{
+		if (material.type == MaterialType::Emissive)
+		{
+			return XM_Zero;
+		}
+	}
 
-private:
-	const Texture* m_color;
-	float m_luminance;
-};
\ No newline at end of file
+	// Lights without bounds contribute at every shading point
+	XMVECTOR directLighting = XM_Zero;
+	for (const uint32_t lightId : lightBvh.GetInfiniteLights())
+	{
+		directLighting += lights[lightId]->Shade(material, ray, payload, sampler, viewOrigin, 1.f);
+	}
+
+	// One bounded light picked from the light BVH in proportion to its estimated contribution
+	if constexpr ((Features & SceneFeature::BoundedLights) != 0)
+	{
+		float selectionPmf;
+		const float u = sampler.Next1D();
+		if (const uint32_t lightId = lightBvh.Sample(payload.pos, u, selectionPmf); lightId != k_invalidId)
+		{
+			directLighting += lights[lightId]->Shade(material, ray, payload, sampler, viewOrigin, selectionPmf);
+		}
+	}
+
+	return directLighting;
+}
\ No newline at end of file
@@ -0,0 +1,379 @@
+#include "path-guide.h"
+
+namespace
+{
+	constexpr float k_oneMinusEpsilon = 1.f - 1.f / 16777216.f;	// largest float below 1
+	constexpr float k_spherePdf = 1.f / (4.f * XM_PI);
+	constexpr uint32_t k_noSource = ~0u;
+
+	// Quadrant of a point in the unit square, and the point in the quadrant's own unit square
+	uint32_t Descend(XMFLOAT2& p)
+	{
+		const uint32_t xBit = p.x >= 0.5f ? 1 : 0;
+		const uint32_t yBit = p.y >= 0.5f ? 1 : 0;
+		p.x = std::min(2.f * p.x - xBit, k_oneMinusEpsilon);
+		p.y = std::min(2.f * p.y - yBit, k_oneMinusEpsilon);
+		return xBit | yBit << 1;
+	}
+}
+
+PathGuide::PathGuide(const PathGuideSettings& settings, const XMFLOAT3& sceneMin, const XMFLOAT3& sceneMax) :
+	m_settings{ settings },
+	m_boundsMin{ sceneMin },
+	m_boundsSize{ std::max({ sceneMax.x - sceneMin.x, sceneMax.y - sceneMin.y, sceneMax.z - sceneMin.z, 1e-3f }) }
+{
+	m_nodes.push_back(SpatialNode{});
+	m_leaves.push_back(std::make_unique<Leaf>());
+	m_leaves[0]->ResetRecording();
+}
+
+void PathGuide::Leaf::ResetRecording()
+{
+	const size_t count = building.nodes.size() * 4;
+	recorded = std::make_unique<std::atomic<float>[]>(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		recorded[i].store(0.f, std::memory_order_relaxed);
+	}
+
+	sampleCount.store(0, std::memory_order_relaxed);
+}
+
+uint32_t PathGuide::FindLeaf(const XMVECTOR& position) const
+{
+	XMFLOAT3 p;
+	XMStoreFloat3(&p, position);
+
+	const std::array<float, 3> offset{ p.x - m_boundsMin.x, p.y - m_boundsMin.y, p.z - m_boundsMin.z };
+	std::array<float, 3> low{ 0.f, 0.f, 0.f };
+	std::array<float, 3> extent{ m_boundsSize, m_boundsSize, m_boundsSize };
+
+	uint32_t node = 0;
+	for (uint32_t axis = 0; m_nodes[node].firstChild != 0; axis = (axis + 1) % 3)
+	{
+		extent[axis] *= 0.5f;
+		const bool upper = offset[axis] >= low[axis] + extent[axis];
+		low[axis] += upper ? extent[axis] : 0.f;
+		node = m_nodes[node].firstChild + (upper ? 1 : 0);
+	}
+
+	return m_nodes[node].leaf;
+}
+
+float PathGuide::GetGuideProbability(const uint32_t leaf) const
+{
+	return m_leaves[leaf]->sampling.total > 0.f ? m_settings.guideProbability : 0.f;
+}
+
+XMVECTOR PathGuide::Sample(const uint32_t leaf, const XMFLOAT2& u, float& outPdf) const
+{
+	const DirectionalTree& tree = m_leaves[leaf]->sampling;
+
+	if (!(tree.total > 0.f))
+	{
+		outPdf = k_spherePdf;
+		return FromSquare(u);
+	}
+
+	// Picks the x half in proportion to its energy, then the quadrant within it, reusing the remainder of u
+	// for the next level. Only quadrants with energy can be picked, so every node on the way has some.
+	float x = std::min(u.x, k_oneMinusEpsilon);
+	float y = std::min(u.y, k_oneMinusEpsilon);
+	XMFLOAT2 origin{ 0.f, 0.f };
+	float size = 1.f;
+	float density = 1.f;
+
+	for (uint32_t index = 0;;)
+	{
+		const QuadNode& node = tree.nodes[index];
+		const std::array<float, 4>& s = node.sum;
+		const float total = s[0] + s[1] + s[2] + s[3];
+
+		const float left = s[0] + s[2];
+		const float leftProbability = left / total;
+		const uint32_t xBit = x < leftProbability ? 0 : 1;
+		x = xBit == 0 ? x / leftProbability : (x - leftProbability) / (1.f - leftProbability);
+
+		const float column = xBit == 0 ? left : s[1] + s[3];
+		const float lowProbability = s[xBit] / column;
+		const uint32_t yBit = y < lowProbability ? 0 : 1;
+		y = yBit == 0 ? y / lowProbability : (y - lowProbability) / (1.f - lowProbability);
+
+		x = std::min(x, k_oneMinusEpsilon);
+		y = std::min(y, k_oneMinusEpsilon);
+
+		const uint32_t quadrant = xBit | yBit << 1;
+		density *= 4.f * s[quadrant] / total;
+		size *= 0.5f;
+		origin.x += xBit * size;
+		origin.y += yBit * size;
+
+		if (node.child[quadrant] == 0)
+		{
+			break;
+		}
+
+		index = node.child[quadrant];
+	}
+
+	outPdf = density * k_spherePdf;
+	return FromSquare(XMFLOAT2{ origin.x + x * size, origin.y + y * size });
+}
+
+float PathGuide::Pdf(const uint32_t leaf, const XMVECTOR& direction) const
+{
+	const DirectionalTree& tree = m_leaves[leaf]->sampling;
+
+	if (!(tree.total > 0.f))
+	{
+		return k_spherePdf;
+	}
+
+	XMFLOAT2 p = ToSquare(direction);
+	float density = 1.f;
+
+	for (uint32_t index = 0;;)
+	{
+		const QuadNode& node = tree.nodes[index];
+		const float total = node.sum[0] + node.sum[1] + node.sum[2] + node.sum[3];
+		const uint32_t quadrant = Descend(p);
+
+		density *= total > 0.f ? 4.f * node.sum[quadrant] / total : 0.f;
+
+		if (node.child[quadrant] == 0 || density == 0.f)
+		{
+			break;
+		}
+
+		index = node.child[quadrant];
+	}
+
+	return density * k_spherePdf;
+}
+
+void PathGuide::Record(const uint32_t leaf, const XMVECTOR& direction, const float radianceOverPdf)
+{
+	if (!IsTraining())
+	{
+		return;
+	}
+
+	Leaf& entry = *m_leaves[leaf];
+	entry.sampleCount.fetch_add(1, std::memory_order_relaxed);
+
+	// Dark samples still count towards the spatial split
+	if (!(radianceOverPdf > 0.f) || !std::isfinite(radianceOverPdf))
+	{
+		return;
+	}
+
+	XMFLOAT2 p = ToSquare(direction);
+
+	// Only leaf quadrants are recorded; Build sums them up the tree
+	for (uint32_t index = 0;;)
+	{
+		const uint32_t quadrant = Descend(p);
+		const uint32_t child = entry.building.nodes[index].child[quadrant];
+
+		if (child == 0)
+		{
+			AtomicAdd(entry.recorded[index * 4 + quadrant], radianceOverPdf);
+			break;
+		}
+
+		index = child;
+	}
+}
+
+void PathGuide::EndPass()
+{
+	if (!IsTraining() || ++m_passInIteration < (1u << m_iteration))
+	{
+		return;
+	}
+
+	m_passInIteration = 0;
+	EndIteration();
+}
+
+void PathGuide::EndIteration()
+{
+	// Longer iterations gather more samples per leaf, which the threshold grows with more slowly, so each
+	// iteration refines space further
+	const float threshold = m_settings.spatialThreshold * std::sqrt(static_cast<float>(1u << m_iteration));
+
+	const auto nodeCount = static_cast<uint32_t>(m_nodes.size());
+	for (uint32_t node = 0; node < nodeCount; ++node)
+	{
+		if (m_nodes[node].firstChild == 0)
+		{
+			SplitLeaf(node, m_leaves[m_nodes[node].leaf]->sampleCount.load(std::memory_order_relaxed), threshold);
+		}
+	}
+
+	++m_iteration;
+
+	// Each leaf samples what it recorded from now on, and records into a structure refined from that
+	for (const std::unique_ptr<Leaf>& leaf : m_leaves)
+	{
+		Build(*leaf);
+
+		// Leaves no path reached keep what they had
+		if (leaf->building.total > 0.f)
+		{
+			leaf->sampling = leaf->building;
+		}
+
+		if (IsTraining())
+		{
+			leaf->building = Refine(leaf->sampling, m_settings.directionalThreshold, m_settings.maxDirectionalDepth);
+			leaf->ResetRecording();
+		}
+	}
+}
+
+void PathGuide::SplitLeaf(const uint32_t node, const uint32_t sampleCount, const float threshold)
+{
+	if (static_cast<float>(sampleCount) <= threshold)
+	{
+		return;
+	}
+
+	// Both halves start from the whole leaf's directional data and are assumed to have seen half its samples
+	const uint32_t leaf = m_nodes[node].leaf;
+	const Leaf& source = *m_leaves[leaf];
+
+	auto copy = std::make_unique<Leaf>();
+	copy->sampling = source.sampling;
+	copy->building = source.building;
+	copy->ResetRecording();
+	for (size_t i = 0; i < source.building.nodes.size() * 4; ++i)
+	{
+		copy->recorded[i].store(source.recorded[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+
+	const auto firstChild = static_cast<uint32_t>(m_nodes.size());
+	m_nodes[node].firstChild = firstChild;
+	m_nodes.push_back(SpatialNode{ 0, leaf });
+	m_nodes.push_back(SpatialNode{ 0, static_cast<uint32_t>(m_leaves.size()) });
+	m_leaves.push_back(std::move(copy));
+
+	SplitLeaf(firstChild, sampleCount / 2, threshold);
+	SplitLeaf(firstChild + 1, sampleCount / 2, threshold);
+}
+
+void PathGuide::Build(Leaf& leaf)
+{
+	// Children always come after their parent
+	DirectionalTree& tree = leaf.building;
+	for (size_t index = tree.nodes.size(); index-- > 0;)
+	{
+		QuadNode& node = tree.nodes[index];
+
+		for (uint32_t quadrant = 0; quadrant < 4; ++quadrant)
+		{
+			const uint32_t child = node.child[quadrant];
+			const std::array<float, 4>& childSum = tree.nodes[child].sum;
+
+			node.sum[quadrant] = child != 0 ?
+				childSum[0] + childSum[1] + childSum[2] + childSum[3] :
+				leaf.recorded[index * 4 + quadrant].load(std::memory_order_relaxed);
+		}
+	}
+
+	const std::array<float, 4>& rootSum = tree.nodes[0].sum;
+	tree.total = rootSum[0] + rootSum[1] + rootSum[2] + rootSum[3];
+}
+
+PathGuide::DirectionalTree PathGuide::Refine(const DirectionalTree& tree, const float threshold, const uint32_t maxDepth)
+{
+	DirectionalTree refined;
+
+	if (!(tree.total > 0.f))
+	{
+		return refined;
+	}
+
+	// Splits every quadrant above the threshold, following the old tree where it exists and spreading a
+	// quadrant's energy evenly over its children where the old tree ended
+	struct Pending
+	{
+		uint32_t node;
+		uint32_t source;	// matching node of the old tree, or k_noSource
+		std::array<float, 4> sum;
+		uint32_t depth;
+	};
+
+	std::vector<Pending> stack{ Pending{ 0, 0, tree.nodes[0].sum, 1 } };
+
+	while (!stack.empty())
+	{
+		const Pending pending = stack.back();
+		stack.pop_back();
+
+		if (pending.depth >= maxDepth)
+		{
+			continue;
+		}
+
+		for (uint32_t quadrant = 0; quadrant < 4; ++quadrant)
+		{
+			if (pending.sum[quadrant] <= threshold * tree.total)
+			{
+				continue;
+			}
+
+			const auto child = static_cast<uint32_t>(refined.nodes.size());
+			refined.nodes[pending.node].child[quadrant] = child;
+			refined.nodes.emplace_back();
+
+			const uint32_t source = pending.source != k_noSource ? tree.nodes[pending.source].child[quadrant] : 0;
+			const float quarter = 0.25f * pending.sum[quadrant];
+
+			stack.push_back(source != 0 ?
+				Pending{ child, source, tree.nodes[source].sum, pending.depth + 1 } :
+				Pending{ child, k_noSource, { quarter, quarter, quarter, quarter }, pending.depth + 1 });
+		}
+	}
+
+	return refined;
+}
+
+XMFLOAT2 PathGuide::ToSquare(const XMVECTOR& direction)
+{
+	XMFLOAT3 d;
+	XMStoreFloat3(&d, direction);
+
+	const float cosTheta = std::clamp(d.z, -1.f, 1.f);
+	float phi = std::atan2(d.y, d.x);
+	if (phi < 0.f)
+	{
+		phi += 2.f * XM_PI;
+	}
+
+	return XMFLOAT2{
+		std::clamp(0.5f * (cosTheta + 1.f), 0.f, k_oneMinusEpsilon),
+		std::clamp(phi / (2.f * XM_PI), 0.f, k_oneMinusEpsilon) };
+}
+
+XMVECTOR PathGuide::FromSquare(const XMFLOAT2& p)
+{
+	const float cosTheta = 2.f * p.x - 1.f;
+	const float sinTheta = std::sqrt(std::max(0.f, 1.f - cosTheta * cosTheta));
+
+	float sinPhi, cosPhi;
+	XMScalarSinCos(&sinPhi, &cosPhi, 2.f * XM_PI * p.y);
+
+	return XMVectorSet(sinTheta * cosPhi, sinTheta * sinPhi, cosTheta, 0.f);
+}
+
+PathGuide::Stats PathGuide::GetStats() const
+{
+	Stats stats{ m_iteration, static_cast<uint32_t>(m_leaves.size()), 0 };
+	for (const std::unique_ptr<Leaf>& leaf : m_leaves)
+	{
+		stats.directionalNodes += leaf->sampling.nodes.size();
+	}
+
+	return stats;
+}
\ No newline at end of file
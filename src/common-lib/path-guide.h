@@ -0,0 +1,107 @@
+#pragma once
+
+#include "stdafx.h"
+#include "ray-tracing.h"
+
+struct PathGuideSettings
+{
+	float guideProbability = 0.5f;		// share of diffuse bounces sampled from the guide once it learned something, the rest sample the BSDF
+	uint32_t trainingIterations = 6;	// iteration k lasts 2^k passes, so the default trains for 63 passes
+	uint32_t spatialThreshold = 12000;	// samples after which a spatial leaf splits, scaled by sqrt(2^k) in iteration k
+	float directionalThreshold = 0.01f;	// quadtree nodes holding more than this share of their leaf's energy split
+	uint32_t maxDirectionalDepth = 16;
+};
+
+// Learned distribution of incident radiance for guiding diffuse bounces (Mueller et al. 2017, "Practical Path
+// Guiding for Efficient Light-Transport Simulation"). A kd-tree over the scene bounds, split at midpoints with
+// the axes in turn, holds in each leaf a quadtree over the sphere of world directions, mapped to the unit square
+// by the area-preserving cylindrical (cos theta, phi) map. A quadtree node splits where much of the leaf's
+// radiance arrives, so sampling it prefers bright directions at a resolution that follows the lighting.
+//
+// Training runs in iterations of doubling length. During an iteration the render threads sample each leaf's
+// distribution from the previous iteration and record their radiance estimates into the current one, which
+// only takes atomic adds into a structure that stays fixed until the iteration ends. Between passes EndPass
+// then splits busy spatial leaves and rebuilds every quadtree from what it recorded. Every pass samples one
+// fixed distribution, so all of them, training included, are unbiased and can be accumulated.
+class PathGuide
+{
+public:
+	struct Stats
+	{
+		uint32_t iteration;
+		uint32_t spatialLeaves;
+		size_t directionalNodes;
+	};
+
+	PathGuide(const PathGuideSettings& settings, const XMFLOAT3& sceneMin, const XMFLOAT3& sceneMax);
+
+	PathGuide(const PathGuide&) = delete;
+	PathGuide& operator=(const PathGuide&) = delete;
+
+	// Spatial leaf containing a point, for the calls below
+	uint32_t FindLeaf(const XMVECTOR& position) const;
+
+	// 0 while the leaf has not learned anything yet
+	float GetGuideProbability(uint32_t leaf) const;
+
+	// Direction drawn from the leaf's distribution and its solid angle density
+	XMVECTOR Sample(uint32_t leaf, const XMFLOAT2& u, float& outPdf) const;
+	float Pdf(uint32_t leaf, const XMVECTOR& direction) const;
+
+	// Radiance arriving from direction, divided by the density it was sampled with. Thread-safe; does
+	// nothing once training has ended.
+	void Record(uint32_t leaf, const XMVECTOR& direction, float radianceOverPdf);
+	bool IsTraining() const { return m_iteration < m_settings.trainingIterations; }
+
+	// Render thread, between passes. EndPass reshapes the trees, so GetStats must not run concurrently with it.
+	void EndPass();
+	Stats GetStats() const;
+
+private:
+	// Quadrant q covers x in the (q & 1) half and y in the (q >> 1) half of its node
+	struct QuadNode
+	{
+		std::array<float, 4> sum{};
+		std::array<uint32_t, 4> child{};	// 0 = leaf quadrant; the root is nobody's child
+	};
+
+	struct DirectionalTree
+	{
+		std::vector<QuadNode> nodes{ 1 };
+		float total = 0.f;
+	};
+
+	struct Leaf
+	{
+		DirectionalTree sampling;	// learned in the previous iteration, read-only during a pass
+		DirectionalTree building;	// structure of the current iteration; its sums are in recorded
+		std::unique_ptr<std::atomic<float>[]> recorded;	// per building node and quadrant
+		std::atomic<uint32_t> sampleCount{ 0 };
+
+		void ResetRecording();
+	};
+
+	// Interior nodes of the kd-tree; children are adjacent, leaves refer to m_leaves
+	struct SpatialNode
+	{
+		uint32_t firstChild = 0;	// 0 = leaf
+		uint32_t leaf = 0;
+	};
+
+	void EndIteration();
+	void SplitLeaf(uint32_t node, uint32_t sampleCount, float threshold);
+	static void Build(Leaf& leaf);
+	static DirectionalTree Refine(const DirectionalTree& tree, float threshold, uint32_t maxDepth);
+
+	static XMFLOAT2 ToSquare(const XMVECTOR& direction);
+	static XMVECTOR FromSquare(const XMFLOAT2& p);
+
+private:
+	PathGuideSettings m_settings;
+	XMFLOAT3 m_boundsMin;
+	float m_boundsSize;	// the bounds are a cube, so every split halves a cube or a box of two aspect ratios
+	std::vector<SpatialNode> m_nodes;
+	std::vector<std::unique_ptr<Leaf>> m_leaves;
+	uint32_t m_iteration = 0;
+	uint32_t m_passInIteration = 0;
+};
\ No newline at end of file
@@ -0,0 +1,233 @@
+#include "quality-harness.h"
+
+namespace
+{
+	constexpr double k_relMseEpsilon = 0.01;
+
+	struct ErrorSums
+	{
+		double squared = 0.0;
+		double relative = 0.0;
+		double display = 0.0;
+
+		ErrorSums operator+(const ErrorSums& other) const
+		{
+			return ErrorSums{ squared + other.squared, relative + other.relative, display + other.display };
+		}
+	};
+}
+
+QualityHarness::QualityHarness(std::vector<XMFLOAT3> reference, uint32_t width, uint32_t height, const PixelRect& region,
+	std::vector<double> timeBudgets, std::vector<uint32_t> sampleCounts, bool compareDenoised) :
+	m_reference{ std::move(reference) },
+	m_width{ width },
+	m_region{ region },
+	m_timeBudgets{ std::move(timeBudgets) },
+	m_sampleCounts{ std::move(sampleCounts) }
+{
+	assert(m_reference.size() == static_cast<size_t>(width) * height && L"Reference does not match the image size");
+	assert(region.right <= width && region.bottom <= height);
+
+	std::sort(m_timeBudgets.begin(), m_timeBudgets.end());
+	std::sort(m_sampleCounts.begin(), m_sampleCounts.end());
+
+	if (compareDenoised)
+	{
+		m_denoiser = std::make_unique<Denoiser>(DenoiserSettings{});
+	}
+
+	// The reference goes through the same display transform as the image once, up front
+	m_referenceLdr.resize(m_reference.size());
+
+	std::vector<float> r(width), g(width), b(width);
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		const XMFLOAT3* row = &m_reference[static_cast<size_t>(y) * width];
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			r[x] = row[x].x;
+			g[x] = row[x].y;
+			b[x] = row[x].z;
+		}
+
+		m_resolver.ResolveSpan(r.data(), g.data(), b.data(), &m_referenceLdr[static_cast<size_t>(y) * width], width);
+	}
+}
+
+ImageError QualityHarness::Measure(const Framebuffer& image) const
+{
+	assert(image.GetWidth() == m_width);
+
+	std::vector<uint32_t> rows(m_region.bottom - m_region.top);
+	std::iota(rows.begin(), rows.end(), m_region.top);
+
+	const uint32_t width = m_region.right - m_region.left;
+
+	const ErrorSums sums = std::transform_reduce(
+		std::execution::par,
+		rows.cbegin(), rows.cend(),
+		ErrorSums{},
+		std::plus<>{},
+		[this, &image, width](uint32_t y)
+		{
+			std::vector<float> planes(3 * width);
+			float* r = planes.data();
+			float* g = r + width;
+			float* b = g + width;
+
+			ErrorSums row;
+
+			for (uint32_t i = 0; i < width; ++i)
+			{
+				XMFLOAT3 pixel;
+				XMStoreFloat3(&pixel, image.GetPixel(m_region.left + i, y));
+				r[i] = pixel.x;
+				g[i] = pixel.y;
+				b[i] = pixel.z;
+
+				const XMFLOAT3& ref = m_reference[static_cast<size_t>(y) * m_width + m_region.left + i];
+				for (const auto [value, expected] : { std::pair{ pixel.x, ref.x }, std::pair{ pixel.y, ref.y }, std::pair{ pixel.z, ref.z } })
+				{
+					const double difference = static_cast<double>(value) - expected;
+					row.squared += difference * difference;
+					row.relative += difference * difference / (static_cast<double>(expected) * expected + k_relMseEpsilon);
+				}
+			}
+
+			std::vector<XMCOLOR> ldr(width);
+			m_resolver.ResolveSpan(r, g, b, ldr.data(), width);
+
+			const XMCOLOR* refLdr = &m_referenceLdr[static_cast<size_t>(y) * m_width + m_region.left];
+			for (uint32_t i = 0; i < width; ++i)
+			{
+				for (const auto [value, expected] : { std::pair{ ldr[i].r, refLdr[i].r }, std::pair{ ldr[i].g, refLdr[i].g }, std::pair{ ldr[i].b, refLdr[i].b } })
+				{
+					const double difference = (static_cast<double>(value) - expected) / 255.0;
+					row.display += difference * difference;
+				}
+			}
+
+			return row;
+		});
+
+	const double count = 3.0 * width * rows.size();
+
+	return ImageError{
+		std::sqrt(sums.squared / count),
+		sums.relative / count,
+		std::sqrt(sums.display / count) };
+}
+
+bool QualityHarness::OnPass(const Framebuffer& image, uint32_t sampleCount, double renderSeconds)
+{
+	const bool timeReached = m_nextTimeBudget < m_timeBudgets.size() && renderSeconds >= m_timeBudgets[m_nextTimeBudget];
+	const bool samplesReached = m_nextSampleCount < m_sampleCounts.size() && sampleCount >= m_sampleCounts[m_nextSampleCount];
+
+	std::optional<ImageError> error;
+
+	if (timeReached || samplesReached)
+	{
+		// A long pass can cross several checkpoints, which then share one measurement
+		error = Measure(image);
+
+		Checkpoint checkpoint{};
+		checkpoint.sampleCount = sampleCount;
+		checkpoint.renderSeconds = renderSeconds;
+		checkpoint.error = error.value();
+
+		if (m_denoiser)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			m_denoiser->Denoise(image, m_denoised);
+			checkpoint.denoiseMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			checkpoint.denoisedError = Measure(m_denoised);
+		}
+
+		const size_t firstNew = m_checkpoints.size();
+
+		for (; m_nextTimeBudget < m_timeBudgets.size() && renderSeconds >= m_timeBudgets[m_nextTimeBudget]; ++m_nextTimeBudget)
+		{
+			checkpoint.isTimeBudget = true;
+			checkpoint.target = m_timeBudgets[m_nextTimeBudget];
+			m_checkpoints.push_back(checkpoint);
+		}
+
+		for (; m_nextSampleCount < m_sampleCounts.size() && sampleCount >= m_sampleCounts[m_nextSampleCount]; ++m_nextSampleCount)
+		{
+			checkpoint.isTimeBudget = false;
+			checkpoint.target = static_cast<double>(m_sampleCounts[m_nextSampleCount]);
+			m_checkpoints.push_back(checkpoint);
+		}
+
+		if (m_denoiser)
+		{
+			for (size_t i = firstNew; i < m_checkpoints.size(); ++i)
+			{
+				m_pendingEqualQuality.push_back(i);
+			}
+		}
+	}
+
+	// The pass that reaches the denoised RMSE is the first at least as good, so every pass is measured until then
+	if (!m_pendingEqualQuality.empty())
+	{
+		const double rmse = error ? error->rmse : Measure(image).rmse;
+
+		const auto matched = std::remove_if(m_pendingEqualQuality.begin(), m_pendingEqualQuality.end(), [this, rmse, sampleCount, renderSeconds](size_t i)
+		{
+			Checkpoint& checkpoint = m_checkpoints[i];
+			if (rmse > checkpoint.denoisedError.rmse)
+			{
+				return false;
+			}
+
+			checkpoint.equalQualitySamples = sampleCount;
+			checkpoint.equalQualitySeconds = renderSeconds;
+			return true;
+		});
+		m_pendingEqualQuality.erase(matched, m_pendingEqualQuality.end());
+	}
+
+	return m_nextTimeBudget == m_timeBudgets.size() && m_nextSampleCount == m_sampleCounts.size() && m_pendingEqualQuality.empty();
+}
+
+bool QualityHarness::WriteCsv(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file)
+	{
+		return false;
+	}
+
+	file << "checkpoint,target,spp,seconds,rmse,relmse,display_rmse" << (m_denoiser ? ",denoised_rmse,denoise_ms,equal_quality_spp,equal_quality_seconds" : "") << '\n';
+	file.precision(9);
+
+	for (const Checkpoint& checkpoint : m_checkpoints)
+	{
+		file << (checkpoint.isTimeBudget ? "time" : "spp") << ','
+			<< checkpoint.target << ','
+			<< checkpoint.sampleCount << ','
+			<< checkpoint.renderSeconds << ','
+			<< checkpoint.error.rmse << ','
+			<< checkpoint.error.relMse << ','
+			<< checkpoint.error.displayRmse;
+
+		// Equal quality columns stay empty when the run ended before plain accumulation caught up
+		if (m_denoiser)
+		{
+			file << ',' << checkpoint.denoisedError.rmse << ',' << checkpoint.denoiseMs << ',';
+			if (checkpoint.equalQualitySamples > 0)
+			{
+				file << checkpoint.equalQualitySamples << ',' << checkpoint.equalQualitySeconds;
+			}
+			else
+			{
+				file << ',';
+			}
+		}
+
+		file << '\n';
+	}
+
+	return static_cast<bool>(file);
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "stdafx.h"
+#include "framebuffer.h"
+#include "resolve.h"
+#include "denoiser.h"
+
+// Error of an accumulated image against a reference, over the pixels both were rendered for
+struct ImageError
+{
+	double rmse;		// linear radiance
+	double relMse;		// (x - r)^2 / (r^2 + 0.01), so dark regions weigh as much as bright ones
+	double displayRmse;	// after tonemapping and gamma on a 0 to 1 scale: what a viewer sees, as in FLIP but without its spatial filters
+};
+
+// Measures how quickly a renderer approaches a converged reference, so a change that raises rays per second
+// but adds noise shows up as a slower curve. Checkpoints are render-time budgets and sample counts. Each is
+// recorded at the first pass that reaches it. The caller passes render time without the measurements, so
+// measuring does not eat into later budgets.
+//
+// With a denoiser each checkpoint is also measured after filtering, and plain accumulation keeps being measured
+// after every pass until it reaches the filtered RMSE. The render time it took is the wall time the denoiser
+// saves at that quality.
+class QualityHarness
+{
+public:
+	struct Checkpoint
+	{
+		bool isTimeBudget;
+		double target;			// seconds or samples per pixel
+		uint32_t sampleCount;
+		double renderSeconds;
+		ImageError error;
+
+		// Only with a denoiser. equalQualitySamples stays 0 while plain accumulation is worse than denoisedError.
+		ImageError denoisedError;
+		double denoiseMs;
+		uint32_t equalQualitySamples;
+		double equalQualitySeconds;
+	};
+
+	// reference is row major, width x height; only pixels inside region are compared
+	QualityHarness(std::vector<XMFLOAT3> reference, uint32_t width, uint32_t height, const PixelRect& region,
+		std::vector<double> timeBudgets, std::vector<uint32_t> sampleCounts, bool compareDenoised = false);
+
+	ImageError Measure(const Framebuffer& image) const;
+
+	// Call after every completed pass. image must carry AOVs when comparing with the denoiser. Returns true once
+	// every checkpoint has been recorded and plain accumulation has matched every denoised one.
+	bool OnPass(const Framebuffer& image, uint32_t sampleCount, double renderSeconds);
+
+	const std::vector<Checkpoint>& GetCheckpoints() const { return m_checkpoints; }
+
+	// One row per checkpoint, in the order they were reached
+	bool WriteCsv(const std::string& path) const;
+
+private:
+	std::vector<XMFLOAT3> m_reference;
+	std::vector<XMCOLOR> m_referenceLdr;
+	uint32_t m_width;
+	PixelRect m_region;
+	Resolver m_resolver;
+
+	std::vector<double> m_timeBudgets;		// ascending
+	std::vector<uint32_t> m_sampleCounts;	// ascending
+	size_t m_nextTimeBudget = 0;
+	size_t m_nextSampleCount = 0;
+	std::vector<Checkpoint> m_checkpoints;
+
+	std::unique_ptr<Denoiser> m_denoiser;
+	Framebuffer m_denoised;
+	std::vector<size_t> m_pendingEqualQuality;	// checkpoints whose denoised RMSE plain accumulation has not reached
+};
\ No newline at end of file
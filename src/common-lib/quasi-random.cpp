@@ -60,17 +60,52 @@ XMFLOAT2 Random::HaltonSampleDisk(uint64_t sampleIndex, uint32_t base1, uint32_t
 	);
 }
 
-// Xorshift PRNG 
-// https://en.wikipedia.org/wiki/Xorshift
-uint64_t Random::Xorshift()
+std::array<uint32_t, 4> Random::Philox(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key)
 {
-	static auto startTime = std::chrono::high_resolution_clock::now();
-	const auto timeNow = std::chrono::high_resolution_clock::now();
-	const std::chrono::duration<uint64_t, std::nano> duration = (timeNow - startTime);
-	uint64_t x = duration.count();
-	x ^= x >> 12;
-	x ^= x << 25;
-	x ^= x >> 27;
-
-	return x;
+	constexpr uint64_t multiplier0 = 0xD2511F53u;
+	constexpr uint64_t multiplier1 = 0xCD9E8D57u;
+	constexpr uint32_t weyl0 = 0x9E3779B9u;
+	constexpr uint32_t weyl1 = 0xBB67AE85u;
+
+	for (int round = 0; round < 10; ++round)
+	{
+		const uint64_t product0 = multiplier0 * counter[0];
+		const uint64_t product1 = multiplier1 * counter[2];
+
+		counter = {
+			static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+			static_cast<uint32_t>(product1),
+			static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+			static_cast<uint32_t>(product0)
+		};
+
+		key[0] += weyl0;
+		key[1] += weyl1;
+	}
+
+	return counter;
+}
+
+float Random::Uniform(uint32_t seed, uint32_t pixel, uint32_t sample, uint32_t dimension)
+{
+	const uint32_t bits = Philox({ sample, dimension, 0u, 0u }, { seed, pixel })[0];
+	return static_cast<float>(bits >> 8) * (1.f / 16777216.f);
+}
+
+Random::Stream::result_type Random::Stream::operator()()
+{
+	// One Philox call yields four values
+	if (m_blockIndex == 4)
+	{
+		m_block = Philox({ static_cast<uint32_t>(m_counter), static_cast<uint32_t>(m_counter >> 32), 0u, 0u }, m_key);
+		++m_counter;
+		m_blockIndex = 0;
+	}
+
+	return m_block[m_blockIndex++];
+}
+
+float Random::Stream::NextFloat()
+{
+	return static_cast<float>((*this)() >> 8) * (1.f / 16777216.f);
 }
\ No newline at end of file
@@ -10,5 +10,32 @@ namespace Random
 	XMFLOAT2 HaltonSampleDisk(uint64_t sampleIndex, uint32_t base1, uint32_t base2);
 	XMFLOAT3 HaltonSampleHemisphere(uint64_t sampleIndex, uint32_t base1, uint32_t base2);
 
-	uint64_t Xorshift();
+	// Philox4x32-10 (Salmon et al. 2011). A counter-based generator: the output is a pure function of
+	// the 128-bit counter and 64-bit key, so any value can be recomputed in any thread without shared state.
+	std::array<uint32_t, 4> Philox(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key);
+
+	// Uniform [0, 1) value keyed by (seed, pixel, sample, dimension)
+	float Uniform(uint32_t seed, uint32_t pixel, uint32_t sample, uint32_t dimension);
+
+	// Sequential draws from one Philox stream. Satisfies UniformRandomBitGenerator, but NextFloat() should be
+	// preferred over std distributions, whose output differs between standard libraries.
+	class Stream
+	{
+	public:
+		using result_type = uint32_t;
+
+		explicit Stream(uint32_t seed, uint32_t streamId = 0) : m_key{ seed, streamId } {}
+
+		static constexpr result_type min() { return 0; }
+		static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+		result_type operator()();
+		float NextFloat();
+
+	private:
+		std::array<uint32_t, 2> m_key;
+		uint64_t m_counter = 0;
+		std::array<uint32_t, 4> m_block{};
+		uint32_t m_blockIndex = 4;
+	};
 };
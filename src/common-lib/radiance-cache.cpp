@@ -0,0 +1,120 @@
+#include "radiance-cache.h"
+#include "sampler.h"
+
+RadianceCache::RadianceCache(const RadianceCacheSettings& settings) :
+	m_settings{ settings },
+	m_inverseCellSize{ 1.f / std::max(settings.cellSize, 1e-6f) }
+{
+	uint32_t cellCount = 1;
+	while (cellCount < std::max(settings.cellCount, k_maxProbes))
+	{
+		cellCount <<= 1;
+	}
+
+	m_cells = std::make_unique<Cell[]>(cellCount);
+	m_mask = cellCount - 1;
+	m_settings.convergedSamples = std::clamp(settings.convergedSamples, 1u, k_maxSamples);
+}
+
+uint64_t RadianceCache::MakeKey(const XMVECTOR& position, const XMVECTOR& normal) const
+{
+	XMFLOAT3 p, n;
+	XMStoreFloat3(&p, XMVectorFloor(position * m_inverseCellSize));
+	XMStoreFloat3(&n, normal);
+
+	// Octahedral map of the normal onto [-1, 1]^2, folding the lower hemisphere over the upper one
+	const float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	float u = n.x / l1;
+	float v = n.y / l1;
+	if (n.z < 0.f)
+	{
+		const float foldedU = (1.f - std::abs(v)) * (u < 0.f ? -1.f : 1.f);
+		v = (1.f - std::abs(u)) * (v < 0.f ? -1.f : 1.f);
+		u = foldedU;
+	}
+
+	auto bucket = [](float x)
+	{
+		return std::min(static_cast<uint32_t>((x * 0.5f + 0.5f) * k_normalResolution), k_normalResolution - 1);
+	};
+
+	// 19 bits per axis wrap around every half million cells, far beyond any scene here; key 0 stays free
+	auto axis = [](float x) { return static_cast<uint64_t>(static_cast<int64_t>(x)) & ((1u << 19) - 1); };
+
+	return (axis(p.x) << 42 | axis(p.y) << 23 | axis(p.z) << 4 | (bucket(u) * k_normalResolution + bucket(v))) + 1;
+}
+
+uint32_t RadianceCache::FindCell(const XMVECTOR& position, const XMVECTOR& normal)
+{
+	const uint64_t key = MakeKey(position, normal);
+	const uint32_t slot = Sampler::HashCombine(Sampler::Hash(static_cast<uint32_t>(key)), static_cast<uint32_t>(key >> 32));
+
+	// Linear probing keeps a cell's neighbours in the same or the next cache line
+	for (uint32_t probe = 0; probe < k_maxProbes; ++probe)
+	{
+		const uint32_t index = (slot + probe) & m_mask;
+		Cell& cell = m_cells[index];
+
+		uint64_t stored = cell.key.load(std::memory_order_acquire);
+		if (stored == 0 && cell.key.compare_exchange_strong(stored, key, std::memory_order_acq_rel))
+		{
+			m_usedCells.fetch_add(1, std::memory_order_relaxed);
+			return index;
+		}
+
+		// Also when another thread claimed the cell for the same key first
+		if (stored == key)
+		{
+			return index;
+		}
+	}
+
+	return k_invalidId;
+}
+
+bool RadianceCache::GetRadiance(const uint32_t cell, XMVECTOR& outRadiance) const
+{
+	const Cell& entry = m_cells[cell];
+
+	const uint32_t sampleCount = entry.sampleCount.load(std::memory_order_acquire);
+	if (sampleCount < m_settings.convergedSamples)
+	{
+		return false;
+	}
+
+	const XMVECTOR sum = XMVectorSet(
+		entry.radiance[0].load(std::memory_order_relaxed),
+		entry.radiance[1].load(std::memory_order_relaxed),
+		entry.radiance[2].load(std::memory_order_relaxed),
+		0.f);
+
+	outRadiance = sum / static_cast<float>(sampleCount);
+	return true;
+}
+
+void RadianceCache::AddSample(const uint32_t cell, const XMVECTOR& radiance)
+{
+	Cell& entry = m_cells[cell];
+
+	// A single NaN or infinity would poison every path that later ends in this cell
+	if (entry.sampleCount.load(std::memory_order_relaxed) >= k_maxSamples || XMVector3IsNaN(radiance) || XMVector3IsInfinite(radiance))
+	{
+		return;
+	}
+
+	XMFLOAT3 value;
+	XMStoreFloat3(&value, radiance);
+	const float channels[3] = { value.x, value.y, value.z };
+
+	for (int channel = 0; channel < 3; ++channel)
+	{
+		AtomicAdd(entry.radiance[channel], channels[channel]);
+	}
+
+	entry.sampleCount.fetch_add(1, std::memory_order_release);
+}
+
+RadianceCache::Stats RadianceCache::GetStats() const
+{
+	return Stats{ m_usedCells.load(std::memory_order_relaxed), m_mask + 1 };
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "stdafx.h"
+#include "ray-tracing.h"
+
+struct RadianceCacheSettings
+{
+	float cellSize = 0.05f;			// world units; larger cells share more paths but blur indirect light
+	uint32_t convergedSamples = 64;	// a cell is used once it averaged this many paths; fewer is faster and more biased
+	uint32_t cellCount = 1u << 18;	// rounded up to a power of two
+};
+
+// World-space hash grid of outgoing radiance. Cells are keyed by the quantized position and normal of diffuse
+// hits, so the two sides of a thin object or the faces of a small sphere get cells of their own. Every path
+// that shades a diffuse hit adds its estimate to the hit's cell; once a cell has converged, paths that arrive
+// through a diffuse bounce end there instead of continuing.
+//
+// Lookups and updates are lock-free: cells are claimed with a compare-and-swap on their key in an open
+// addressed table, and radiance is summed with atomic adds. A reader may see a sample's radiance before its
+// count, which only matters while a cell is young. Results depend on the order in which paths update cells, so
+// renders with the cache are not reproducible bit for bit.
+class RadianceCache
+{
+public:
+	struct Stats
+	{
+		uint32_t usedCells;
+		uint32_t cellCount;
+	};
+
+	explicit RadianceCache(const RadianceCacheSettings& settings);
+
+	RadianceCache(const RadianceCache&) = delete;
+	RadianceCache& operator=(const RadianceCache&) = delete;
+
+	// Cell of a surface point, claimed on first use. k_invalidId when the table is too full around its slot.
+	uint32_t FindCell(const XMVECTOR& position, const XMVECTOR& normal);
+
+	// False until the cell has converged
+	bool GetRadiance(uint32_t cell, XMVECTOR& outRadiance) const;
+	void AddSample(uint32_t cell, const XMVECTOR& radiance);
+
+	Stats GetStats() const;
+
+private:
+	static constexpr uint32_t k_maxProbes = 8;
+	static constexpr uint32_t k_normalResolution = 4;	// octahedral normal buckets per axis
+	static constexpr uint32_t k_maxSamples = 1u << 16;	// converged cells stop taking samples here, which bounds contention
+
+	struct alignas(32) Cell
+	{
+		std::atomic<uint64_t> key{ 0 };	// 0 = free
+		std::atomic<uint32_t> sampleCount{ 0 };
+		std::array<std::atomic<float>, 3> radiance{};
+	};
+
+	uint64_t MakeKey(const XMVECTOR& position, const XMVECTOR& normal) const;
+
+private:
+	RadianceCacheSettings m_settings;
+	float m_inverseCellSize;
+	std::unique_ptr<Cell[]> m_cells;
+	uint32_t m_mask;
+	std::atomic<uint32_t> m_usedCells{ 0 };
+};
\ No newline at end of file
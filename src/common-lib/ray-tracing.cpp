@@ -2,13 +2,13 @@
 #include "quasi-random.h"
 #include "material.h"
 
-XMFLOAT3 operator-(XMFLOAT3 a, XMFLOAT3 b)
+Ray::Ray(const XMVECTOR& o, const XMVECTOR& d) noexcept :
+	origin{ o }, direction{ d } 
 {
-	return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
 }
 
-Ray::Ray(const XMVECTOR& o, const XMVECTOR& d) noexcept :
-	origin{ o }, direction{ d } 
+Ray::Ray(const XMVECTOR& o, const XMVECTOR& d, const float width, const float spread) noexcept :
+	origin{ o }, direction{ d }, coneWidth{ width }, coneSpread{ spread }
 {
 }
 
@@ -18,15 +18,25 @@ XMVECTOR Ray::Evaluate(float t)
 	return XMVectorMultiplyAdd(direction, XMVectorReplicate(t), origin);
 }
 
-Sphere::Sphere(const XMVECTOR& c, const float r, std::unique_ptr<Material>&& mat) noexcept :
-	center{ c }, radius{ r }, material{ std::move(mat) }
+Ray RayPacket::GetRay(const uint32_t i) const
 {
+	return Ray{
+		XMVectorSet(originX[i], originY[i], originZ[i], 1.f),
+		XMVectorSet(directionX[i], directionY[i], directionZ[i], 0.f),
+		coneWidth,
+		coneSpread };
+}
+
+Sphere::Sphere(const XMVECTOR& c, const float r, const uint32_t matId) noexcept :
+	radius{ r }, materialId{ matId }
+{
+	XMStoreFloat3(&center, c);
 }
 
 XMFLOAT2 Sphere::ComputeUV(const XMVECTOR& worldPos) const
 {
 	// Convert world pos to unit sphere
-	XMVECTOR unitSpherePos = (worldPos - center) / radius;
+	XMVECTOR unitSpherePos = (worldPos - GetCenter()) / radius;
 
 	XMFLOAT3 pos;
 	XMStoreFloat3(&pos, unitSpherePos);
@@ -41,6 +51,7 @@ XMFLOAT2 Sphere::ComputeUV(const XMVECTOR& worldPos) const
 
 bool Sphere::Intersect(const Ray& ray, Payload& payload) const
 {
+	const XMVECTOR center = GetCenter();
 	const XMVECTOR oc = ray.origin - center;
 
 	const XMVECTOR a = XMVector3Dot(ray.direction, ray.direction);
@@ -61,7 +72,10 @@ bool Sphere::Intersect(const Ray& ray, Payload& payload) const
 			payload.pos = XMVectorMultiplyAdd(t, ray.direction, ray.origin);
 			payload.normal = (payload.pos - center) / radius;
 			payload.uv = ComputeUV(payload.pos);
-			payload.material = material.get();
+			payload.footprint = ray.coneWidth + XMVectorGetX(t) * ray.coneSpread;
+			payload.uvFootprint = 0.5f * payload.footprint / radius;
+			payload.materialId = materialId;
+			payload.lightId = lightId;
 
 			return true;
 		}
@@ -74,141 +88,14 @@ bool Sphere::Intersect(const Ray& ray, Payload& payload) const
 			payload.pos = XMVectorMultiplyAdd(t, ray.direction, ray.origin);
 			payload.normal = (payload.pos - center) / radius;
 			payload.uv = ComputeUV(payload.pos);
-			payload.material = material.get();
+			payload.footprint = ray.coneWidth + XMVectorGetX(t) * ray.coneSpread;
+			payload.uvFootprint = 0.5f * payload.footprint / radius;
+			payload.materialId = materialId;
+			payload.lightId = lightId;
 
 			return true;
 		}
 	}
 
 	return false;
-}
-
-AABB Sphere::GetAABB() const
-{
-	XMFLOAT3 origin;
-	XMStoreFloat3(&origin, center);
-
-	const XMFLOAT3 extents = { radius, radius, radius };
-
-	return AABB{ origin, extents };
-}
-
-AABB::AABB(const XMFLOAT3& center, const XMFLOAT3& extents) : 
-	m_box{center, extents}
-{
-}
-
-bool AABB::Intersect(const Ray& ray) const
-{
-	float t;
-	return m_box.Intersects(ray.origin, ray.direction, t);
-}
-
-BvhNode::BvhNode(BvhNode::Iter begin, BvhNode::Iter end)
-{
-	size_t n = std::distance(begin, end);
-
-	if (n == 1)
-	{
-		m_left = std::move(*begin);
-		m_right = nullptr;
-	}
-	else if (n == 2)
-	{
-		m_left = std::move(*begin);
-		m_right = std::move(*(begin + 1));
-	}
-	else
-	{
-		switch (auto axis = std::rand() % 3; axis)
-		{
-		case 0:
-			std::sort(begin, end,
-				[](const std::unique_ptr<Hitable>& a, const std::unique_ptr<Hitable>& b)
-			{
-				XMFLOAT3 min_a = a->GetAABB().m_box.Center - a->GetAABB().m_box.Extents;
-				XMFLOAT3 min_b = b->GetAABB().m_box.Center - b->GetAABB().m_box.Extents;
-				return min_a.x < min_b.x;
-			});
-			break;
-		case 1:
-			std::sort(begin, end,
-				[](const std::unique_ptr<Hitable>& a, const std::unique_ptr<Hitable>& b)
-			{
-				XMFLOAT3 min_a = a->GetAABB().m_box.Center - a->GetAABB().m_box.Extents;
-				XMFLOAT3 min_b = b->GetAABB().m_box.Center - b->GetAABB().m_box.Extents;
-				return min_a.y < min_b.y;
-			});
-			break;
-		case 2:
-			std::sort(begin, end,
-				[](const std::unique_ptr<Hitable>& a, const std::unique_ptr<Hitable>& b)
-			{
-				XMFLOAT3 min_a = a->GetAABB().m_box.Center - a->GetAABB().m_box.Extents;
-				XMFLOAT3 min_b = b->GetAABB().m_box.Center - b->GetAABB().m_box.Extents;
-				return min_a.z < min_b.z;
-			});
-			break;
-		}
-
-		m_left = std::make_unique<BvhNode>(begin, begin + n / 2);
-		m_right = std::make_unique<BvhNode>(begin + n / 2, end);
-	}
-
-	// Merged AABB
-	if (m_right != nullptr)
-	{
-		BoundingBox::CreateMerged(m_aabb.m_box, m_left->GetAABB().m_box, m_right->GetAABB().m_box);
-	}
-	else
-	{
-		m_aabb = m_left->GetAABB();
-	}
-}
-
-AABB BvhNode::GetAABB() const
-{
-	return m_aabb;
-}
-
-bool BvhNode::Intersect(const Ray& ray, Payload& payload) const
-{
-	if (m_aabb.Intersect(ray))
-	{
-		Payload leftPayload, rightPayload;
-		bool leftHit = m_left->Intersect(ray, leftPayload);
-		bool rightHit = (m_right != nullptr ? m_right->Intersect(ray, rightPayload) : false);
-
-		if (leftHit && rightHit)
-		{
-			if (XMVector3Less(leftPayload.t, rightPayload.t))
-			{
-				payload = leftPayload;
-			}
-			else
-			{
-				payload = rightPayload;
-			}
-
-			return true;
-		}
-		else if (leftHit)
-		{
-			payload = leftPayload;
-			return true;
-		}
-		else if (rightHit)
-		{
-			payload = rightPayload;
-			return true;
-		}
-		else
-		{
-			return false;
-		}
-	}
-	else
-	{
-		return false;
-	}
 }
\ No newline at end of file
@@ -2,6 +2,17 @@
 
 #include "stdafx.h"
 
+constexpr uint32_t k_invalidId = std::numeric_limits<uint32_t>::max();
+
+// Running sums shared by the render threads. No fetch_add for floats before C++20.
+inline void AtomicAdd(std::atomic<float>& sum, float value)
+{
+	float expected = sum.load(std::memory_order_relaxed);
+	while (!sum.compare_exchange_weak(expected, expected + value, std::memory_order_relaxed))
+	{
+	}
+}
+
 __declspec(align(16))
 struct Payload
 {
@@ -9,7 +20,10 @@ struct Payload
 	XMVECTOR pos;
 	XMVECTOR normal;
 	XMFLOAT2 uv;
-	class Material* material;
+	float footprint;	// world space width of the ray cone at the hit
+	float uvFootprint;	// same width expressed in uv space, used for texture filtering
+	uint32_t materialId;
+	uint32_t lightId;	// k_invalidId unless the primitive is registered as an area light
 };
 
 __declspec(align(16))
@@ -18,47 +32,51 @@ struct Ray
 	XMVECTOR origin;
 	XMVECTOR direction;
 
+	// Ray cone used to estimate texture footprints: width at the origin and growth per unit distance
+	float coneWidth = 0.f;
+	float coneSpread = 0.f;
+
 	Ray() = default;
 	Ray(const XMVECTOR& o, const XMVECTOR& d) noexcept;
+	Ray(const XMVECTOR& o, const XMVECTOR& d, float width, float spread) noexcept;
 	XMVECTOR Evaluate(float t);
 };
 
-struct AABB
+// Up to k_maxRays coherent rays in SoA form, e.g. the primary rays of an 8x8 pixel block, see
+// Bvh::IntersectPacket. The rays share one cone, as the primary rays of a view do.
+struct RayPacket
 {
-	BoundingBox m_box;
-
-	AABB() = default;
-	AABB(const XMFLOAT3& center, const XMFLOAT3& extents);
-	bool Intersect(const Ray& ray) const;
-};
+	static constexpr uint32_t k_size = 8;	// side of the pixel block
+	static constexpr uint32_t k_maxRays = k_size * k_size;
 
-struct Hitable
-{
-	virtual AABB GetAABB() const = 0;
-	virtual bool Intersect(const Ray& ray, Payload& payload) const = 0;
-};
+	uint32_t count = 0;
+	float coneWidth = 0.f;
+	float coneSpread = 0.f;
 
-struct BvhNode : public Hitable
-{
-	AABB m_aabb;
-	std::unique_ptr<Hitable> m_left;
-	std::unique_ptr<Hitable> m_right;
+	alignas(16) std::array<float, k_maxRays> originX;
+	alignas(16) std::array<float, k_maxRays> originY;
+	alignas(16) std::array<float, k_maxRays> originZ;
+	alignas(16) std::array<float, k_maxRays> directionX;
+	alignas(16) std::array<float, k_maxRays> directionY;
+	alignas(16) std::array<float, k_maxRays> directionZ;
 
-	using Iter = std::vector<std::unique_ptr<Hitable>>::iterator;
-	BvhNode(Iter begin, Iter end);
-	AABB GetAABB() const;
-	bool Intersect(const Ray& ray, Payload& payload) const override;
+	Ray GetRay(uint32_t i) const;
 };
 
-struct Sphere : public Hitable
+// Plain-data sphere record. Scenes store these by value in flat arrays, so a primitive costs 24 bytes with no
+// vtable, heap allocation or padding.
+struct Sphere
 {
-	__declspec(align(16)) XMVECTOR center;
+	XMFLOAT3 center;
 	float radius;
-	std::unique_ptr<class Material> material;
+	uint32_t materialId;
+	uint32_t lightId = k_invalidId;
+
+	Sphere() = default;
+	Sphere(const XMVECTOR& c, float r, uint32_t matId) noexcept;
 
-	Sphere(const XMVECTOR& c, const float r, std::unique_ptr<class Material>&& mat) noexcept;
-	AABB GetAABB() const;
-	bool Intersect(const Ray& ray, Payload& payload) const override;
+	XMVECTOR GetCenter() const { return XMLoadFloat3(&center); }
+	bool Intersect(const Ray& ray, Payload& payload) const;
 
 private:
 	XMFLOAT2 ComputeUV(const XMVECTOR& worldPos) const;
@@ -0,0 +1,118 @@
+#include "render-loop.h"
+
+RenderLoop::~RenderLoop()
+{
+	Stop();
+}
+
+void RenderLoop::Start(uint32_t width, uint32_t height, std::chrono::milliseconds presentInterval, PassFunction pass,
+	std::function<void()> onPresent, uint64_t passLimit)
+{
+	assert(!m_thread.joinable() && L"Render loop already running");
+
+	for (uint32_t i = 0; i < k_imageCount; ++i)
+	{
+		if (m_shared)
+		{
+			assert(m_shared->GetWidth() == width && m_shared->GetHeight() == height && L"Shared section does not match the image size");
+			m_images[i].clear();
+			m_imagePointers[i] = m_shared->GetImage(i);
+		}
+		else
+		{
+			m_images[i].assign(static_cast<size_t>(width) * height, XMCOLOR{ 0 });
+			m_imagePointers[i] = m_images[i].data();
+		}
+	}
+
+	m_back = 0;
+	m_ready.store(1);
+	m_front = 2;
+
+	m_pass = std::move(pass);
+	m_onPresent = std::move(onPresent);
+	m_presentInterval = presentInterval;
+	m_passLimit = passLimit;
+
+	m_stopRequested = false;
+	m_passCount = 0;
+	m_presentCount = 0;
+
+	m_thread = std::thread(&RenderLoop::RenderMain, this);
+}
+
+void RenderLoop::Stop()
+{
+	RequestStop();
+	Wait();
+}
+
+void RenderLoop::Wait()
+{
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+const XMCOLOR* RenderLoop::AcquireLatest()
+{
+	if ((m_ready.load(std::memory_order_relaxed) & k_freshFlag) == 0)
+	{
+		return nullptr;
+	}
+
+	// Hand back the image presented last and take the published one
+	m_front = m_ready.exchange(m_front, std::memory_order_acq_rel) & ~k_freshFlag;
+	return m_imagePointers[m_front];
+}
+
+void RenderLoop::Publish()
+{
+	if (m_shared)
+	{
+		m_shared->EndWrite(m_back, GetPassCount());
+	}
+
+	// Release makes the image visible with the index; the consumer's old or unread image becomes the next back buffer
+	m_back = m_ready.exchange(m_back | k_freshFlag, std::memory_order_acq_rel) & ~k_freshFlag;
+	++m_presentCount;
+}
+
+void RenderLoop::RenderMain()
+{
+	auto lastPresent = std::chrono::steady_clock::now();
+
+	while (!IsStopRequested() && (m_passLimit == 0 || GetPassCount() < m_passLimit))
+	{
+		// The last pass of a limited run always presents, so a headless caller reads the final image
+		const auto now = std::chrono::steady_clock::now();
+		const bool present = GetPresentCount() == 0 || now - lastPresent >= m_presentInterval ||
+			(m_passLimit != 0 && GetPassCount() + 1 == m_passLimit);
+
+		if (present && m_shared)
+		{
+			m_shared->BeginWrite(m_back);
+		}
+
+		m_pass(present ? m_imagePointers[m_back] : nullptr);
+
+		if (IsStopRequested())
+		{
+			break;
+		}
+
+		++m_passCount;
+
+		if (present)
+		{
+			Publish();
+			lastPresent = now;
+
+			if (m_onPresent)
+			{
+				m_onPresent();
+			}
+		}
+	}
+}
\ No newline at end of file
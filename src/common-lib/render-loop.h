@@ -0,0 +1,77 @@
+#pragma once
+
+#include "stdafx.h"
+#include "shared-framebuffer.h"
+
+// Runs a renderer on a thread of its own and hands finished display images to a consumer through a triple buffer.
+// The render thread always owns one image to fill, one holds the newest published image and the consumer keeps
+// the third while presenting it, so neither side waits for the other: the next pass is traced while the previous
+// image is copied and presented. The loop knows nothing about windows, so a headless caller drives it the same
+// way by waiting for a pass count and reading the last image.
+class RenderLoop
+{
+public:
+	// Renders one pass into the renderer's accumulation buffer. When ldr is not null the pass must also leave a
+	// complete display image there, row major with a pitch of width pixels. Passes should poll IsStopRequested()
+	// between pieces of work and return early once it is set; the loop discards an image cut short that way.
+	using PassFunction = std::function<void(XMCOLOR* ldr)>;
+
+	RenderLoop() = default;
+	~RenderLoop();
+
+	RenderLoop(const RenderLoop&) = delete;
+	RenderLoop& operator=(const RenderLoop&) = delete;
+
+	// Starts the render thread. The first pass always presents, later ones at most once per presentInterval.
+	// onPresent runs on the render thread after each published image. A passLimit of 0 renders until Stop().
+	void Start(uint32_t width, uint32_t height, std::chrono::milliseconds presentInterval, PassFunction pass,
+		std::function<void()> onPresent = {}, uint64_t passLimit = 0);
+
+	// Renders into the slots of a shared section instead of private images, so other processes see every
+	// published image. Call before Start; the section must match the size passed to Start.
+	void ShareImages(SharedFramebuffer* shared) { m_shared = shared; }
+
+	// Cancels the running pass and joins the render thread
+	void Stop();
+
+	// Cancels without joining, so a pass may end the loop itself
+	void RequestStop() { m_stopRequested = true; }
+
+	// Blocks until the pass limit is reached or Stop() is called from another thread
+	void Wait();
+
+	bool IsStopRequested() const { return m_stopRequested.load(std::memory_order_relaxed); }
+
+	// Newest image published since the previous call, or nullptr. Stays valid until the next call.
+	const XMCOLOR* AcquireLatest();
+
+	uint64_t GetPassCount() const { return m_passCount.load(std::memory_order_relaxed); }
+	uint64_t GetPresentCount() const { return m_presentCount.load(std::memory_order_relaxed); }
+
+private:
+	void RenderMain();
+	void Publish();
+
+private:
+	static constexpr uint32_t k_imageCount = 3;
+	static constexpr uint32_t k_freshFlag = 1u << 31;	// set in m_ready while the consumer has not taken it
+
+	static_assert(k_imageCount == SharedFramebuffer::k_slotCount, "Images map one to one onto shared slots");
+
+	std::array<std::vector<XMCOLOR>, k_imageCount> m_images;	// unless shared
+	std::array<XMCOLOR*, k_imageCount> m_imagePointers{};
+	SharedFramebuffer* m_shared = nullptr;
+	uint32_t m_back = 0;		// render thread
+	std::atomic<uint32_t> m_ready{ 1 };
+	uint32_t m_front = 2;		// consumer
+
+	PassFunction m_pass;
+	std::function<void()> m_onPresent;
+	std::chrono::milliseconds m_presentInterval{ 0 };
+	uint64_t m_passLimit = 0;
+
+	std::atomic<bool> m_stopRequested{ false };
+	std::atomic<uint64_t> m_passCount{ 0 };
+	std::atomic<uint64_t> m_presentCount{ 0 };
+	std::thread m_thread;
+};
\ No newline at end of file
@@ -0,0 +1,231 @@
+#include "resolve.h"
+#include <intrin.h>
+
+namespace
+{
+	// ACES filmic tonemapping curve fit (Narkowicz)
+	constexpr float k_acesA = 2.51f;
+	constexpr float k_acesB = 0.03f;
+	constexpr float k_acesC = 2.43f;
+	constexpr float k_acesD = 0.59f;
+	constexpr float k_acesE = 0.14f;
+
+	constexpr float k_invGamma = 1.f / 2.2f;
+
+	// Float bit patterns bounding the gamma table: 2^-13 and the largest float below 1
+	constexpr uint32_t k_gammaMinBits = (127u - 13u) << 23;
+	constexpr uint32_t k_gammaMaxBits = 0x3f7fffffu;
+	constexpr uint32_t k_gammaFractionBits = 23 - 3;
+
+	float FromBits(uint32_t bits)
+	{
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	uint32_t ToBits(float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	float Tonemap(float x)
+	{
+		return std::clamp((x * (k_acesA * x + k_acesB)) / (x * (k_acesC * x + k_acesD) + k_acesE), 0.f, 1.f);
+	}
+
+	__m256 Tonemap(__m256 x)
+	{
+		const __m256 numerator = _mm256_mul_ps(x, _mm256_fmadd_ps(_mm256_set1_ps(k_acesA), x, _mm256_set1_ps(k_acesB)));
+		const __m256 denominator = _mm256_fmadd_ps(x, _mm256_fmadd_ps(_mm256_set1_ps(k_acesC), x, _mm256_set1_ps(k_acesD)), _mm256_set1_ps(k_acesE));
+		return _mm256_min_ps(_mm256_max_ps(_mm256_div_ps(numerator, denominator), _mm256_setzero_ps()), _mm256_set1_ps(1.f));
+	}
+
+	uint32_t PackColor(uint32_t r, uint32_t g, uint32_t b)
+	{
+		// XMCOLOR is A8R8G8B8
+		return 0xff000000u | (r << 16) | (g << 8) | b;
+	}
+}
+
+Resolver::Resolver() :
+	m_useAvx2{ HasAvx2() }
+{
+	static_assert(k_gammaMinBits + (k_gammaSegments << k_gammaFractionBits) == 0x3f800000u, "Gamma table must end at 1");
+
+	for (uint32_t segment = 0; segment < k_gammaSegments; ++segment)
+	{
+		const float x0 = FromBits(k_gammaMinBits + (segment << k_gammaFractionBits));
+		const float x1 = FromBits(k_gammaMinBits + ((segment + 1) << k_gammaFractionBits));
+		const float y0 = 255.f * std::pow(x0, k_invGamma);
+		const float y1 = 255.f * std::pow(x1, k_invGamma);
+
+		m_gammaBase[segment] = y0;
+		m_gammaSlope[segment] = y1 - y0;
+	}
+
+	m_gammaZeroSlope = m_gammaBase[0] / FromBits(k_gammaMinBits);
+}
+
+void Resolver::Resolve(const Framebuffer& hdr, XMCOLOR* ldr, uint32_t pitch, const PixelRect& region) const
+{
+	if (region.right <= region.left || region.bottom <= region.top)
+	{
+		return;
+	}
+
+	// Tiles overlapping the region
+	const uint32_t tileLeft = region.left / Framebuffer::k_tileSize;
+	const uint32_t tileTop = region.top / Framebuffer::k_tileSize;
+	const uint32_t tileRight = (region.right + Framebuffer::k_tileSize - 1) / Framebuffer::k_tileSize;
+	const uint32_t tileBottom = (region.bottom + Framebuffer::k_tileSize - 1) / Framebuffer::k_tileSize;
+
+	std::vector<uint32_t> tiles;
+	tiles.reserve(static_cast<size_t>(tileRight - tileLeft) * (tileBottom - tileTop));
+	for (uint32_t ty = tileTop; ty < tileBottom; ++ty)
+	{
+		for (uint32_t tx = tileLeft; tx < tileRight; ++tx)
+		{
+			tiles.push_back(ty * hdr.GetTileCountX() + tx);
+		}
+	}
+
+	std::for_each(
+		std::execution::par,
+		tiles.cbegin(), tiles.cend(),
+		[this, &hdr, ldr, pitch, &region](uint32_t tileIndex)
+		{
+			ResolveTile(hdr, tileIndex, ldr, pitch, region);
+		});
+}
+
+void Resolver::ResolveTile(const Framebuffer& hdr, uint32_t tileIndex, XMCOLOR* ldr, uint32_t pitch) const
+{
+	ResolveTile(hdr, tileIndex, ldr, pitch, hdr.GetTileRect(tileIndex));
+}
+
+void Resolver::ResolveTile(const Framebuffer& hdr, uint32_t tileIndex, XMCOLOR* ldr, uint32_t pitch, const PixelRect& region) const
+{
+	const Framebuffer::Tile& tile = hdr.GetTile(tileIndex);
+	const PixelRect tileRect = hdr.GetTileRect(tileIndex);
+
+	const uint32_t left = std::max(tileRect.left, region.left);
+	const uint32_t right = std::min(tileRect.right, region.right);
+	const uint32_t top = std::max(tileRect.top, region.top);
+	const uint32_t bottom = std::min(tileRect.bottom, region.bottom);
+
+	for (uint32_t y = top; y < bottom; ++y)
+	{
+		const uint32_t localIndex = (y - tileRect.top) * Framebuffer::k_tileSize + (left - tileRect.left);
+		XMCOLOR* destination = ldr + static_cast<size_t>(y) * pitch + left;
+
+		ResolveSpan(&tile.r[localIndex], &tile.g[localIndex], &tile.b[localIndex], destination, right - left);
+	}
+}
+
+void Resolver::ResolveSpan(const float* r, const float* g, const float* b, XMCOLOR* ldr, uint32_t count) const
+{
+	if (m_useAvx2)
+	{
+		ResolveSpanAvx2(r, g, b, ldr, count);
+	}
+	else
+	{
+		ResolveSpanScalar(r, g, b, ldr, count);
+	}
+}
+
+void Resolver::ResolveSpanScalar(const float* r, const float* g, const float* b, XMCOLOR* ldr, uint32_t count) const
+{
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const auto r8 = static_cast<uint32_t>(EncodeGamma(Tonemap(r[i])) + 0.5f);
+		const auto g8 = static_cast<uint32_t>(EncodeGamma(Tonemap(g[i])) + 0.5f);
+		const auto b8 = static_cast<uint32_t>(EncodeGamma(Tonemap(b[i])) + 0.5f);
+
+		ldr[i].c = PackColor(r8, g8, b8);
+	}
+}
+
+void Resolver::ResolveSpanAvx2(const float* r, const float* g, const float* b, XMCOLOR* ldr, uint32_t count) const
+{
+	const __m256i minBits = _mm256_set1_epi32(static_cast<int>(k_gammaMinBits));
+	const __m256i maxBits = _mm256_set1_epi32(static_cast<int>(k_gammaMaxBits));
+	const __m256i fractionMask = _mm256_set1_epi32((1 << k_gammaFractionBits) - 1);
+	const __m256 fractionScale = _mm256_set1_ps(1.f / (1 << k_gammaFractionBits));
+	const __m256 zeroSlope = _mm256_set1_ps(m_gammaZeroSlope);
+
+	auto encodeGamma = [&](__m256 linear) -> __m256i
+	{
+		// Integer compares order non-negative floats, so clamping works on the bit patterns
+		__m256i bits = _mm256_castps_si256(linear);
+		const __m256 belowTable = _mm256_castsi256_ps(_mm256_cmpgt_epi32(minBits, bits));
+		bits = _mm256_min_epi32(_mm256_max_epi32(bits, minBits), maxBits);
+		bits = _mm256_sub_epi32(bits, minBits);
+
+		const __m256i segment = _mm256_srli_epi32(bits, k_gammaFractionBits);
+		const __m256 fraction = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(bits, fractionMask)), fractionScale);
+		const __m256 base = _mm256_i32gather_ps(m_gammaBase.data(), segment, 4);
+		const __m256 slope = _mm256_i32gather_ps(m_gammaSlope.data(), segment, 4);
+		const __m256 encoded = _mm256_blendv_ps(_mm256_fmadd_ps(slope, fraction, base), _mm256_mul_ps(linear, zeroSlope), belowTable);
+
+		return _mm256_cvtps_epi32(encoded);
+	};
+
+	uint32_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m256i r8 = encodeGamma(Tonemap(_mm256_loadu_ps(r + i)));
+		const __m256i g8 = encodeGamma(Tonemap(_mm256_loadu_ps(g + i)));
+		const __m256i b8 = encodeGamma(Tonemap(_mm256_loadu_ps(b + i)));
+
+		const __m256i packed = _mm256_or_si256(
+			_mm256_or_si256(_mm256_set1_epi32(static_cast<int>(0xff000000u)), _mm256_slli_epi32(r8, 16)),
+			_mm256_or_si256(_mm256_slli_epi32(g8, 8), b8));
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(ldr + i), packed);
+	}
+
+	ResolveSpanScalar(r + i, g + i, b + i, ldr + i, count - i);
+}
+
+float Resolver::EncodeGamma(float linear) const
+{
+	// Also catches -0 and NaN, whose bits would index past the table; the vector path encodes them as 0 too
+	if (!(linear > 0.f))
+	{
+		return 0.f;
+	}
+
+	if (ToBits(linear) < k_gammaMinBits)
+	{
+		return linear * m_gammaZeroSlope;
+	}
+
+	const uint32_t bits = std::min(ToBits(linear), k_gammaMaxBits) - k_gammaMinBits;
+	const uint32_t segment = bits >> k_gammaFractionBits;
+	const float fraction = (bits & ((1u << k_gammaFractionBits) - 1)) * (1.f / (1u << k_gammaFractionBits));
+
+	return m_gammaBase[segment] + m_gammaSlope[segment] * fraction;
+}
+
+bool Resolver::HasAvx2()
+{
+	int info[4];
+	__cpuidex(info, 1, 0);
+
+	// FMA, OSXSAVE and AVX, plus the OS saving the YMM registers
+	const bool hasFma = (info[2] & (1 << 12)) != 0;
+	const bool hasOsXsave = (info[2] & (1 << 27)) != 0;
+	const bool hasAvx = (info[2] & (1 << 28)) != 0;
+
+	if (!hasFma || !hasOsXsave || !hasAvx || (_xgetbv(0) & 0x6) != 0x6)
+	{
+		return false;
+	}
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+}
\ No newline at end of file
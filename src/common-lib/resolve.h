@@ -0,0 +1,44 @@
+#pragma once
+
+#include "stdafx.h"
+#include "framebuffer.h"
+
+// Converts the accumulated HDR mean into the 8-bit display buffer: ACES filmic tonemap and gamma 2.2.
+// Framebuffer tiles are resolved in parallel, eight pixels at a time with AVX2 when the CPU supports it. Gamma is a
+// piecewise linear fit over the float exponent and top mantissa bits, so no pow is evaluated per pixel.
+class Resolver
+{
+public:
+	Resolver();
+
+	// ldr is row major with a pitch in pixels
+	void Resolve(const Framebuffer& hdr, XMCOLOR* ldr, uint32_t pitch, const PixelRect& region) const;
+
+	// One whole tile on the calling thread, e.g. by the worker that just traced it
+	void ResolveTile(const Framebuffer& hdr, uint32_t tileIndex, XMCOLOR* ldr, uint32_t pitch) const;
+
+	// Planar HDR values that are not in a framebuffer, e.g. a reference image
+	void ResolveSpan(const float* r, const float* g, const float* b, XMCOLOR* ldr, uint32_t count) const;
+
+private:
+	void ResolveTile(const Framebuffer& hdr, uint32_t tileIndex, XMCOLOR* ldr, uint32_t pitch, const PixelRect& region) const;
+
+	// Spans are runs of pixels within one tile row, read from the R, G and B planes
+	void ResolveSpanScalar(const float* r, const float* g, const float* b, XMCOLOR* ldr, uint32_t count) const;
+	void ResolveSpanAvx2(const float* r, const float* g, const float* b, XMCOLOR* ldr, uint32_t count) const;
+	float EncodeGamma(float linear) const;
+
+	static bool HasAvx2();
+
+private:
+	// 8 segments per power of two between 2^-13 and 1. Below 2^-13, which encodes to about 4, a line through 0
+	// takes over, so black stays black.
+	static constexpr uint32_t k_gammaExponents = 13;
+	static constexpr uint32_t k_gammaSegmentBits = 3;
+	static constexpr uint32_t k_gammaSegments = k_gammaExponents << k_gammaSegmentBits;
+
+	std::array<float, k_gammaSegments> m_gammaBase;
+	std::array<float, k_gammaSegments> m_gammaSlope;
+	float m_gammaZeroSlope;	// encoded value per linear unit below the table
+	bool m_useAvx2;
+};
\ No newline at end of file
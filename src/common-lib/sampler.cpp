@@ -0,0 +1,56 @@
+#include "sampler.h"
+
+void Sampler::Get1D(const uint32_t* seeds, size_t count, uint32_t sampleIndex, uint32_t dimension, float* outSamples)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		outSamples[i] = Get1D(sampleIndex, seeds[i], dimension);
+	}
+}
+
+void Sampler::Get2D(const uint32_t* seeds, size_t count, uint32_t sampleIndex, uint32_t dimension, XMFLOAT2* outSamples)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		outSamples[i] = Get2D(sampleIndex, seeds[i], dimension);
+	}
+}
+
+XMFLOAT2 Sampler::SampleDisk(XMFLOAT2 u)
+{
+	// Concentric mapping keeps the stratification of the square intact
+	const float x = 2.f * u.x - 1.f;
+	const float y = 2.f * u.y - 1.f;
+
+	if (x == 0.f && y == 0.f)
+	{
+		return XMFLOAT2(0.f, 0.f);
+	}
+
+	float r, theta;
+	if (std::abs(x) > std::abs(y))
+	{
+		r = x;
+		theta = XM_PIDIV4 * (y / x);
+	}
+	else
+	{
+		r = y;
+		theta = XM_PIDIV2 - XM_PIDIV4 * (x / y);
+	}
+
+	float sinTheta, cosTheta;
+	XMScalarSinCos(&sinTheta, &cosTheta, theta);
+
+	return XMFLOAT2(r * cosTheta, r * sinTheta);
+}
+
+XMFLOAT3 Sampler::SampleHemisphere(XMFLOAT2 u)
+{
+	const float r = std::sqrt(std::max(0.f, 1.f - u.x * u.x));
+
+	float sinPhi, cosPhi;
+	XMScalarSinCos(&sinPhi, &cosPhi, XM_2PI * u.y);
+
+	return XMFLOAT3(r * cosPhi, r * sinPhi, u.x);
+}
\ No newline at end of file
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "stdafx.h"
+
+// Owen-scrambled Sobol sampler (Burley 2020, "Practical Hash-based Owen Scrambling").
+// Each dimension pair is drawn from the first two Sobol dimensions. Every pair gets its own index
+// shuffle and scramble seed ("padding"). Generating a sample therefore only takes integer multiplies,
+// xors and bit reversals. Samples are keyed by (pixel seed, sample index, dimension), which decorrelates
+// neighbouring pixels and lets any sample be recomputed from any thread.
+namespace Sampler
+{
+	// Sobol direction numbers of the second dimension. The first dimension is the bit-reversed index.
+	inline constexpr std::array<uint32_t, 32> k_sobolDirections = []()
+	{
+		std::array<uint32_t, 32> directions{};
+		directions[0] = 1u << 31;
+		for (size_t i = 1; i < directions.size(); ++i)
+		{
+			directions[i] = directions[i - 1] ^ (directions[i - 1] >> 1);
+		}
+		return directions;
+	}();
+
+	// Integer hash with good avalanche (lowbias32)
+	inline uint32_t Hash(uint32_t x)
+	{
+		x ^= x >> 16;
+		x *= 0x7feb352du;
+		x ^= x >> 15;
+		x *= 0x846ca68bu;
+		x ^= x >> 16;
+		return x;
+	}
+
+	inline uint32_t HashCombine(uint32_t seed, uint32_t value)
+	{
+		return seed ^ (Hash(value) + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+	}
+
+	inline uint32_t ReverseBits(uint32_t x)
+	{
+		x = (x << 16) | (x >> 16);
+		x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+		x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+		x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+		x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+		return x;
+	}
+
+	// Hash based nested uniform scramble. Works on reversed bits so that higher bits permute lower ones.
+	inline uint32_t NestedUniformScramble(uint32_t x, uint32_t seed)
+	{
+		x = ReverseBits(x);
+		x += seed;
+		x ^= x * 0x6c50b47cu;
+		x ^= x * 0xb82f1e52u;
+		x ^= x * 0xc7afe638u;
+		x ^= x * 0x8d22f6e6u;
+		return ReverseBits(x);
+	}
+
+	// Fixed trip count and no branches so batched loops vectorize
+	inline uint32_t SobolSecondDimension(uint32_t index)
+	{
+		uint32_t result = 0;
+		for (uint32_t bit = 0; bit < 32; ++bit)
+		{
+			result ^= k_sobolDirections[bit] & (0u - ((index >> bit) & 1u));
+		}
+		return result;
+	}
+
+	// Top 24 bits so the result is exactly representable and strictly below 1
+	inline float ToUnitFloat(uint32_t x)
+	{
+		return static_cast<float>(x >> 8) * (1.f / 16777216.f);
+	}
+
+	// The render seed changes every pixel's sequence while keeping renders reproducible
+	inline uint32_t PixelSeed(uint32_t pixelIndex, uint32_t renderSeed)
+	{
+		return HashCombine(Hash(renderSeed), pixelIndex);
+	}
+
+	inline float Get1D(uint32_t sampleIndex, uint32_t seed, uint32_t dimension)
+	{
+		const uint32_t dimensionSeed = HashCombine(seed, dimension);
+		const uint32_t index = NestedUniformScramble(sampleIndex, dimensionSeed);
+		return ToUnitFloat(NestedUniformScramble(ReverseBits(index), Hash(dimensionSeed)));
+	}
+
+	inline XMFLOAT2 Get2D(uint32_t sampleIndex, uint32_t seed, uint32_t dimension)
+	{
+		const uint32_t dimensionSeed = HashCombine(seed, dimension);
+		const uint32_t index = NestedUniformScramble(sampleIndex, dimensionSeed);
+		return XMFLOAT2(
+			ToUnitFloat(NestedUniformScramble(ReverseBits(index), Hash(dimensionSeed))),
+			ToUnitFloat(NestedUniformScramble(SobolSecondDimension(index), Hash(dimensionSeed + 1))));
+	}
+
+	// Same sample index and dimension for a run of pixels, e.g. one camera sample per pixel of a scanline
+	void Get1D(const uint32_t* seeds, size_t count, uint32_t sampleIndex, uint32_t dimension, float* outSamples);
+	void Get2D(const uint32_t* seeds, size_t count, uint32_t sampleIndex, uint32_t dimension, XMFLOAT2* outSamples);
+
+	// Warps from the unit square. XMScalarSinCos keeps these free of libm calls.
+	XMFLOAT2 SampleDisk(XMFLOAT2 u);
+	XMFLOAT3 SampleHemisphere(XMFLOAT2 u);
+
+	// Density of SampleHemisphere directions, which are uniform over the hemisphere
+	constexpr float k_hemispherePdf = 1.f / (2.f * XM_PI);
+}
+
+// Sampling state of one path: the pixel and sample being traced, and the next unused dimension.
+// Each call consumes one dimension, so paths that make the same decisions draw from the same dimensions.
+struct SampleContext
+{
+	uint32_t pixelSeed;
+	uint32_t sampleIndex;
+	uint32_t dimension;
+
+	float Next1D() { return Sampler::Get1D(sampleIndex, pixelSeed, dimension++); }
+	XMFLOAT2 Next2D() { return Sampler::Get2D(sampleIndex, pixelSeed, dimension++); }
+};
\ No newline at end of file
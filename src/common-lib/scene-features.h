@@ -0,0 +1,20 @@
+#pragma once
+
+#include "stdafx.h"
+
+// Bit set describing which optional features a scene uses. The integrator, material scattering and light
+// sampling are templated on it and instantiated for every combination, so the variant picked for a scene
+// carries no branches (or calls) for features the scene does not have.
+// BVH traversal is not part of the set: every scene holds only spheres, and the layout is fixed per tree and
+// already compiled into its own traversal loop, so the per-ray layout switch is all a variant could remove.
+// Nor is the number of lights: BoundedLights already drops light BVH sampling for scenes without such lights,
+// and for the others one light BVH descent replaces the per-light loop a count class would specialize.
+namespace SceneFeature
+{
+	constexpr uint32_t Emissive = 1u << 0;		// emissive materials: emission and MIS against area lights
+	constexpr uint32_t Transmission = 1u << 1;	// transparent dielectrics
+	constexpr uint32_t BoundedLights = 1u << 2;	// lights in the light BVH (point and sphere lights)
+
+	constexpr uint32_t All = Emissive | Transmission | BoundedLights;
+	constexpr uint32_t CombinationCount = All + 1;
+}
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include "shared-framebuffer.h"
+
+namespace
+{
+	// Image slots start on their own pages
+	constexpr size_t k_pageSize = 4096;
+
+	size_t AlignToPage(size_t bytes)
+	{
+		return (bytes + k_pageSize - 1) & ~(k_pageSize - 1);
+	}
+}
+
+SharedFramebuffer::~SharedFramebuffer()
+{
+	Close();
+}
+
+bool SharedFramebuffer::Create(const std::wstring& name, uint32_t width, uint32_t height)
+{
+	Close();
+
+	const size_t headerBytes = AlignToPage(sizeof(Header));
+	const size_t imageBytes = AlignToPage(sizeof(XMCOLOR) * width * height);
+	const size_t size = headerBytes + k_slotCount * imageBytes;
+
+	m_mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+		static_cast<DWORD>(static_cast<uint64_t>(size) >> 32), static_cast<DWORD>(size), name.c_str());
+	if (!m_mapping)
+	{
+		return false;
+	}
+
+	// Another renderer owns the name; sharing its section would overwrite its header and slots
+	if (GetLastError() == ERROR_ALREADY_EXISTS)
+	{
+		Close();
+		return false;
+	}
+
+	m_header = static_cast<Header*>(MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, size));
+	if (!m_header)
+	{
+		Close();
+		return false;
+	}
+
+	// New sections are zero filled; the magic is written last so a viewer never sees a partial header
+	m_header->version = k_version;
+	m_header->width = width;
+	m_header->height = height;
+	m_header->latest.store(k_noImage, std::memory_order_relaxed);
+
+	for (uint32_t slot = 0; slot < k_slotCount; ++slot)
+	{
+		m_header->slots[slot].pixelOffset = headerBytes + slot * imageBytes;
+	}
+
+	m_header->magic.store(k_magic, std::memory_order_release);
+
+	return true;
+}
+
+XMCOLOR* SharedFramebuffer::GetImage(uint32_t slot) const
+{
+	return reinterpret_cast<XMCOLOR*>(reinterpret_cast<std::byte*>(m_header) + m_header->slots[slot].pixelOffset);
+}
+
+void SharedFramebuffer::BeginWrite(uint32_t slot)
+{
+	// A cancelled pass can leave the slot odd already
+	std::atomic<uint64_t>& generation = m_header->slots[slot].generation;
+	const uint64_t current = generation.load(std::memory_order_relaxed);
+
+	if ((current & 1) == 0)
+	{
+		generation.store(current + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+	}
+}
+
+void SharedFramebuffer::EndWrite(uint32_t slot, uint64_t passCount)
+{
+	Slot& target = m_header->slots[slot];
+
+	target.passCount.store(passCount, std::memory_order_relaxed);
+	target.generation.store(target.generation.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	m_header->latest.store(slot, std::memory_order_release);
+}
+
+bool SharedFramebuffer::Open(const std::wstring& name)
+{
+	Close();
+
+	m_mapping = OpenFileMappingW(FILE_MAP_READ, FALSE, name.c_str());
+	if (!m_mapping)
+	{
+		return false;
+	}
+
+	// Map the header first to learn the size of the images
+	const auto* header = static_cast<const Header*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, sizeof(Header)));
+	if (!header)
+	{
+		Close();
+		return false;
+	}
+
+	// Pairs with the release store in Create, so the fields below are complete once the magic is there
+	const bool valid = header->magic.load(std::memory_order_acquire) == k_magic && header->version == k_version;
+	const size_t size = AlignToPage(sizeof(Header)) + k_slotCount * AlignToPage(sizeof(XMCOLOR) * header->width * header->height);
+	UnmapViewOfFile(header);
+
+	if (!valid)
+	{
+		Close();
+		return false;
+	}
+
+	m_header = static_cast<Header*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, size));
+	if (!m_header)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+bool SharedFramebuffer::TryRead(std::vector<XMCOLOR>& outImage, uint64_t& outPassCount) const
+{
+	const uint32_t slot = m_header->latest.load(std::memory_order_acquire);
+	if (slot >= k_slotCount)
+	{
+		return false;
+	}
+
+	const Slot& source = m_header->slots[slot];
+	const uint64_t before = source.generation.load(std::memory_order_acquire);
+	if (before & 1)
+	{
+		return false;
+	}
+
+	const size_t pixelCount = static_cast<size_t>(m_header->width) * m_header->height;
+	outImage.resize(pixelCount);
+	std::memcpy(outImage.data(), GetImage(slot), sizeof(XMCOLOR) * pixelCount);
+	outPassCount = source.passCount.load(std::memory_order_relaxed);
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return source.generation.load(std::memory_order_relaxed) == before;
+}
+
+void SharedFramebuffer::Close()
+{
+	if (m_header)
+	{
+		UnmapViewOfFile(m_header);
+		m_header = nullptr;
+	}
+
+	if (m_mapping)
+	{
+		CloseHandle(m_mapping);
+		m_mapping = nullptr;
+	}
+}
\ No newline at end of file
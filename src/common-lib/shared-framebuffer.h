@@ -0,0 +1,70 @@
+#pragma once
+
+#include "stdafx.h"
+
+// Display images of a running render in a named shared memory section, so another process can watch a
+// headless render by mapping it. Win32 sections backed by the paging file are this platform's equivalent of a
+// POSIX shm segment. The section holds the RenderLoop's image slots themselves: the renderer resolves straight
+// into shared memory and publishes with two stores, with no copy and no lock. Each slot carries a seqlock
+// generation that is odd while the renderer writes it; a reader takes the latest slot and keeps what it read
+// only if the generation is even and unchanged afterwards.
+class SharedFramebuffer
+{
+public:
+	static constexpr uint32_t k_magic = 0x42465452;	// "RTFB"
+	static constexpr uint32_t k_version = 1;
+	static constexpr uint32_t k_slotCount = 3;
+	static constexpr uint32_t k_noImage = ~0u;
+
+	struct Slot
+	{
+		std::atomic<uint64_t> generation;
+		std::atomic<uint64_t> passCount;	// passes accumulated in the image, samples per pixel for one-sample passes
+		uint64_t pixelOffset;				// bytes from the start of the section
+	};
+
+	// Images are row major A8R8G8B8 with a pitch of width pixels
+	struct Header
+	{
+		std::atomic<uint32_t> magic;	// published last, so a viewer that sees it sees the whole header
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		std::atomic<uint32_t> latest;	// slot of the newest complete image
+		Slot slots[k_slotCount];
+	};
+
+	static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+		"Atomics in shared memory must not depend on a process-local lock");
+
+	SharedFramebuffer() = default;
+	~SharedFramebuffer();
+
+	SharedFramebuffer(const SharedFramebuffer&) = delete;
+	SharedFramebuffer& operator=(const SharedFramebuffer&) = delete;
+
+	// Renderer: creates the section, e.g. L"Local\\spheres". Fails when the name is taken, also by a viewer that
+	// still holds the section of an earlier run.
+	bool Create(const std::wstring& name, uint32_t width, uint32_t height);
+	XMCOLOR* GetImage(uint32_t slot) const;
+	void BeginWrite(uint32_t slot);
+	void EndWrite(uint32_t slot, uint64_t passCount);
+
+	// Viewer: maps an existing section read-only
+	bool Open(const std::wstring& name);
+
+	// Copies the newest complete image. Returns false before the first image or when the renderer started
+	// rewriting the slot during the copy; callers retry.
+	bool TryRead(std::vector<XMCOLOR>& outImage, uint64_t& outPassCount) const;
+
+	bool IsMapped() const { return m_header != nullptr; }
+	uint32_t GetWidth() const { return m_header->width; }
+	uint32_t GetHeight() const { return m_header->height; }
+
+private:
+	void Close();
+
+private:
+	HANDLE m_mapping = nullptr;
+	Header* m_header = nullptr;
+};
\ No newline at end of file
@@ -0,0 +1,336 @@
+#include "texture-cache.h"
+#include "image-io.h"
+
+namespace
+{
+	constexpr uint32_t k_tiledImageMagic = 0x58455454; // 'TTEX'
+	constexpr size_t k_defaultCacheCapacity = 256ull * 1024 * 1024;
+
+	struct TiledImageHeader
+	{
+		uint32_t magic;
+		uint32_t width;
+		uint32_t height;
+		uint32_t levelCount;
+		uint32_t tileSize;
+	};
+
+	// 2x2 box filter. Odd dimensions clamp the last row/column.
+	std::vector<XMCOLOR> Downsample(const std::vector<XMCOLOR>& src, uint32_t width, uint32_t height)
+	{
+		const uint32_t dstWidth = std::max(width / 2, 1u);
+		const uint32_t dstHeight = std::max(height / 2, 1u);
+		std::vector<XMCOLOR> dst(static_cast<size_t>(dstWidth) * dstHeight);
+
+		for (uint32_t y = 0; y < dstHeight; ++y)
+		{
+			for (uint32_t x = 0; x < dstWidth; ++x)
+			{
+				const uint32_t x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+				const uint32_t y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+
+				XMVECTOR sum = XMLoadColor(&src[y0 * width + x0]) + XMLoadColor(&src[y0 * width + x1]) +
+					XMLoadColor(&src[y1 * width + x0]) + XMLoadColor(&src[y1 * width + x1]);
+
+				XMStoreColor(&dst[y * dstWidth + x], 0.25f * sum);
+			}
+		}
+
+		return dst;
+	}
+}
+
+std::unique_ptr<TiledImage> TiledImage::Load(const std::string& tiledPath)
+{
+	std::unique_ptr<TiledImage> image{ new TiledImage };
+	image->m_file.open(tiledPath, std::ios::binary);
+
+	TiledImageHeader header{};
+	image->m_file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+	// A level count beyond 32 cannot come from a 32-bit size, so the file is not one of ours
+	if (!image->m_file || header.magic != k_tiledImageMagic || header.tileSize != k_tileSize ||
+		header.width == 0 || header.height == 0 || header.levelCount == 0 || header.levelCount > 32)
+	{
+		return nullptr;
+	}
+
+	uint64_t offset = sizeof(header);
+	uint32_t width = header.width;
+	uint32_t height = header.height;
+
+	for (uint32_t level = 0; level < header.levelCount; ++level)
+	{
+		Level desc;
+		desc.width = width;
+		desc.height = height;
+		desc.tilesX = (width + k_tileSize - 1) / k_tileSize;
+		desc.tilesY = (height + k_tileSize - 1) / k_tileSize;
+		desc.offset = offset;
+		image->m_levels.push_back(desc);
+
+		offset += static_cast<uint64_t>(desc.tilesX) * desc.tilesY * k_tileTexelCount * sizeof(XMCOLOR);
+		width = std::max(width / 2, 1u);
+		height = std::max(height / 2, 1u);
+	}
+
+	return image;
+}
+
+bool TiledImage::Convert(const std::string& ppmPath, const std::string& tiledPath)
+{
+	std::vector<XMCOLOR> texels;
+	uint32_t width, height;
+
+	if (!ImageIO::ReadPpm(ppmPath, texels, width, height))
+	{
+		return false;
+	}
+
+	std::ofstream file(tiledPath, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	uint32_t levelCount = 1;
+	while ((width >> (levelCount - 1)) > 1 || (height >> (levelCount - 1)) > 1)
+	{
+		++levelCount;
+	}
+
+	const TiledImageHeader header{ k_tiledImageMagic, width, height, levelCount, k_tileSize };
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	std::vector<XMCOLOR> tile(k_tileTexelCount);
+
+	for (uint32_t level = 0; level < levelCount; ++level)
+	{
+		const uint32_t tilesX = (width + k_tileSize - 1) / k_tileSize;
+		const uint32_t tilesY = (height + k_tileSize - 1) / k_tileSize;
+
+		// Tiles are written row-major, texels within a tile are row-major. Edge tiles clamp to the image border.
+		for (uint32_t ty = 0; ty < tilesY; ++ty)
+		{
+			for (uint32_t tx = 0; tx < tilesX; ++tx)
+			{
+				for (uint32_t y = 0; y < k_tileSize; ++y)
+				{
+					for (uint32_t x = 0; x < k_tileSize; ++x)
+					{
+						const uint32_t srcX = std::min(tx * k_tileSize + x, width - 1);
+						const uint32_t srcY = std::min(ty * k_tileSize + y, height - 1);
+						tile[y * k_tileSize + x] = texels[srcY * width + srcX];
+					}
+				}
+
+				file.write(reinterpret_cast<const char*>(tile.data()), tile.size() * sizeof(XMCOLOR));
+			}
+		}
+
+		if (level + 1 < levelCount)
+		{
+			texels = Downsample(texels, width, height);
+			width = std::max(width / 2, 1u);
+			height = std::max(height / 2, 1u);
+		}
+	}
+
+	return static_cast<bool>(file);
+}
+
+void TiledImage::LoadTile(uint32_t level, uint32_t tileX, uint32_t tileY, XMCOLOR* outTexels) const
+{
+	const Level& desc = m_levels[level];
+	const uint64_t tileBytes = k_tileTexelCount * sizeof(XMCOLOR);
+	const uint64_t offset = desc.offset + (static_cast<uint64_t>(tileY) * desc.tilesX + tileX) * tileBytes;
+
+	std::lock_guard<std::mutex> lock{ m_fileMutex };
+	m_file.seekg(offset);
+	m_file.read(reinterpret_cast<char*>(outTexels), tileBytes);
+}
+
+TextureCache::TextureCache()
+{
+	SetCapacity(k_defaultCacheCapacity);
+}
+
+TextureCache& TextureCache::Instance()
+{
+	static TextureCache cache;
+	return cache;
+}
+
+void TextureCache::SetCapacity(size_t bytes)
+{
+	m_capacityBytes = bytes;
+
+	const size_t tilesPerShard = std::max<size_t>(bytes / (sizeof(Tile) * k_shardCount), 1);
+	for (Shard& shard : m_shards)
+	{
+		std::lock_guard<std::mutex> lock{ shard.mutex };
+		shard.capacity = tilesPerShard;
+
+		while (shard.lru.size() > shard.capacity)
+		{
+			shard.lookup.erase(shard.lru.back().key);
+			shard.lru.pop_back();
+		}
+	}
+}
+
+uint32_t TextureCache::AddImage(const std::string& tiledPath)
+{
+	if (const auto it = m_imageIds.find(tiledPath); it != m_imageIds.end())
+	{
+		return it->second;
+	}
+
+	std::unique_ptr<TiledImage> image = TiledImage::Load(tiledPath);
+	if (!image)
+	{
+		return k_invalidId;
+	}
+
+	m_images.push_back(std::move(image));
+
+	const auto id = static_cast<uint32_t>(m_images.size() - 1);
+	m_imageIds.emplace(tiledPath, id);
+
+	return id;
+}
+
+XMVECTOR TextureCache::Sample(uint32_t imageId, XMFLOAT2 uv, float uvFootprint)
+{
+	// Ids of images that failed to load leave the tint unchanged
+	if (imageId >= m_images.size())
+	{
+		return XM_One;
+	}
+
+	const TiledImage& image = *m_images[imageId];
+
+	// Pick the mip level whose texel size matches the footprint of the hit in uv space
+	const float texelsCovered = uvFootprint * static_cast<float>(image.GetWidth(0));
+	const float lod = texelsCovered > 1.f ? std::log2(texelsCovered) : 0.f;
+	const uint32_t level = std::min(static_cast<uint32_t>(lod), image.GetLevelCount() - 1);
+
+	const auto width = static_cast<int>(image.GetWidth(level));
+	const auto height = static_cast<int>(image.GetHeight(level));
+
+	// Bilinear filter with repeat addressing
+	const float fx = uv.x * width - 0.5f;
+	const float fy = uv.y * height - 0.5f;
+	const float x0 = std::floor(fx);
+	const float y0 = std::floor(fy);
+
+	auto wrap = [](int i, int size) { return static_cast<uint32_t>(((i % size) + size) % size); };
+
+	const uint32_t x[2] = { wrap(static_cast<int>(x0), width), wrap(static_cast<int>(x0) + 1, width) };
+	const uint32_t y[2] = { wrap(static_cast<int>(y0), height), wrap(static_cast<int>(y0) + 1, height) };
+
+	XMVECTOR texels[4];
+	FetchQuad(imageId, level, x, y, texels);
+
+	const float tx = fx - x0;
+	const float ty = fy - y0;
+
+	return XMVectorLerp(XMVectorLerp(texels[0], texels[1], tx), XMVectorLerp(texels[2], texels[3], tx), ty);
+}
+
+TextureCache::Stats TextureCache::GetStats() const
+{
+	size_t residentTiles = 0;
+	for (const Shard& shard : m_shards)
+	{
+		std::lock_guard<std::mutex> lock{ shard.mutex };
+		residentTiles += shard.lru.size();
+	}
+
+	return Stats{ m_hits.load(), m_misses.load(), m_evictions.load(), residentTiles * sizeof(Tile), m_capacityBytes };
+}
+
+uint64_t TextureCache::MakeKey(uint32_t imageId, uint32_t level, uint32_t tileX, uint32_t tileY)
+{
+	// 16 bits image, 8 bits level, 20 bits per tile coordinate
+	return (static_cast<uint64_t>(imageId) << 48) | (static_cast<uint64_t>(level) << 40) |
+		(static_cast<uint64_t>(tileX) << 20) | static_cast<uint64_t>(tileY);
+}
+
+const TextureCache::Tile& TextureCache::AcquireTile(Shard& shard, uint32_t imageId, uint32_t level, uint32_t tileX, uint32_t tileY)
+{
+	// Caller must hold the shard lock
+	const uint64_t key = MakeKey(imageId, level, tileX, tileY);
+
+	if (auto it = shard.lookup.find(key); it != shard.lookup.end())
+	{
+		++m_hits;
+		shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+		return it->second->texels;
+	}
+
+	++m_misses;
+
+	if (shard.lru.size() < shard.capacity)
+	{
+		shard.lru.emplace_front();
+	}
+	else
+	{
+		// Recycle the least recently used tile
+		++m_evictions;
+		shard.lookup.erase(shard.lru.back().key);
+		shard.lru.splice(shard.lru.begin(), shard.lru, std::prev(shard.lru.end()));
+	}
+
+	Entry& entry = shard.lru.front();
+	entry.key = key;
+	m_images[imageId]->LoadTile(level, tileX, tileY, entry.texels.data());
+	shard.lookup.emplace(key, shard.lru.begin());
+
+	return entry.texels;
+}
+
+void TextureCache::FetchQuad(uint32_t imageId, uint32_t level, const uint32_t x[2], const uint32_t y[2], XMVECTOR outTexels[4])
+{
+	constexpr uint32_t tileSize = TiledImage::k_tileSize;
+
+	auto shardIndex = [imageId, level](uint32_t tileX, uint32_t tileY)
+	{
+		return static_cast<size_t>((tileX * 73856093u) ^ (tileY * 19349663u) ^ (level * 83492791u) ^ imageId) % k_shardCount;
+	};
+
+	const uint32_t tileX[2] = { x[0] / tileSize, x[1] / tileSize };
+	const uint32_t tileY[2] = { y[0] / tileSize, y[1] / tileSize };
+
+	if (tileX[0] == tileX[1] && tileY[0] == tileY[1])
+	{
+		// Common case: the whole footprint lies in a single tile, so take the lock once
+		Shard& shard = m_shards[shardIndex(tileX[0], tileY[0])];
+		std::lock_guard<std::mutex> lock{ shard.mutex };
+		const Tile& tile = AcquireTile(shard, imageId, level, tileX[0], tileY[0]);
+
+		for (int i = 0; i < 4; ++i)
+		{
+			const uint32_t lx = x[i & 1] % tileSize;
+			const uint32_t ly = y[i >> 1] % tileSize;
+			outTexels[i] = XMLoadColor(&tile[ly * tileSize + lx]);
+		}
+	}
+	else
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			const uint32_t tx = tileX[i & 1];
+			const uint32_t ty = tileY[i >> 1];
+
+			Shard& shard = m_shards[shardIndex(tx, ty)];
+			std::lock_guard<std::mutex> lock{ shard.mutex };
+			const Tile& tile = AcquireTile(shard, imageId, level, tx, ty);
+
+			const uint32_t lx = x[i & 1] % tileSize;
+			const uint32_t ly = y[i >> 1] % tileSize;
+			outTexels[i] = XMLoadColor(&tile[ly * tileSize + lx]);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "stdafx.h"
+#include "ray-tracing.h"
+
+// Mip-mapped image stored on disk as fixed-size square tiles. Only metadata is kept in memory;
+// texel data is streamed in one tile at a time through the TextureCache.
+class TiledImage
+{
+public:
+	static constexpr uint32_t k_tileSize = 32;	// 32x32 XMCOLOR texels = one 4KB page per tile
+	static constexpr uint32_t k_tileTexelCount = k_tileSize * k_tileSize;
+
+	// nullptr when the file is missing or not a tiled image
+	static std::unique_ptr<TiledImage> Load(const std::string& tiledPath);
+
+	// Builds the full mip chain of a binary PPM (P6) image and writes it out in tiled layout
+	static bool Convert(const std::string& ppmPath, const std::string& tiledPath);
+
+	uint32_t GetLevelCount() const { return static_cast<uint32_t>(m_levels.size()); }
+	uint32_t GetWidth(uint32_t level) const { return m_levels[level].width; }
+	uint32_t GetHeight(uint32_t level) const { return m_levels[level].height; }
+	uint32_t GetTilesX(uint32_t level) const { return m_levels[level].tilesX; }
+	void LoadTile(uint32_t level, uint32_t tileX, uint32_t tileY, XMCOLOR* outTexels) const;
+
+private:
+	TiledImage() = default;
+
+	struct Level
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t tilesX;
+		uint32_t tilesY;
+		uint64_t offset;
+	};
+
+	std::vector<Level> m_levels;
+	mutable std::ifstream m_file;
+	mutable std::mutex m_fileMutex;
+};
+
+// Fixed-size LRU cache of image tiles shared by all render threads. The cache is split into
+// independently locked shards so that concurrent lookups rarely contend on the same mutex.
+class TextureCache
+{
+public:
+	struct Stats
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+		size_t residentBytes;
+		size_t capacityBytes;
+	};
+
+	static TextureCache& Instance();
+
+	void SetCapacity(size_t bytes);
+	// k_invalidId when the image cannot be loaded; callers fall back to a constant texture
+	uint32_t AddImage(const std::string& tiledPath);
+	XMVECTOR Sample(uint32_t imageId, XMFLOAT2 uv, float uvFootprint);
+	Stats GetStats() const;
+
+private:
+	TextureCache();
+
+	static constexpr size_t k_shardCount = 16;
+	using Tile = std::array<XMCOLOR, TiledImage::k_tileTexelCount>;
+
+	struct Entry
+	{
+		uint64_t key;
+		Tile texels;
+	};
+
+	struct Shard
+	{
+		mutable std::mutex mutex;
+		std::list<Entry> lru;	// most recently used at the front
+		std::unordered_map<uint64_t, std::list<Entry>::iterator> lookup;
+		size_t capacity = 0;
+	};
+
+	static uint64_t MakeKey(uint32_t imageId, uint32_t level, uint32_t tileX, uint32_t tileY);
+	const Tile& AcquireTile(Shard& shard, uint32_t imageId, uint32_t level, uint32_t tileX, uint32_t tileY);
+	void FetchQuad(uint32_t imageId, uint32_t level, const uint32_t x[2], const uint32_t y[2], XMVECTOR outTexels[4]);
+
+private:
+	std::vector<std::unique_ptr<TiledImage>> m_images;
+	std::unordered_map<std::string, uint32_t> m_imageIds;	// path -> id, so materials sharing an image share its tiles
+	std::array<Shard, k_shardCount> m_shards;
+	size_t m_capacityBytes = 0;
+	std::atomic<uint64_t> m_hits = 0u;
+	std::atomic<uint64_t> m_misses = 0u;
+	std::atomic<uint64_t> m_evictions = 0u;
+};
\ No newline at end of file
@@ -1,33 +1,40 @@
 #include "texture.h"
+#include "texture-cache.h"
 
-ConstTexture::ConstTexture(const XMCOLOR& color)
+Texture Texture::Const(const XMCOLOR& color)
 {
-	m_color = XMLoadColor(&color);
+	return Texture{ TextureType::Const, color, color, 1.f, 0u };
 }
 
-XMVECTOR ConstTexture::Evaluate(XMFLOAT2 uv) const
+Texture Texture::Checker(const XMCOLOR& color0, const XMCOLOR& color1, float tiling)
 {
-	return m_color;
+	return Texture{ TextureType::Checker, color0, color1, tiling, 0u };
 }
 
-CheckerTexture::CheckerTexture(const XMCOLOR& color0, const XMCOLOR& color1, float tiling) :
-	m_tilingScale{tiling}
+Texture Texture::Image(uint32_t imageId, const XMCOLOR& tint)
 {
-	m_checkerColors[0] = XMLoadColor(&color0);
-	m_checkerColors[1] = XMLoadColor(&color1);
+	return Texture{ TextureType::Image, tint, tint, 1.f, imageId };
 }
 
-XMVECTOR CheckerTexture::Evaluate(XMFLOAT2 uv) const
+XMVECTOR Texture::Evaluate(XMFLOAT2 uv, float uvFootprint) const
 {
-	const auto u = static_cast<int>(m_tilingScale * uv.x);
-	const auto v = static_cast<int>(m_tilingScale * uv.y);
-
-	if (u % 2 == v % 2)
+	switch (type)
 	{
-		return m_checkerColors[0];
-	}
-	else
+	case TextureType::Checker:
 	{
-		return m_checkerColors[1];
+		const auto u = static_cast<int>(tilingScale * uv.x);
+		const auto v = static_cast<int>(tilingScale * uv.y);
+
+		return (u % 2 == v % 2) ? XMLoadColor(&color0) : XMLoadColor(&color1);
+	}
+	case TextureType::Image:
+		if (imageId == k_invalidId)
+		{
+			return XMLoadColor(&color0);
+		}
+		return XMLoadColor(&color0) * TextureCache::Instance().Sample(imageId, uv, uvFootprint);
+	case TextureType::Const:
+	default:
+		return XMLoadColor(&color0);
 	}
 }
\ No newline at end of file
@@ -3,29 +3,27 @@
 #include "stdafx.h"
 #include "ray-tracing.h"
 
-class Texture
+enum class TextureType : uint32_t
 {
-public:
-	virtual XMVECTOR Evaluate(XMFLOAT2 uv) const = 0;
+	Const,
+	Checker,
+	Image
 };
 
-class ConstTexture : public Texture
+// Plain-data texture description. Stored inline in materials so that evaluating a texture
+// does not require chasing a pointer or a virtual call.
+struct Texture
 {
-public:
-	ConstTexture(const XMCOLOR& color);
-	XMVECTOR Evaluate(XMFLOAT2 uv) const override;
+	TextureType type;
+	XMCOLOR color0;
+	XMCOLOR color1;
+	float tilingScale;
+	uint32_t imageId;	// TextureCache image for image textures. color0 is used as a tint.
 
-private:
-	XMVECTOR m_color;
-};
-
-class CheckerTexture : public Texture
-{
-public:
-	CheckerTexture(const XMCOLOR& color0, const XMCOLOR& color1, float tiling);
-	XMVECTOR Evaluate(XMFLOAT2 uv) const override;
+	static Texture Const(const XMCOLOR& color);
+	static Texture Checker(const XMCOLOR& color0, const XMCOLOR& color1, float tiling);
+	static Texture Image(uint32_t imageId, const XMCOLOR& tint = XMCOLOR{ 1.f, 1.f, 1.f, 1.f });
 
-private:
-	std::array<XMVECTOR, 2> m_checkerColors;
-	float m_tilingScale;
+	// uvFootprint is the approximate width of the shading point in uv space and drives mip selection
+	XMVECTOR Evaluate(XMFLOAT2 uv, float uvFootprint = 0.f) const;
 };
\ No newline at end of file
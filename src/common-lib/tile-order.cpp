@@ -0,0 +1,133 @@
+#include "tile-order.h"
+
+namespace
+{
+	// Position of step d along the Hilbert curve filling an n x n grid, n a power of two
+	XMUINT2 HilbertPoint(uint32_t n, uint32_t d)
+	{
+		XMUINT2 p{ 0, 0 };
+
+		for (uint32_t s = 1; s < n; s *= 2)
+		{
+			const uint32_t rx = 1 & (d / 2);
+			const uint32_t ry = 1 & (d ^ rx);
+
+			if (ry == 0)
+			{
+				if (rx == 1)
+				{
+					p.x = s - 1 - p.x;
+					p.y = s - 1 - p.y;
+				}
+
+				std::swap(p.x, p.y);
+			}
+
+			p.x += s * rx;
+			p.y += s * ry;
+			d /= 4;
+		}
+
+		return p;
+	}
+}
+
+std::vector<uint32_t> MakeTileOrder(const Framebuffer& framebuffer, const PixelRect& region, TileOrder order, XMUINT2 focus)
+{
+	constexpr uint32_t k_tileSize = Framebuffer::k_tileSize;
+
+	const uint32_t left = region.left / k_tileSize;
+	const uint32_t top = region.top / k_tileSize;
+	const uint32_t right = std::max(left, (std::min(region.right, framebuffer.GetWidth()) + k_tileSize - 1) / k_tileSize);
+	const uint32_t bottom = std::max(top, (std::min(region.bottom, framebuffer.GetHeight()) + k_tileSize - 1) / k_tileSize);
+
+	std::vector<uint32_t> tiles;
+	tiles.reserve(static_cast<size_t>(right - left) * (bottom - top));
+
+	auto tileIndex = [&framebuffer](uint32_t x, uint32_t y) { return y * framebuffer.GetTileCountX() + x; };
+
+	switch (order)
+	{
+	case TileOrder::Scanline:
+		for (uint32_t y = top; y < bottom; ++y)
+		{
+			for (uint32_t x = left; x < right; ++x)
+			{
+				tiles.push_back(tileIndex(x, y));
+			}
+		}
+		break;
+
+	case TileOrder::Hilbert:
+	{
+		uint32_t n = 1;
+		while (n < right - left || n < bottom - top)
+		{
+			n *= 2;
+		}
+
+		// The curve covers the enclosing power of two square; steps outside the region are skipped
+		for (uint32_t d = 0; d < n * n; ++d)
+		{
+			const XMUINT2 p = HilbertPoint(n, d);
+			if (left + p.x < right && top + p.y < bottom)
+			{
+				tiles.push_back(tileIndex(left + p.x, top + p.y));
+			}
+		}
+		break;
+	}
+
+	case TileOrder::Spiral:
+	case TileOrder::Focus:
+	{
+		if (order == TileOrder::Spiral)
+		{
+			focus = XMUINT2{ (region.left + region.right) / 2, (region.top + region.bottom) / 2 };
+		}
+
+		const auto focusX = static_cast<int>(std::clamp(focus.x / k_tileSize, left, std::max(left, right - 1)));
+		const auto focusY = static_cast<int>(std::clamp(focus.y / k_tileSize, top, std::max(top, bottom - 1)));
+
+		struct Key
+		{
+			int ring;
+			float angle;	// clockwise from straight up
+			uint32_t tile;
+		};
+
+		std::vector<Key> keys;
+		keys.reserve(tiles.capacity());
+
+		for (uint32_t y = top; y < bottom; ++y)
+		{
+			for (uint32_t x = left; x < right; ++x)
+			{
+				const int dx = static_cast<int>(x) - focusX;
+				const int dy = static_cast<int>(y) - focusY;
+
+				float angle = std::atan2(static_cast<float>(dx), static_cast<float>(-dy));
+				if (angle < 0.f)
+				{
+					angle += XM_2PI;
+				}
+
+				keys.push_back(Key{ std::max(std::abs(dx), std::abs(dy)), angle, tileIndex(x, y) });
+			}
+		}
+
+		std::sort(keys.begin(), keys.end(), [](const Key& a, const Key& b)
+		{
+			return a.ring != b.ring ? a.ring < b.ring : a.angle < b.angle;
+		});
+
+		for (const Key& key : keys)
+		{
+			tiles.push_back(key.tile);
+		}
+		break;
+	}
+	}
+
+	return tiles;
+}
\ No newline at end of file
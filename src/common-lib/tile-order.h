@@ -0,0 +1,16 @@
+#pragma once
+
+#include "stdafx.h"
+#include "framebuffer.h"
+
+enum class TileOrder : uint32_t
+{
+	Scanline,	// row by row from the top left
+	Spiral,		// rings outwards from the centre of the traced region
+	Hilbert,	// along a Hilbert curve: consecutive tiles are neighbours, so their rays share scene data in cache
+	Focus		// rings outwards from a chosen pixel, e.g. where the user clicked
+};
+
+// Indices of the framebuffer tiles that overlap region, in the order they should be traced. Rings are square
+// in tile units and each ring is walked clockwise. focus is in pixels and only used by TileOrder::Focus.
+std::vector<uint32_t> MakeTileOrder(const Framebuffer& framebuffer, const PixelRect& region, TileOrder order, XMUINT2 focus = XMUINT2{ 0, 0 });
\ No newline at end of file
@@ -0,0 +1,262 @@
+#include "worker-pool.h"
+
+namespace
+{
+	thread_local uint32_t t_currentNode = WorkerPool::k_noNode;
+}
+
+WorkerPool::WorkerPool()
+{
+	DiscoverTopology();
+
+	for (uint32_t node = 0; node < GetNodeCount(); ++node)
+	{
+		m_nodes[node]->firstWorker = GetWorkerCount();
+		for (size_t i = 0; i < m_nodes[node]->processors.size(); ++i)
+		{
+			m_workers.push_back(Worker{ std::thread{}, node });
+		}
+	}
+
+	// Threads start once m_workers no longer reallocates
+	for (uint32_t i = 0; i < GetWorkerCount(); ++i)
+	{
+		m_workers[i].thread = std::thread(&WorkerPool::WorkerMain, this, i);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+
+	m_wake.notify_all();
+
+	for (Worker& worker : m_workers)
+	{
+		worker.thread.join();
+	}
+}
+
+void WorkerPool::DiscoverTopology()
+{
+	// A node lists its processors in every processor group it spans. Before Windows 10 20H2 GroupCount is 0 and
+	// such a node is reported once per group instead, so processors are collected first and grouped by node.
+	DWORD length = 0;
+	GetLogicalProcessorInformationEx(RelationNumaNode, nullptr, &length);
+
+	std::vector<uint8_t> buffer(length);
+	std::vector<std::pair<DWORD, Processor>> processors;
+
+	if (length > 0 && GetLogicalProcessorInformationEx(RelationNumaNode, reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data()), &length))
+	{
+		for (DWORD offset = 0; offset < length;)
+		{
+			const auto& info = *reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data() + offset);
+			offset += info.Size;
+
+			if (info.Relationship != RelationNumaNode)
+			{
+				continue;
+			}
+
+			const NUMA_NODE_RELATIONSHIP& numaNode = info.NumaNode;
+			for (WORD group = 0; group < std::max<WORD>(numaNode.GroupCount, 1); ++group)
+			{
+				const GROUP_AFFINITY& affinity = numaNode.GroupMasks[group];
+				for (uint8_t bit = 0; bit < 64; ++bit)
+				{
+					if (affinity.Mask & (KAFFINITY{ 1 } << bit))
+					{
+						processors.emplace_back(numaNode.NodeNumber, Processor{ affinity.Group, bit });
+					}
+				}
+			}
+		}
+	}
+
+	std::sort(processors.begin(), processors.end(), [](const auto& a, const auto& b)
+	{
+		return std::tie(a.first, a.second.group, a.second.number) < std::tie(b.first, b.second.group, b.second.number);
+	});
+
+	// Memory-only nodes have no processors to run on, so they get no Node
+	for (size_t i = 0; i < processors.size(); ++i)
+	{
+		if (i == 0 || processors[i].first != processors[i - 1].first)
+		{
+			m_nodes.push_back(std::make_unique<Node>());
+		}
+
+		m_nodes.back()->processors.push_back(processors[i].second);
+	}
+
+	m_pinned = !m_nodes.empty();
+
+	if (!m_pinned)
+	{
+		auto node = std::make_unique<Node>();
+		node->processors.resize(std::max(1u, std::thread::hardware_concurrency()));
+		m_nodes.push_back(std::move(node));
+	}
+}
+
+uint32_t WorkerPool::GetNodeItem(const Node& node, uint32_t index) const
+{
+	const auto workers = static_cast<uint32_t>(node.processors.size());
+	return index / workers * GetWorkerCount() + node.firstWorker + index % workers;
+}
+
+uint32_t WorkerPool::GetNodeForItem(uint32_t item) const
+{
+	const uint32_t worker = item % GetWorkerCount();
+
+	uint32_t node = 0;
+	while (node + 1 < GetNodeCount() && m_nodes[node + 1]->firstWorker <= worker)
+	{
+		++node;
+	}
+
+	return node;
+}
+
+void WorkerPool::ParallelFor(uint32_t itemCount, const ItemFunction& function, bool allowStealing)
+{
+	if (itemCount == 0)
+	{
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	// Whole rounds, then the part of the last round that falls on the node's workers
+	const uint32_t rounds = itemCount / GetWorkerCount();
+	const uint32_t remainder = itemCount % GetWorkerCount();
+
+	for (const std::unique_ptr<Node>& node : m_nodes)
+	{
+		const auto workers = static_cast<uint32_t>(node->processors.size());
+		node->next = 0;
+		node->count = rounds * workers + std::min(remainder - std::min(remainder, node->firstWorker), workers);
+	}
+
+	m_function = &function;
+	m_allowStealing = allowStealing;
+	m_activeWorkers = GetWorkerCount();
+	++m_generation;
+
+	m_wake.notify_all();
+	m_done.wait(lock, [this]() { return m_activeWorkers == 0; });
+
+	m_function = nullptr;
+}
+
+void WorkerPool::ForEachNode(const std::function<void(uint32_t node)>& function)
+{
+	// One round of items and no stealing: each node receives exactly its own workers' indices
+	ParallelFor(GetWorkerCount(), [this, &function](uint32_t item, uint32_t node)
+	{
+		if (item == m_nodes[node]->firstWorker)
+		{
+			function(node);
+		}
+
+		return uint64_t{ 0 };
+	}, false);
+}
+
+uint32_t WorkerPool::GetCurrentNode()
+{
+	return t_currentNode;
+}
+
+void WorkerPool::WorkerMain(uint32_t workerIndex)
+{
+	const uint32_t node = m_workers[workerIndex].node;
+	t_currentNode = node;
+
+	if (m_pinned)
+	{
+		const Processor& processor = m_nodes[node]->processors[workerIndex - m_nodes[node]->firstWorker];
+
+		GROUP_AFFINITY affinity{};
+		affinity.Mask = KAFFINITY{ 1 } << processor.number;
+		affinity.Group = processor.group;
+		SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr);
+	}
+
+	uint64_t generation = 0;
+
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this, generation]() { return m_stop || m_generation != generation; });
+
+			if (m_stop)
+			{
+				return;
+			}
+
+			generation = m_generation;
+		}
+
+		RunItems(node);
+
+		// The caller returns only after every worker has left the job, so the next job cannot overlap this one
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (--m_activeWorkers == 0)
+		{
+			m_done.notify_one();
+		}
+	}
+}
+
+void WorkerPool::RunItems(uint32_t node)
+{
+	const uint32_t victimCount = m_allowStealing ? GetNodeCount() : 1;
+
+	uint64_t items = 0;
+	uint64_t stolenItems = 0;
+	uint64_t work = 0;
+	const auto start = std::chrono::steady_clock::now();
+
+	for (uint32_t offset = 0; offset < victimCount; ++offset)
+	{
+		Node& victim = *m_nodes[(node + offset) % GetNodeCount()];
+
+		for (uint32_t index = victim.next++; index < victim.count; index = victim.next++)
+		{
+			work += (*m_function)(GetNodeItem(victim, index), node);
+			++items;
+			stolenItems += offset > 0 ? 1 : 0;
+		}
+	}
+
+	const std::chrono::duration<uint64_t, std::nano> busy = std::chrono::steady_clock::now() - start;
+
+	Node& stats = *m_nodes[node];
+	stats.items += items;
+	stats.stolenItems += stolenItems;
+	stats.work += work;
+	stats.busyNanoseconds += busy.count();
+}
+
+std::vector<WorkerPool::NodeStats> WorkerPool::GetStats() const
+{
+	std::vector<NodeStats> stats;
+
+	for (const auto& node : m_nodes)
+	{
+		stats.push_back(NodeStats{
+			static_cast<uint32_t>(node->processors.size()),
+			node->items,
+			node->stolenItems,
+			node->work,
+			node->busyNanoseconds * 1e-9 });
+	}
+
+	return stats;
+}
\ No newline at end of file
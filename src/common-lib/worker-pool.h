@@ -0,0 +1,100 @@
+#pragma once
+
+#include "stdafx.h"
+
+// Fixed set of render threads, one per logical processor and pinned to it. Work items are dealt out to the NUMA
+// nodes in rounds of one item per worker, each node taking its workers' share of every round, so the items of
+// all nodes are spread over the whole range and nodes working at the same pace proceed through it in order.
+// Workers drain their own node's items first and only then help the other nodes, so memory first touched while
+// processing an item stays local to the cores that keep using it. Falls back to a single unpinned node when
+// the topology is unknown.
+class WorkerPool
+{
+public:
+	struct NodeStats
+	{
+		uint32_t workerCount;
+		uint64_t items;			// items run by this node's workers, including stolen ones
+		uint64_t stolenItems;	// items taken from another node's share
+		uint64_t work;			// sum of the amounts returned by the item function, e.g. rays
+		double busySeconds;		// summed over the node's workers
+	};
+
+	// Returns the amount of work done for the item, which is summed into the node statistics
+	using ItemFunction = std::function<uint64_t(uint32_t item, uint32_t node)>;
+
+	WorkerPool();
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	uint32_t GetNodeCount() const { return static_cast<uint32_t>(m_nodes.size()); }
+	uint32_t GetWorkerCount() const { return static_cast<uint32_t>(m_workers.size()); }
+
+	// Node an item is dealt to, whatever the item count
+	uint32_t GetNodeForItem(uint32_t item) const;
+
+	// Runs function for every item in [0, itemCount) and blocks until all are done. Without stealing every
+	// item runs on its own node, which is what first-touch placement of per-item memory needs.
+	void ParallelFor(uint32_t itemCount, const ItemFunction& function, bool allowStealing = true);
+
+	// Runs function once on one worker of every node, e.g. to build node-local copies of data
+	void ForEachNode(const std::function<void(uint32_t node)>& function);
+
+	// NUMA node of the calling pool worker, k_noNode on other threads
+	static constexpr uint32_t k_noNode = std::numeric_limits<uint32_t>::max();
+	static uint32_t GetCurrentNode();
+
+	std::vector<NodeStats> GetStats() const;
+
+private:
+	struct Processor
+	{
+		uint16_t group;
+		uint8_t number;
+	};
+
+	// Shared between all workers of a node; padded so nodes do not contend on cache lines
+	struct alignas(64) Node
+	{
+		std::vector<Processor> processors;
+		uint32_t firstWorker = 0;
+
+		// Current job, counted in the node's own items
+		uint32_t count = 0;
+		std::atomic<uint32_t> next = 0;
+
+		std::atomic<uint64_t> items = 0;
+		std::atomic<uint64_t> stolenItems = 0;
+		std::atomic<uint64_t> work = 0;
+		std::atomic<uint64_t> busyNanoseconds = 0;
+	};
+
+	struct Worker
+	{
+		std::thread thread;
+		uint32_t node;
+	};
+
+	void DiscoverTopology();
+	void WorkerMain(uint32_t workerIndex);
+	void RunItems(uint32_t node);
+	// Item of the current job that is the index-th one of the node
+	uint32_t GetNodeItem(const Node& node, uint32_t index) const;
+
+private:
+	std::vector<std::unique_ptr<Node>> m_nodes;
+	std::vector<Worker> m_workers;
+	bool m_pinned = false;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	uint64_t m_generation = 0;
+	uint32_t m_activeWorkers = 0;
+	bool m_stop = false;
+
+	const ItemFunction* m_function = nullptr;
+	bool m_allowStealing = true;
+};
\ No newline at end of file
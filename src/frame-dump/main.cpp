@@ -0,0 +1,55 @@
+#include "stdafx.h"
+
+// Attaches to a render started with -share and writes its newest display image as PPM:
+//   frame-dump Local\spheres frame.ppm [-timeout seconds]
+// The render is never blocked; a read that overlaps a publish is simply retried.
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		std::cerr << "usage: frame-dump <section name> <out.ppm> [-timeout seconds]\n";
+		return 2;
+	}
+
+	const std::string name = argv[1];
+	const std::string outputPath = argv[2];
+
+	double timeoutSeconds = 10.0;
+	if (argc >= 5 && std::string(argv[3]) == "-timeout")
+	{
+		timeoutSeconds = std::atof(argv[4]);
+	}
+
+	SharedFramebuffer shared;
+	if (!shared.Open(std::wstring(name.begin(), name.end())))
+	{
+		std::cerr << "no shared framebuffer named " << name << "\n";
+		return 1;
+	}
+
+	// Waits for the first image, and retries reads torn by a publish
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeoutSeconds);
+
+	std::vector<XMCOLOR> image;
+	uint64_t passCount = 0;
+
+	while (!shared.TryRead(image, passCount))
+	{
+		if (std::chrono::steady_clock::now() >= deadline)
+		{
+			std::cerr << "no complete image within " << timeoutSeconds << " s\n";
+			return 1;
+		}
+
+		Sleep(1);
+	}
+
+	if (!ImageIO::WritePpm(outputPath, image, shared.GetWidth(), shared.GetHeight()))
+	{
+		std::cerr << "could not write " << outputPath << "\n";
+		return 1;
+	}
+
+	std::cout << shared.GetWidth() << "x" << shared.GetHeight() << ", " << passCount << " passes\n";
+	return 0;
+}
\ No newline at end of file
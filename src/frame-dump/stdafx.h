@@ -0,0 +1,4 @@
+#pragma once
+
+#include "shared-framebuffer.h"
+#include "image-io.h"
\ No newline at end of file
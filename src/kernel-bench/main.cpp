@@ -0,0 +1,695 @@
+#include "stdafx.h"
+
+// Times hot kernels in isolation on fixed-seed inputs, so kernel-level changes can be checked without
+// rendering a frame:
+//   kernel-bench [-cpu N] [-filter text] [-reps R] [-out results.csv] [-baseline results.csv]
+// Everything runs on the calling thread; -cpu pins it to one logical processor. Each benchmark runs R
+// repetitions of a batch sized to take about k_batchMs and reports ns per operation as the mean and standard
+// deviation over the repetitions and the fastest repetition, the most stable figure for comparing builds.
+// -baseline compares each mean with the same benchmark in the CSV written by an earlier run with -out.
+namespace
+{
+	constexpr double k_batchMs = 20.0;
+	constexpr uint32_t k_inputCount = 4096;	// inputs are cycled through, a few hundred KB at most
+	constexpr uint32_t k_inputMask = k_inputCount - 1;
+	constexpr uint32_t k_imageWidth = 1280;	// camera of the default view at the default resolution
+	constexpr uint32_t k_imageHeight = 720;
+
+	struct Result
+	{
+		std::string name;
+		double meanNs;
+		double deviationNs;
+		double minNs;
+	};
+
+	struct Options
+	{
+		int cpu = -1;
+		std::string filter;
+		uint32_t repetitions = 15;
+		std::string outputPath;
+		std::string baselinePath;
+	};
+
+	// Stops the compiler from dropping kernels whose results are unused
+	volatile float g_sink;
+
+	class Bench
+	{
+	public:
+		explicit Bench(const Options& options) : m_options{ options } {}
+
+		// kernel(i) runs one call on input i and returns a value that depends on its result. A call counts as
+		// opsPerCall operations, e.g. the rays of a packet.
+		template <typename Kernel>
+		void Run(const std::string& name, Kernel&& kernel, uint32_t opsPerCall = 1)
+		{
+			if (name.find(m_options.filter) == std::string::npos)
+			{
+				return;
+			}
+
+			auto runBatch = [&kernel](uint64_t calls)
+			{
+				const auto start = std::chrono::steady_clock::now();
+
+				float sink = 0.f;
+				for (uint64_t i = 0; i < calls; ++i)
+				{
+					sink += kernel(static_cast<uint32_t>(i) & k_inputMask);
+				}
+
+				g_sink = sink;
+				return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			};
+
+			// Warms caches and branch predictors while finding the batch size
+			uint64_t calls = 64;
+			double ms = runBatch(calls);
+			while (ms < 0.1 * k_batchMs)
+			{
+				calls *= 4;
+				ms = runBatch(calls);
+			}
+
+			calls = std::max<uint64_t>(1, static_cast<uint64_t>(calls * k_batchMs / ms));
+
+			std::vector<double> nsPerOp(m_options.repetitions);
+			for (double& ns : nsPerOp)
+			{
+				ns = runBatch(calls) * 1e6 / (static_cast<double>(calls) * opsPerCall);
+			}
+
+			const double mean = std::accumulate(nsPerOp.cbegin(), nsPerOp.cend(), 0.0) / nsPerOp.size();
+			const double squares = std::accumulate(nsPerOp.cbegin(), nsPerOp.cend(), 0.0, [mean](double sum, double ns) { return sum + (ns - mean) * (ns - mean); });
+			const double deviation = nsPerOp.size() > 1 ? std::sqrt(squares / (nsPerOp.size() - 1)) : 0.0;
+
+			Result result{ name, mean, deviation, *std::min_element(nsPerOp.cbegin(), nsPerOp.cend()) };
+			Print(result);
+			m_results.push_back(std::move(result));
+		}
+
+		bool ReadBaseline(const std::string& path)
+		{
+			std::ifstream file(path);
+			std::string line;
+
+			if (!file || !std::getline(file, line))
+			{
+				return false;
+			}
+
+			while (std::getline(file, line))
+			{
+				std::istringstream fields(line);
+				std::string name, mean;
+				if (std::getline(fields, name, ',') && std::getline(fields, mean, ','))
+				{
+					m_baseline[name] = std::atof(mean.c_str());
+				}
+			}
+
+			return true;
+		}
+
+		bool WriteCsv(const std::string& path) const
+		{
+			std::ofstream file(path);
+			file << "kernel,mean ns,deviation ns,min ns\n";
+
+			for (const Result& result : m_results)
+			{
+				file << result.name << "," << result.meanNs << "," << result.deviationNs << "," << result.minNs << "\n";
+			}
+
+			return static_cast<bool>(file);
+		}
+
+	private:
+		void Print(const Result& result) const
+		{
+			char line[160];
+			std::snprintf(line, sizeof(line), "%-36s %10.2f ns +- %7.2f  min %10.2f", result.name.c_str(), result.meanNs, result.deviationNs, result.minNs);
+			std::cout << line;
+
+			if (const auto it = m_baseline.find(result.name); it != m_baseline.end() && it->second > 0.0)
+			{
+				std::snprintf(line, sizeof(line), "  %+6.1f%% vs baseline", 100.0 * (result.meanNs - it->second) / it->second);
+				std::cout << line;
+			}
+
+			std::cout << "\n";
+		}
+
+	private:
+		Options m_options;
+		std::vector<Result> m_results;
+		std::unordered_map<std::string, double> m_baseline;
+	};
+
+	// The clock-seeded generator Random::Philox replaced, kept here as the baseline for the comparison
+	uint64_t ClockXorshift()
+	{
+		static const auto startTime = std::chrono::high_resolution_clock::now();
+		uint64_t x = std::chrono::duration<uint64_t, std::nano>(std::chrono::high_resolution_clock::now() - startTime).count();
+		x ^= x >> 12;
+		x ^= x << 25;
+		x ^= x >> 27;
+
+		return x;
+	}
+
+	float Sum(const XMVECTOR& v)
+	{
+		return XMVectorGetX(XMVector3Dot(v, XM_One));
+	}
+
+	// Rays from a shell of radius 5 around a unit sphere at the origin, aimed inside it or past its silhouette
+	std::vector<Ray> MakeSphereRays(Random::Stream& random, bool hit)
+	{
+		std::vector<Ray> rays(k_inputCount);
+
+		for (Ray& ray : rays)
+		{
+			const XMFLOAT2 u{ random.NextFloat(), random.NextFloat() };
+			const XMFLOAT3 d = Sampler::SampleHemisphere(u);
+			const XMVECTOR origin = 5.f * XMVectorSet(d.x, d.y, random.NextFloat() < 0.5f ? d.z : -d.z, 0.f);
+
+			// Misses aim 1.5 off the center at right angles to the view, which passes at least 1.4 from it
+			const XMVECTOR jitter = XMVectorSet(random.NextFloat() - 0.5f, random.NextFloat() - 0.5f, random.NextFloat() - 0.5f, 0.f);
+			const XMVECTOR side = XMVector3Normalize(XMVector3Cross(origin, jitter));
+			const XMVECTOR target = hit ? jitter : 1.5f * side;
+
+			ray = Ray{ XMVectorSetW(origin, 1.f), XMVector3Normalize(target - origin) };
+		}
+
+		return rays;
+	}
+
+	// Spheres laid out like the default scene: the floor, a jittered grid of small spheres and three large ones
+	std::vector<Sphere> MakeSphereField(Random::Stream& random)
+	{
+		std::vector<Sphere> spheres;
+		spheres.emplace_back(XMVectorSet(0.f, -1000.f, 0.f, 0.f), 1000.f, 0);
+
+		for (int a = -11; a < 11; ++a)
+		{
+			for (int b = -11; b < 11; ++b)
+			{
+				spheres.emplace_back(XMVectorSet(a + 0.9f * random.NextFloat(), 0.2f, b + 0.9f * random.NextFloat(), 0.f), 0.2f, 0);
+			}
+		}
+
+		spheres.emplace_back(XMVectorSet(0.f, 1.f, 0.f, 0.f), 1.f, 0);
+		spheres.emplace_back(XMVectorSet(-4.f, 1.f, 0.f, 0.f), 1.f, 0);
+		spheres.emplace_back(XMVectorSet(4.f, 1.f, 0.f, 0.f), 1.f, 0);
+
+		return spheres;
+	}
+
+	// Distance to the closest sphere by testing every one, infinity for a miss
+	float IntersectAll(const std::vector<Sphere>& spheres, const Ray& ray)
+	{
+		float closest = std::numeric_limits<float>::infinity();
+		for (const Sphere& sphere : spheres)
+		{
+			Payload payload;
+			if (sphere.Intersect(ray, payload))
+			{
+				closest = std::min(closest, XMVectorGetX(payload.t));
+			}
+		}
+
+		return closest;
+	}
+
+	// Builds every BvhLayout with and without spatial splits over a scene-like sphere field, checks the closest hit
+	// of every ray against brute force, and times the build and the traversal of each
+	void RunBvhLayoutCheck(Bench& bench, Random::Stream& random, const std::vector<Ray>& primaryRays, const std::vector<Ray>& diffuseRays)
+	{
+		const std::vector<Sphere> spheres = MakeSphereField(random);
+
+		std::vector<Ray> rays = primaryRays;
+		rays.insert(rays.end(), diffuseRays.cbegin(), diffuseRays.cend());
+
+		std::vector<float> reference(rays.size());
+		std::transform(rays.cbegin(), rays.cend(), reference.begin(), [&spheres](const Ray& ray) { return IntersectAll(spheres, ray); });
+
+		const std::pair<BvhLayout, const char*> layouts[] = {
+			{ BvhLayout::Full, "Full" },
+			{ BvhLayout::Quantized16, "Quantized16" },
+			{ BvhLayout::Quantized8, "Quantized8" } };
+
+		for (const auto& [layout, layoutName] : layouts)
+		{
+			for (const bool spatialSplits : { false, true })
+			{
+				const std::string name = std::string(layoutName) + (spatialSplits ? " sbvh" : " sah");
+
+				BvhSettings settings;
+				settings.layout = layout;
+				settings.spatialSplits = spatialSplits;
+
+				Arena arena;
+				Bvh bvh;
+				const auto start = std::chrono::steady_clock::now();
+				bvh.Build(spheres, arena, settings);
+				const double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+				// A hit differs when it is a hit for only one of the two or lies at another distance
+				uint32_t mismatches = 0;
+				for (size_t i = 0; i < rays.size(); ++i)
+				{
+					Payload payload;
+					const float t = bvh.Intersect(rays[i], payload) ? XMVectorGetX(payload.t) : std::numeric_limits<float>::infinity();
+					if (t != reference[i] && !(std::abs(t - reference[i]) <= 1e-4f * std::max(1.f, reference[i])))
+					{
+						++mismatches;
+					}
+				}
+
+				char line[200];
+				std::snprintf(line, sizeof(line), "Bvh %-16s build %7.2f ms, %5u nodes, %5u references, %6zu KB, %u of %zu hits differ from brute force\n",
+					name.c_str(), buildMs, bvh.GetNodeCount(), bvh.GetReferenceCount(), bvh.GetMemoryUsage() >> 10, mismatches, rays.size());
+				std::cout << line;
+
+				bench.Run("Bvh::Intersect primary " + name, [&](uint32_t i)
+				{
+					Payload payload;
+					return bvh.Intersect(primaryRays[i], payload) ? XMVectorGetX(payload.t) : 0.f;
+				});
+
+				if (!diffuseRays.empty())
+				{
+					bench.Run("Bvh::Intersect diffuse " + name, [&](uint32_t i)
+					{
+						Payload payload;
+						return bvh.Intersect(diffuseRays[i], payload) ? XMVectorGetX(payload.t) : 0.f;
+					});
+				}
+			}
+		}
+	}
+
+	// Random123 known-answer vector for Philox4x32-10 with a zero counter and key. Timings of a generator that
+	// computes something else mean nothing, so a mismatch fails the run.
+	bool RunPhiloxCheck()
+	{
+		constexpr std::array<uint32_t, 4> k_expected = { 0x6627e8d5u, 0xe169c58du, 0xbc57ac4cu, 0x9b00dbd8u };
+		const std::array<uint32_t, 4> block = Random::Philox({ 0u, 0u, 0u, 0u }, { 0u, 0u });
+
+		char line[160];
+		std::snprintf(line, sizeof(line), "Random::Philox known answer: %08x %08x %08x %08x %s\n",
+			block[0], block[1], block[2], block[3], block == k_expected ? "ok" : "MISMATCH");
+		std::cout << line;
+
+		return block == k_expected;
+	}
+
+	void RunBenchmarks(Bench& bench)
+	{
+		Random::Stream random(AppSettings::k_seed);
+
+		// Sampling
+		bench.Run("Random::HaltonSample", [](uint32_t i) { return Random::HaltonSample(i, 3); });
+		bench.Run("Random::HaltonSample2D", [](uint32_t i) { return Random::HaltonSample2D(i, 2, 3).x; });
+		bench.Run("Random::HaltonSampleRing", [](uint32_t i) { return Random::HaltonSampleRing(i, 2).x; });
+		bench.Run("Random::HaltonSampleDisk", [](uint32_t i) { return Random::HaltonSampleDisk(i, 2, 3).x; });
+		bench.Run("Random::HaltonSampleHemisphere", [](uint32_t i) { return Random::HaltonSampleHemisphere(i, 2, 3).z; });
+		bench.Run("Sampler::Get2D", [](uint32_t i) { return Sampler::Get2D(i, 0x1234567u, 3).x; });
+
+		// Random floats from the keyed generator and from the ones it replaced: the clock-based Xorshift and the
+		// scene's ranlux24_base with a std distribution
+		Random::Stream stream(AppSettings::k_seed);
+		std::ranlux24_base ranlux(AppSettings::k_seed);
+		std::uniform_real_distribution<float> uniformDist(0.f, 1.f);
+
+		bench.Run("Random::Philox per word", [](uint32_t i)
+		{
+			const std::array<uint32_t, 4> block = Random::Philox({ i, 0u, 0u, 0u }, { AppSettings::k_seed, 0u });
+			return static_cast<float>(block[0] ^ block[1] ^ block[2] ^ block[3]);
+		}, 4);
+		bench.Run("Random::Uniform", [](uint32_t i) { return Random::Uniform(AppSettings::k_seed, i, 7, 3); });
+		bench.Run("Random::Stream::NextFloat", [&stream](uint32_t) { return stream.NextFloat(); });
+		bench.Run("Xorshift (clock, old)", [](uint32_t) { return static_cast<float>(ClockXorshift() >> 40); });
+		bench.Run("std::ranlux24_base (old)", [&](uint32_t) { return uniformDist(ranlux); });
+
+		// Sphere
+		const Sphere sphere(XMVectorZero(), 1.f, 0);
+		const std::vector<Ray> hitRays = MakeSphereRays(random, true);
+		const std::vector<Ray> missRays = MakeSphereRays(random, false);
+
+		bench.Run("Sphere::Intersect hit", [&](uint32_t i)
+		{
+			Payload payload;
+			return sphere.Intersect(hitRays[i], payload) ? XMVectorGetX(payload.t) : 0.f;
+		});
+
+		bench.Run("Sphere::Intersect miss", [&](uint32_t i)
+		{
+			Payload payload;
+			return sphere.Intersect(missRays[i], payload) ? XMVectorGetX(payload.t) : 0.f;
+		});
+
+		// Camera of the default view
+		const ViewDesc view;
+		const XMVECTOR cameraOrigin = XMVectorSetW(XMLoadFloat3(&view.origin), 1.f);
+		const XMVECTOR cameraLookAt = XMVectorSetW(XMLoadFloat3(&view.lookAt), 1.f);
+		const Camera camera(cameraOrigin, cameraLookAt, view.verticalFov, static_cast<float>(k_imageWidth) / k_imageHeight,
+			XMVectorGetX(XMVector3Length(cameraOrigin - cameraLookAt)), AppSettings::k_aperture);
+
+		std::vector<XMFLOAT2> uvs(k_inputCount);
+		std::vector<XMFLOAT2> lensSamples(k_inputCount);
+		for (uint32_t i = 0; i < k_inputCount; ++i)
+		{
+			uvs[i] = XMFLOAT2{ random.NextFloat(), random.NextFloat() };
+			lensSamples[i] = Sampler::SampleDisk(XMFLOAT2{ random.NextFloat(), random.NextFloat() });
+		}
+
+		bench.Run("Camera::GetRay", [&](uint32_t i) { return XMVectorGetX(camera.GetRay(uvs[i], lensSamples[i]).direction); });
+
+		// Packets of 8x8 neighbouring pixels, as traced by the renderer
+		constexpr uint32_t k_packetCount = 64;
+		std::vector<RayPacket> packets(k_packetCount);
+		for (RayPacket& packet : packets)
+		{
+			const float left = std::floor(random.NextFloat() * (k_imageWidth - RayPacket::k_size));
+			const float top = std::floor(random.NextFloat() * (k_imageHeight - RayPacket::k_size));
+
+			std::array<XMFLOAT2, RayPacket::k_maxRays> packetUvs, packetLens;
+			for (uint32_t i = 0; i < RayPacket::k_maxRays; ++i)
+			{
+				packetUvs[i].x = (left + i % RayPacket::k_size + random.NextFloat()) / k_imageWidth;
+				packetUvs[i].y = (top + i / RayPacket::k_size + random.NextFloat()) / k_imageHeight;
+				packetLens[i] = Sampler::SampleDisk(XMFLOAT2{ random.NextFloat(), random.NextFloat() });
+			}
+
+			camera.GetRays(packetUvs.data(), packetLens.data(), RayPacket::k_maxRays, packet);
+		}
+
+		RayPacket scratch;
+		bench.Run("Camera::GetRays per ray", [&](uint32_t i)
+		{
+			const uint32_t first = i / RayPacket::k_maxRays * RayPacket::k_maxRays;
+			camera.GetRays(&uvs[first], &lensSamples[first], RayPacket::k_maxRays, scratch);
+			return scratch.directionX[0];
+		}, RayPacket::k_maxRays);
+
+		// Default scene, through the BVH copy GetBvh hands the main thread
+		WorkerPool workers;
+		const SpheresScene scene(AppSettings::k_seed, workers);
+		const Bvh& bvh = scene.GetBvh();
+
+		std::vector<Ray> primaryRays(k_inputCount);
+		std::vector<Payload> primaryHits;
+		std::vector<Ray> primaryHitRays;
+		for (uint32_t i = 0; i < k_inputCount; ++i)
+		{
+			primaryRays[i] = camera.GetRay(uvs[i], lensSamples[i]);
+
+			Payload payload;
+			if (bvh.Intersect(primaryRays[i], payload))
+			{
+				primaryHits.push_back(payload);
+				primaryHitRays.push_back(primaryRays[i]);
+			}
+		}
+
+		// The kernels below cycle through the hits, so a camera that sees nothing leaves them without inputs
+		if (primaryHits.empty())
+		{
+			std::cout << "no primary ray hits the scene, skipping the diffuse and shading benchmarks\n";
+		}
+
+		// Diffuse bounces off the primary hits, the incoherent rays that dominate a path
+		std::vector<Ray> diffuseRays(primaryHits.empty() ? 0 : k_inputCount);
+		for (size_t i = 0; i < diffuseRays.size(); ++i)
+		{
+			const Payload& hit = primaryHits[i % primaryHits.size()];
+			const XMFLOAT3 d = Sampler::SampleHemisphere(XMFLOAT2{ random.NextFloat(), random.NextFloat() });
+
+			XMFLOAT3 n;
+			XMStoreFloat3(&n, hit.normal);
+			const XMVECTOR up = std::abs(n.x) < 0.5f ? XMVECTORF32{ 1.f, 0.f, 0.f } : XMVECTORF32{ 0.f, 1.f, 0.f };
+			const XMVECTOR b1 = XMVector3Normalize(XMVector3Cross(up, hit.normal));
+			const XMVECTOR b2 = XMVector3Cross(hit.normal, b1);
+
+			diffuseRays[i] = Ray{ hit.pos, XMVector3Normalize(d.x * b1 + d.y * b2 + d.z * hit.normal) };
+		}
+
+		// Node visits per ray, to read the traversal timings as a cost per node
+		auto printNodesPerRay = [&bvh](const char* name, const std::vector<Ray>& rays)
+		{
+			Bvh::TraversalStats stats;
+			for (const Ray& ray : rays)
+			{
+				Payload payload;
+				bvh.Intersect(ray, payload, &stats);
+			}
+
+			std::cout << "  " << name << ": " << static_cast<double>(stats.nodes) / rays.size() << " nodes, " << static_cast<double>(stats.primitives) / rays.size() << " spheres per ray\n";
+		};
+
+		bench.Run("Bvh::Intersect primary", [&](uint32_t i)
+		{
+			Payload payload;
+			return bvh.Intersect(primaryRays[i], payload) ? XMVectorGetX(payload.t) : 0.f;
+		});
+		printNodesPerRay("primary", primaryRays);
+
+		if (!diffuseRays.empty())
+		{
+			bench.Run("Bvh::Intersect diffuse", [&](uint32_t i)
+			{
+				Payload payload;
+				return bvh.Intersect(diffuseRays[i], payload) ? XMVectorGetX(payload.t) : 0.f;
+			});
+			printNodesPerRay("diffuse", diffuseRays);
+		}
+
+		RunBvhLayoutCheck(bench, random, primaryRays, diffuseRays);
+
+		std::array<std::optional<Payload>, RayPacket::k_maxRays> packetHits;
+		bench.Run("Bvh::IntersectPacket per ray", [&](uint32_t i)
+		{
+			bvh.IntersectPacket(packets[i % k_packetCount], packetHits.data());
+			return packetHits[0] ? XMVectorGetX(packetHits[0]->t) : 0.f;
+		}, RayPacket::k_maxRays);
+
+		// Materials on the unit sphere
+		MaterialTable materials;
+		const uint32_t opaque = materials.Add(Material::DielectricOpaque(Texture::Const(XMCOLOR{ 0.5f, 0.4f, 0.3f, 1.f }), 16.f));
+		const uint32_t metal = materials.Add(Material::Metal(Texture::Const(XMCOLOR{ 0.7f, 0.6f, 0.5f, 1.f }), 0.f));
+		const uint32_t transparent = materials.Add(Material::DielectricTransparent(16.f, 1.5f));
+
+		std::vector<Payload> sphereHits(k_inputCount);
+		for (uint32_t i = 0; i < k_inputCount; ++i)
+		{
+			sphere.Intersect(hitRays[i], sphereHits[i]);
+		}
+
+		auto runScatter = [&](const std::string& name, uint32_t materialId)
+		{
+			bench.Run("MaterialTable::Scatter " + name, [&, materialId](uint32_t i)
+			{
+				SampleContext sampler{ 0x1234567u, i, 0 };
+				XMVECTOR attenuation;
+				Ray scattered;
+				float pdf;
+				return materials.Scatter<SceneFeature::All>(materialId, hitRays[i], sphereHits[i], sampler, attenuation, scattered, pdf) ? XMVectorGetX(scattered.direction) : 0.f;
+			});
+		};
+
+		runScatter("DielectricOpaque", opaque);
+		runScatter("Metal", metal);
+		runScatter("DielectricTransparent", transparent);
+
+		// The scene's sun on its primary hits, shadow ray included
+		const auto sunIt = std::find_if(scene.GetLights().cbegin(), scene.GetLights().cend(), [](const std::unique_ptr<Light>& light)
+		{
+			return dynamic_cast<const DirectionalLight*>(light.get()) != nullptr;
+		});
+		const Light& sun = **sunIt;
+		if (!primaryHits.empty())
+		{
+			bench.Run("DirectionalLight::Shade", [&](uint32_t i)
+			{
+				const uint32_t hit = i % static_cast<uint32_t>(primaryHits.size());
+				const Payload& payload = primaryHits[hit];
+				SampleContext sampler{ 0x1234567u, i, 0 };
+				return Sum(sun.Shade(scene.GetMaterials().Get(payload.materialId), primaryHitRays[hit], payload, sampler, cameraOrigin, 1.f));
+			});
+		}
+
+		// Display transform of one tile row's worth of pixels at a time, over an HDR range like the renderer's
+		constexpr uint32_t k_spanLength = 256;
+		const Resolver resolver;
+		std::vector<float> r(k_inputCount + k_spanLength), g(r.size()), b(r.size());
+		for (size_t i = 0; i < r.size(); ++i)
+		{
+			r[i] = 4.f * random.NextFloat() * random.NextFloat();
+			g[i] = 4.f * random.NextFloat() * random.NextFloat();
+			b[i] = 4.f * random.NextFloat() * random.NextFloat();
+		}
+
+		std::vector<XMCOLOR> ldr(k_spanLength);
+		bench.Run("Resolver::ResolveSpan per pixel", [&](uint32_t i)
+		{
+			resolver.ResolveSpan(&r[i], &g[i], &b[i], ldr.data(), k_spanLength);
+			return static_cast<float>(ldr[0].c);
+		}, k_spanLength);
+	}
+
+	// Denoiser on a synthetic frame of the default size: a vertical step in color and albedo, every pixel one noisy
+	// sample with a mean of the clean value, and a flat surface facing the camera. Reports the RMSE against the
+	// clean image before and after filtering, and the filter time per frame. Unlike the kernels above the filter
+	// runs its rows in parallel, so the time depends on the core count and is not comparable to them.
+	void RunDenoiserCheck(uint32_t repetitions)
+	{
+		const XMVECTORF32 k_darkColor{ 0.2f, 0.2f, 0.2f, 0.f };
+		const XMVECTORF32 k_brightColor{ 0.8f, 0.6f, 0.4f, 0.f };
+		const XMVECTORF32 k_darkAlbedo{ 0.3f, 0.3f, 0.3f, 0.f };
+		const XMVECTORF32 k_brightAlbedo{ 0.9f, 0.7f, 0.5f, 0.f };
+
+		Random::Stream random(AppSettings::k_seed);
+
+		Framebuffer noisy;
+		noisy.Resize(k_imageWidth, k_imageHeight, true);
+		noisy.Clear();
+
+		auto accumulator = std::make_unique<Framebuffer::TileAccumulator>();
+		for (uint32_t tileIndex = 0; tileIndex < noisy.GetTileCount(); ++tileIndex)
+		{
+			*accumulator = {};
+			accumulator->sampleCount = 1;
+
+			const PixelRect rect = noisy.GetTileRect(tileIndex);
+			for (uint32_t y = rect.top; y < rect.bottom; ++y)
+			{
+				for (uint32_t x = rect.left; x < rect.right; ++x)
+				{
+					const bool bright = x >= k_imageWidth / 2;
+					const XMVECTOR clean = bright ? k_brightColor : k_darkColor;
+					const XMVECTOR u = XMVectorSet(random.NextFloat(), random.NextFloat(), random.NextFloat(), 0.f);
+					const uint32_t localIndex = (y - rect.top) * Framebuffer::k_tileSize + (x - rect.left);
+
+					accumulator->Add(localIndex, 2.f * u * clean);
+					accumulator->AddAovs(localIndex, SurfaceAovs{ bright ? k_brightAlbedo : k_darkAlbedo, XMVectorSet(0.f, 0.f, -1.f, 0.f), 10.f });
+				}
+			}
+
+			noisy.Flush(tileIndex, *accumulator);
+		}
+
+		auto rmse = [&](const Framebuffer& image)
+		{
+			double sum = 0.0;
+			for (uint32_t y = 0; y < k_imageHeight; ++y)
+			{
+				for (uint32_t x = 0; x < k_imageWidth; ++x)
+				{
+					const XMVECTOR clean = x >= k_imageWidth / 2 ? k_brightColor : k_darkColor;
+					const XMVECTOR error = image.GetPixel(x, y) - clean;
+					sum += XMVectorGetX(XMVector3Dot(error, error));
+				}
+			}
+
+			return std::sqrt(sum / (3.0 * k_imageWidth * k_imageHeight));
+		};
+
+		Denoiser denoiser{ DenoiserSettings{} };
+		Framebuffer denoised;
+		denoiser.Denoise(noisy, denoised);
+
+		std::vector<double> ms(repetitions);
+		for (double& frameMs : ms)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			denoiser.Denoise(noisy, denoised);
+			frameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		char line[160];
+		std::snprintf(line, sizeof(line), "Denoiser %ux%u: RMSE %.4f -> %.4f, %.2f ms per frame (min %.2f)\n", k_imageWidth, k_imageHeight,
+			rmse(noisy), rmse(denoised), std::accumulate(ms.cbegin(), ms.cend(), 0.0) / ms.size(), *std::min_element(ms.cbegin(), ms.cend()));
+		std::cout << line;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+
+		if (arg == "-cpu" && hasValue)
+		{
+			options.cpu = std::atoi(argv[++i]);
+		}
+		else if (arg == "-filter" && hasValue)
+		{
+			options.filter = argv[++i];
+		}
+		else if (arg == "-reps" && hasValue)
+		{
+			options.repetitions = std::max(2, std::atoi(argv[++i]));
+		}
+		else if (arg == "-out" && hasValue)
+		{
+			options.outputPath = argv[++i];
+		}
+		else if (arg == "-baseline" && hasValue)
+		{
+			options.baselinePath = argv[++i];
+		}
+		else
+		{
+			std::cerr << "usage: kernel-bench [-cpu N] [-filter text] [-reps R] [-out results.csv] [-baseline results.csv]\n";
+			return 2;
+		}
+	}
+
+	// Pinned and ahead of normal threads, so neither migrations nor other processes disturb the timings
+	if (options.cpu >= 0)
+	{
+		if (options.cpu >= 64 || !SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR{ 1 } << options.cpu))
+		{
+			std::cerr << "cannot pin to logical processor " << options.cpu << "\n";
+			return 1;
+		}
+
+		SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+	}
+
+	Bench bench(options);
+
+	if (!options.baselinePath.empty() && !bench.ReadBaseline(options.baselinePath))
+	{
+		std::cerr << "could not read " << options.baselinePath << "\n";
+		return 1;
+	}
+
+	if (!RunPhiloxCheck())
+	{
+		return 1;
+	}
+
+	RunBenchmarks(bench);
+
+	if (std::string("Denoiser").find(options.filter) != std::string::npos)
+	{
+		RunDenoiserCheck(options.repetitions);
+	}
+
+	if (!options.outputPath.empty() && !bench.WriteCsv(options.outputPath))
+	{
+		std::cerr << "could not write " << options.outputPath << "\n";
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,5 @@
+#pragma once
+
+#include <cstdio>
+
+#include "spheres-scene.h"
\ No newline at end of file
@@ -1,10 +1,52 @@
 #include "spheres-app.h"
+#include "render-server.h"
 
 #pragma comment(lib, "d2d1")
 
+namespace
+{
+	// spheres.exe is a GUI subsystem program, so it has no console of its own. Headless runs and render servers
+	// report errors on the console they were started from; without one the messages are dropped. cmd does not
+	// wait for GUI programs, so scripts that check the exit code start them with "start /wait".
+	void AttachParentConsole()
+	{
+		if (!AttachConsole(ATTACH_PARENT_PROCESS))
+		{
+			return;
+		}
+
+		FILE* stream;
+		freopen_s(&stream, "CONOUT$", "w", stdout);
+		freopen_s(&stream, "CONOUT$", "w", stderr);
+		std::cout.clear();
+		std::cerr.clear();
+		std::wcout.clear();
+		std::wcerr.clear();
+	}
+}
+
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nShowCmd)
 {
-	SpheresApp app;
+	const RenderOptions options = RenderOptions::Parse(lpCmdLine ? lpCmdLine : "");
+
+	if (!options.serveName.empty())
+	{
+		AttachParentConsole();
+
+		RenderServer server(options.serveName);
+		return server.Run();
+	}
+
+	SpheresApp app(options);
+
+	if (app.IsHeadless())
+	{
+		AttachParentConsole();
+
+		app.InitializeHeadless();
+		return app.RunHeadless();
+	}
+
 	app.Initialize(hInstance, nShowCmd);
 	return app.Run();
-}
+}
\ No newline at end of file
@@ -0,0 +1,365 @@
+#include "render-server.h"
+
+RenderServer::RenderServer(const std::wstring& name) :
+	m_pipeName{ L"\\\\.\\pipe\\" + name },
+	m_scenes{ AppSettings::k_sceneCacheSize, m_workers }
+{
+}
+
+namespace
+{
+	// Waits for an overlapped operation, so each thread sees its own I/O on a pipe as blocking
+	bool Complete(HANDLE pipe, OVERLAPPED& overlapped, BOOL completed, DWORD& outBytes)
+	{
+		outBytes = 0;
+
+		if (!completed && GetLastError() != ERROR_IO_PENDING)
+		{
+			return false;
+		}
+
+		return GetOverlappedResult(pipe, &overlapped, &outBytes, TRUE) != FALSE;
+	}
+}
+
+RenderServer::Connection::Connection(const HANDLE connectedPipe) :
+	pipe{ connectedPipe },
+	readEvent{ CreateEventW(nullptr, TRUE, FALSE, nullptr) },
+	writeEvent{ CreateEventW(nullptr, TRUE, FALSE, nullptr) }
+{
+}
+
+RenderServer::Connection::~Connection()
+{
+	CloseHandle(pipe);
+	CloseHandle(readEvent);
+	CloseHandle(writeEvent);
+}
+
+bool RenderServer::Connection::Write(const std::string& bytes)
+{
+	std::lock_guard<std::mutex> lock(writeMutex);
+
+	// Blocks while the client is not reading, which is how a slow client throttles its own jobs
+	for (size_t written = 0; open && written < bytes.size();)
+	{
+		DWORD chunk;
+		const auto size = static_cast<DWORD>(std::min<size_t>(bytes.size() - written, k_pipeBufferBytes));
+
+		OVERLAPPED overlapped{};
+		overlapped.hEvent = writeEvent;
+
+		if (!Complete(pipe, overlapped, WriteFile(pipe, bytes.data() + written, size, nullptr, &overlapped), chunk))
+		{
+			open = false;
+		}
+
+		written += chunk;
+	}
+
+	return open;
+}
+
+bool RenderServer::Connection::Read(char* buffer, const DWORD size, DWORD& outRead)
+{
+	OVERLAPPED overlapped{};
+	overlapped.hEvent = readEvent;
+
+	return Complete(pipe, overlapped, ReadFile(pipe, buffer, size, nullptr, &overlapped), outRead);
+}
+
+int RenderServer::Run()
+{
+	m_acceptThread = std::thread(&RenderServer::AcceptMain, this);
+
+	for (;;)
+	{
+		Job* job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_jobsChanged.wait(lock, [this]() { return m_quit || !m_jobs.empty(); });
+
+			if (m_quit)
+			{
+				break;
+			}
+
+			// Picked again after every pass, so a new job of higher priority preempts the running one
+			job = std::max_element(m_jobs.cbegin(), m_jobs.cend(), [](const std::unique_ptr<Job>& a, const std::unique_ptr<Job>& b)
+			{
+				return a->options.priority < b->options.priority || (a->options.priority == b->options.priority && a->id > b->id);
+			})->get();
+		}
+
+		// The pass runs unlocked; readers only append, so the job stays where it is
+		if (!RunPass(*job))
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_jobs.erase(std::find_if(m_jobs.begin(), m_jobs.end(), [job](const std::unique_ptr<Job>& entry) { return entry.get() == job; }));
+		}
+	}
+
+	StopClients();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_jobs.clear();
+	return m_exitCode;
+}
+
+bool RenderServer::RunPass(Job& job)
+{
+	const std::string id = std::to_string(job.id);
+
+	if (!job.client->open)
+	{
+		return false;
+	}
+
+	if (!job.app)
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		const uint64_t misses = m_scenes.GetStats().misses;
+		std::shared_ptr<const SpheresScene> scene = m_scenes.Get(job.options.sceneSeed, job.options.lighting, job.options.texturePath);
+		const double sceneMs = m_scenes.GetStats().misses != misses ? scene->GetBuildMs() : 0.0;
+
+		job.app = std::make_unique<SpheresApp>(job.options, m_workers, std::move(scene));
+		job.app->InitializeHeadless();
+
+		const double startupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (!job.client->Write("started " + id + " " + std::to_string(sceneMs) + " " + std::to_string(startupMs) + "\n"))
+		{
+			return false;
+		}
+
+		job.lastProgress = start;
+	}
+
+	if (!job.app->RenderJobPass())
+	{
+		FinishJob(job);
+		return false;
+	}
+
+	const auto now = std::chrono::steady_clock::now();
+	if (now - job.lastProgress < std::chrono::milliseconds(k_progressIntervalMs))
+	{
+		return true;
+	}
+
+	job.lastProgress = now;
+	return job.client->Write("progress " + id + " " + std::to_string(job.app->GetSampleCount()) + " " + std::to_string(job.app->GetRenderSeconds()) + "\n");
+}
+
+void RenderServer::FinishJob(Job& job)
+{
+	const SpheresApp& app = *job.app;
+	const std::string id = std::to_string(job.id);
+
+	if (!app.WriteOutputs())
+	{
+		job.client->Write("error " + id + " could not write an output image\n");
+		return;
+	}
+
+	for (uint32_t view = 0; view < app.GetViewCount(); ++view)
+	{
+		if (!app.GetOutputPath(view).empty())
+		{
+			continue;
+		}
+
+		const Framebuffer& image = app.GetImage(view);
+		std::ostringstream pfm(std::ios::out | std::ios::binary);
+		ImageIO::WritePfm(pfm, SpheresApp::GetTexels(image), image.GetWidth(), image.GetHeight());
+
+		const std::string bytes = pfm.str();
+		if (!job.client->Write("image " + id + " " + std::to_string(view) + " " + std::to_string(bytes.size()) + "\n" + bytes))
+		{
+			return;
+		}
+	}
+
+	job.client->Write("done " + id + " " + std::to_string(app.GetSampleCount()) + " " + std::to_string(app.GetRenderSeconds()) + "\n");
+}
+
+void RenderServer::AcceptMain()
+{
+	const HANDLE connectEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+	for (;;)
+	{
+		// One pipe instance per client; the next one is created as soon as a client connected
+		const HANDLE pipe = CreateNamedPipeW(m_pipeName.c_str(), PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT,
+			PIPE_UNLIMITED_INSTANCES, k_pipeBufferBytes, k_pipeBufferBytes, 0, nullptr);
+
+		if (pipe == INVALID_HANDLE_VALUE)
+		{
+			// E.g. another server owns the name
+			RequestQuit(1);
+			break;
+		}
+
+		OVERLAPPED overlapped{};
+		overlapped.hEvent = connectEvent;
+
+		DWORD unused;
+		bool connected = ConnectNamedPipe(pipe, &overlapped) != FALSE;
+		if (!connected)
+		{
+			// A client may have connected between creating the pipe and this call
+			const DWORD error = GetLastError();
+			connected = error == ERROR_PIPE_CONNECTED || (error == ERROR_IO_PENDING && GetOverlappedResult(pipe, &overlapped, &unused, TRUE));
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (m_quit || !connected)
+		{
+			CloseHandle(pipe);
+
+			if (m_quit)
+			{
+				break;
+			}
+
+			continue;
+		}
+
+		// Registered under the lock, so the reader finds its entry when it leaves
+		auto connection = std::make_shared<Connection>(pipe);
+		Connection* key = connection.get();
+		m_readers.emplace(key, std::thread(&RenderServer::ReadMain, this, std::move(connection)));
+	}
+
+	CloseHandle(connectEvent);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_acceptDone = true;
+}
+
+void RenderServer::ReadMain(std::shared_ptr<Connection> connection)
+{
+	std::array<char, 4096> buffer;
+	std::string pending;
+	DWORD read = 0;
+
+	while (!m_quit && connection->Read(buffer.data(), static_cast<DWORD>(buffer.size()), read) && read > 0)
+	{
+		pending.append(buffer.data(), read);
+
+		for (size_t end = pending.find('\n'); end != std::string::npos; end = pending.find('\n'))
+		{
+			std::string line = pending.substr(0, end);
+			pending.erase(0, end + 1);
+
+			if (!line.empty() && line.back() == '\r')
+			{
+				line.pop_back();
+			}
+
+			if (line == "quit")
+			{
+				RequestQuit(0);
+			}
+			else if (line.find_first_not_of(" \t") != std::string::npos)
+			{
+				Submit(line, connection);
+			}
+		}
+	}
+
+	// The client is gone, so the scheduler drops its jobs without waiting for a write to fail
+	connection->open = false;
+
+	// Nobody joins a reader, so a long-running server keeps no thread per past client. Past this point the
+	// thread touches nothing of the server.
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const auto it = m_readers.find(connection.get());
+	it->second.detach();
+	m_readers.erase(it);
+}
+
+void RenderServer::Submit(const std::string& line, const std::shared_ptr<Connection>& client)
+{
+	auto job = std::make_unique<Job>();
+	job->options = RenderOptions::Parse(line);
+	job->client = client;
+
+	// Jobs render into memory only
+	job->options.shareName.clear();
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		job->id = m_nextJobId++;
+	}
+
+	const std::string id = std::to_string(job->id);
+
+	if (job->options.sampleLimit == 0 && job->options.timeLimit <= 0.0)
+	{
+		client->Write("error " + id + " needs a sample or time limit\n");
+		return;
+	}
+
+	// Acknowledged before the scheduler can see the job, so replies arrive in order
+	if (!client->Write("accepted " + id + "\n"))
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(std::move(job));
+	}
+
+	m_jobsChanged.notify_one();
+}
+
+void RenderServer::RequestQuit(const int exitCode)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_exitCode = std::max(m_exitCode, exitCode);
+		m_quit = true;
+	}
+
+	m_jobsChanged.notify_all();
+}
+
+void RenderServer::StopClients()
+{
+	// The accept thread wakes up when a client connects, so connect once more; readers wake up when their read is
+	// cancelled and leave on their own. Either may be just about to block, so this repeats until all are gone.
+	for (;;)
+	{
+		bool acceptDone;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			acceptDone = m_acceptDone;
+
+			if (acceptDone && m_readers.empty())
+			{
+				break;
+			}
+
+			for (const auto& [connection, reader] : m_readers)
+			{
+				CancelIoEx(connection->pipe, nullptr);
+			}
+		}
+
+		if (!acceptDone)
+		{
+			const HANDLE self = CreateFileW(m_pipeName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+			if (self != INVALID_HANDLE_VALUE)
+			{
+				CloseHandle(self);
+			}
+		}
+
+		Sleep(1);
+	}
+
+	m_acceptThread.join();
+}
\ No newline at end of file
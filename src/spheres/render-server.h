@@ -0,0 +1,89 @@
+#pragma once
+
+#include "spheres-app.h"
+#include "spheres-scene.h"
+
+// Long-running renderer for many small jobs against a few scenes. Clients connect to a named pipe, the Win32
+// counterpart of a local socket, and send one job per line in the command line syntax of RenderOptions::Parse,
+// e.g. "-scene 3 -views views.txt -crop 0 0 256 256 -spp 64 -time 5 -priority 1". Scenes come from a SceneCache,
+// so a job against a recently used scene skips the scene build and BVH construction, and all jobs trace on the
+// server's one WorkerPool.
+//
+// The scheduler runs one pass at a time of the highest-priority job, the oldest among equals, so a job of higher
+// priority takes over the workers at the next pass boundary and the preempted job resumes after it. Replies stream
+// back on the connection that submitted the job:
+//   accepted <job>
+//   started <job> <scene build ms, 0 when cached> <startup ms>
+//   progress <job> <spp> <render seconds>			at most every k_progressIntervalMs
+//   image <job> <view> <bytes>\n<PFM data>			views without an output path, once the job is done
+//   done <job> <spp> <render seconds>				or: error <job> <reason>
+// Jobs of a client that disconnected are dropped. A line "quit" stops the server after the running pass.
+class RenderServer
+{
+public:
+	// Listens on \\.\pipe\<name>
+	explicit RenderServer(const std::wstring& name);
+
+	RenderServer(const RenderServer&) = delete;
+	RenderServer& operator=(const RenderServer&) = delete;
+
+	// Schedules jobs until a client sends quit. Returns the process exit code.
+	int Run();
+
+private:
+	// One client. Jobs keep their client, so the pipe stays open until its last reply is written. The pipe is
+	// overlapped: with synchronous I/O a write would wait behind the reader's pending read until the client sends
+	// another line, and stall the scheduler with it.
+	struct Connection
+	{
+		HANDLE pipe = INVALID_HANDLE_VALUE;
+		HANDLE readEvent;
+		HANDLE writeEvent;
+		std::mutex writeMutex;
+		std::atomic<bool> open{ true };	// false after a failed write or once the reader saw the client leave
+
+		explicit Connection(HANDLE connectedPipe);
+		~Connection();
+		bool Write(const std::string& bytes);
+		// Reader thread only. False once the client is gone or the read was cancelled.
+		bool Read(char* buffer, DWORD size, DWORD& outRead);
+	};
+
+	struct Job
+	{
+		uint64_t id;
+		RenderOptions options;
+		std::shared_ptr<Connection> client;
+		std::unique_ptr<SpheresApp> app;	// created when the job first runs
+		std::chrono::steady_clock::time_point lastProgress;
+	};
+
+	void AcceptMain();
+	void ReadMain(std::shared_ptr<Connection> connection);
+	void Submit(const std::string& line, const std::shared_ptr<Connection>& client);
+	void RequestQuit(int exitCode);
+
+	// Scheduler thread. Returns false once the job is finished or its client is gone; a job whose client left
+	// is dropped before it builds a scene or runs another pass.
+	bool RunPass(Job& job);
+	void FinishJob(Job& job);
+	void StopClients();
+
+	static constexpr DWORD k_pipeBufferBytes = 1 << 16;
+	static constexpr int k_progressIntervalMs = 500;
+
+private:
+	std::wstring m_pipeName;
+	WorkerPool m_workers;
+	SceneCache m_scenes;	// scheduler thread only
+	std::thread m_acceptThread;
+
+	std::mutex m_mutex;		// guards everything below
+	std::condition_variable m_jobsChanged;
+	std::vector<std::unique_ptr<Job>> m_jobs;	// removed only by the scheduler
+	std::unordered_map<Connection*, std::thread> m_readers;	// one per connected client, removed when it leaves
+	uint64_t m_nextJobId = 1;
+	bool m_acceptDone = false;
+	std::atomic<bool> m_quit{ false };
+	int m_exitCode = 0;
+};
\ No newline at end of file
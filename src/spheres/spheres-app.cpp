@@ -1,231 +1,776 @@
 #include "spheres-app.h"
+#include "spheres-scene.h"
 #include <sstream>
 
-void SpheresApp::OnInitialize(HWND hWnd)
+namespace
 {
-	InitCamera();
-	InitScene();
+	// Comma separated, e.g. 1,2,5
+	template <typename T>
+	std::vector<T> ParseList(const std::string& text)
+	{
+		std::vector<T> values;
+		std::istringstream items(text);
+		std::string item;
+
+		while (std::getline(items, item, ','))
+		{
+			std::istringstream value(item);
+			T parsed;
+			if (value >> parsed)
+			{
+				values.push_back(parsed);
+			}
+		}
+
+		return values;
+	}
+
+	// One view per line: origin x y z, look-at x y z, vertical FOV in degrees, output path. '#' starts a comment.
+	std::vector<ViewDesc> ReadViews(const std::string& path)
+	{
+		std::vector<ViewDesc> views;
+
+		std::ifstream file(path);
+		std::string line;
+
+		while (std::getline(file, line))
+		{
+			std::istringstream fields(line.substr(0, line.find('#')));
+
+			ViewDesc view;
+			if (fields >> view.origin.x >> view.origin.y >> view.origin.z >> view.lookAt.x >> view.lookAt.y >> view.lookAt.z >> view.verticalFov >> view.outputPath)
+			{
+				views.push_back(view);
+			}
+		}
+
+		return views;
+	}
 }
 
-void SpheresApp::OnRender(HWND hWnd)
+// -width W -height H -crop left top right bottom -tiles scanline|spiral|hilbert|focus -focus x y -scene S -seed S -share name -cache N -cachecell size -guide -denoise
+// -lamps emissiveFraction pointLights -nolightsampling -texture image.ppm
+// Headless: -reference out.pfm [-spp N] [-time seconds] [-stats runs.csv] | -views views.txt [-spp N] [-time seconds] [-stats runs.csv] | -benchmark reference.pfm [-out curve.csv] [-budgets 1,2,5] [-checkpoints 1,4,16]
+// Render server: -serve name; jobs add -priority P
+RenderOptions RenderOptions::Parse(const std::string& commandLine)
 {
-	PAINTSTRUCT ps;
+	RenderOptions options;
+	bool hasSeed = false;
 
-	const HDC hdc = BeginPaint(hWnd, &ps);
-	m_renderTarget->BeginDraw();
+	std::istringstream args(commandLine);
+	std::string arg;
 
-	m_renderTarget->Clear(D2D1::ColorF(D2D1::ColorF::SkyBlue));
+	while (args >> arg)
+	{
+		if (arg == "-width")
+		{
+			args >> options.width;
+		}
+		else if (arg == "-height")
+		{
+			args >> options.height;
+		}
+		else if (arg == "-crop")
+		{
+			PixelRect crop{};
+			if (args >> crop.left >> crop.top >> crop.right >> crop.bottom)
+			{
+				options.crop = crop;
+			}
+		}
+		else if (arg == "-tiles")
+		{
+			std::string name;
+			args >> name;
+
+			static const std::unordered_map<std::string, TileOrder> k_orders = {
+				{ "scanline", TileOrder::Scanline },
+				{ "spiral", TileOrder::Spiral },
+				{ "hilbert", TileOrder::Hilbert },
+				{ "focus", TileOrder::Focus } };
+
+			if (const auto it = k_orders.find(name); it != k_orders.end())
+			{
+				options.tileOrder = it->second;
+			}
+		}
+		else if (arg == "-focus")
+		{
+			if (args >> options.focus.x >> options.focus.y)
+			{
+				options.tileOrder = TileOrder::Focus;
+			}
+		}
+		else if (arg == "-scene")
+		{
+			args >> options.sceneSeed;
+		}
+		else if (arg == "-lamps")
+		{
+			args >> options.lighting.emissiveSphereFraction >> options.lighting.pointLightCount;
+		}
+		else if (arg == "-nolightsampling")
+		{
+			options.lighting.sampleAreaLights = false;
+		}
+		else if (arg == "-texture")
+		{
+			args >> options.texturePath;
+		}
+		else if (arg == "-seed")
+		{
+			hasSeed = static_cast<bool>(args >> options.sampleSeed);
+		}
+		else if (arg == "-share")
+		{
+			std::string name;
+			args >> name;
+			options.shareName = std::wstring(name.begin(), name.end());
+		}
+		else if (arg == "-cache")
+		{
+			args >> options.radianceCacheSamples;
+		}
+		else if (arg == "-cachecell")
+		{
+			args >> options.radianceCacheCellSize;
+		}
+		else if (arg == "-guide")
+		{
+			options.pathGuiding = true;
+		}
+		else if (arg == "-denoise")
+		{
+			options.denoise = true;
+		}
+		else if (arg == "-reference")
+		{
+			args >> options.referencePath;
+		}
+		else if (arg == "-spp")
+		{
+			args >> options.sampleLimit;
+		}
+		else if (arg == "-time")
+		{
+			args >> options.timeLimit;
+		}
+		else if (arg == "-stats")
+		{
+			args >> options.runStatsPath;
+		}
+		else if (arg == "-views")
+		{
+			std::string path;
+			args >> path;
 
+			if (std::vector<ViewDesc> views = ReadViews(path); !views.empty())
+			{
+				options.views = std::move(views);
+			}
+		}
+		else if (arg == "-benchmark")
+		{
+			args >> options.benchmarkReference;
+		}
+		else if (arg == "-out")
+		{
+			args >> options.benchmarkOutput;
+		}
+		else if (arg == "-budgets")
+		{
+			std::string list;
+			args >> list;
+			options.timeBudgets = ParseList<double>(list);
+		}
+		else if (arg == "-checkpoints")
+		{
+			std::string list;
+			args >> list;
+			options.sampleCheckpoints = ParseList<uint32_t>(list);
+		}
+		else if (arg == "-serve")
+		{
+			std::string name;
+			args >> name;
+			options.serveName = std::wstring(name.begin(), name.end());
+		}
+		else if (arg == "-priority")
+		{
+			args >> options.priority;
+		}
+	}
+
+	// A reference sharing the measured runs' samples would hide their noise
+	if (!options.referencePath.empty() && !hasSeed)
 	{
-		const auto start = std::chrono::high_resolution_clock::now();
+		options.sampleSeed = AppSettings::k_seed + 1;
+	}
+
+	return options;
+}
 
-		const size_t rayCount = DrawBitmap(hWnd);
+SpheresApp::SpheresApp(const RenderOptions& options) :
+	SpheresApp(options, std::make_unique<WorkerPool>())
+{
+}
+
+SpheresApp::SpheresApp(const RenderOptions& options, std::unique_ptr<WorkerPool> workers) :
+	SpheresApp(options, *workers, nullptr)
+{
+	m_ownWorkers = std::move(workers);
+}
 
-		const auto stop = std::chrono::high_resolution_clock::now();
-		const std::chrono::duration<double, std::micro> duration = stop - start;
-		const double timeElapsed = duration.count();
+SpheresApp::SpheresApp(const RenderOptions& options, WorkerPool& workers, std::shared_ptr<const SpheresScene> scene) :
+	m_options{ options },
+	m_workers{ workers },
+	m_scene{ std::move(scene) }
+{
+	m_options.width = std::max(m_options.width, 1u);
+	m_options.height = std::max(m_options.height, 1u);
 
-		DisplayStats(hWnd, rayCount, timeElapsed);
+	m_crop = PixelRect{ 0, 0, m_options.width, m_options.height };
+	if (m_options.crop)
+	{
+		const PixelRect& crop = m_options.crop.value();
+		const PixelRect clipped{
+			std::min(crop.left, m_options.width),
+			std::min(crop.top, m_options.height),
+			std::min(crop.right, m_options.width),
+			std::min(crop.bottom, m_options.height) };
+
+		// An empty window renders the whole frame
+		if (clipped.left < clipped.right && clipped.top < clipped.bottom)
+		{
+			m_crop = clipped;
+		}
 	}
+}
 
-	m_renderTarget->EndDraw();
-	EndPaint(hWnd, &ps);
+int SpheresApp::RunHeadless()
+{
+	// Without a shared section nobody looks at intermediate images; the last pass of a limited run still presents
+	const auto presentInterval = m_options.shareName.empty() ? std::chrono::milliseconds(std::chrono::hours(24)) : GetPresentInterval();
+
+	const uint32_t width = m_options.width;
+	const uint32_t height = m_options.height;
+
+	if (m_options.benchmarkReference.empty())
+	{
+		// A time limit ends the run after the pass that reached it; the accumulation holds every finished pass
+		m_renderLoop.Start(width, height, presentInterval, [this](XMCOLOR* ldr)
+		{
+			OnRenderPass(ldr);
+
+			if (m_options.timeLimit > 0.0 && GetRenderSeconds() >= m_options.timeLimit)
+			{
+				m_renderLoop.RequestStop();
+			}
+		}, {}, m_options.sampleLimit);
+		m_renderLoop.Wait();
+
+		const bool statsWritten = m_options.runStatsPath.empty() || AppendRunStats();
+		if (!statsWritten)
+		{
+			std::cerr << "could not write " << m_options.runStatsPath << "\n";
+		}
+
+		const bool outputsWritten = WriteOutputs();
+		if (!outputsWritten)
+		{
+			std::cerr << "could not write an output image\n";
+		}
+
+		return outputsWritten && statsWritten ? 0 : 1;
+	}
+
+	std::vector<XMFLOAT3> reference;
+	uint32_t referenceWidth = 0;
+	uint32_t referenceHeight = 0;
+	if (!ImageIO::ReadPfm(m_options.benchmarkReference, reference, referenceWidth, referenceHeight))
+	{
+		std::cerr << "could not read reference " << m_options.benchmarkReference << "\n";
+		return 1;
+	}
+
+	if (referenceWidth != width || referenceHeight != height)
+	{
+		std::cerr << "reference " << m_options.benchmarkReference << " is " << referenceWidth << "x" << referenceHeight <<
+			", the render is " << width << "x" << height << "\n";
+		return 1;
+	}
+
+	QualityHarness harness(std::move(reference), width, height, m_crop, m_options.timeBudgets, m_options.sampleCheckpoints, m_options.denoise);
+
+	// Measured between passes on the render thread; the pass statistics hold render time only
+	m_renderLoop.Start(width, height, presentInterval, [this, &harness](XMCOLOR* ldr)
+	{
+		OnRenderPass(ldr);
+
+		double renderSeconds;
+		{
+			std::lock_guard<std::mutex> lock(m_passStatsMutex);
+			renderSeconds = m_passStats.totalSeconds;
+		}
+
+		// Plain accumulation may never catch up with a denoised checkpoint, so the limits still end the run
+		if (harness.OnPass(m_backbufferHdr, static_cast<uint32_t>(m_sampleCount), renderSeconds) ||
+			(m_options.timeLimit > 0.0 && renderSeconds >= m_options.timeLimit))
+		{
+			m_renderLoop.RequestStop();
+		}
+	}, {}, m_options.sampleLimit);
+	m_renderLoop.Wait();
+
+	if (!harness.WriteCsv(m_options.benchmarkOutput))
+	{
+		std::cerr << "could not write " << m_options.benchmarkOutput << "\n";
+		return 1;
+	}
+
+	return 0;
 }
 
-void SpheresApp::InitCamera()
+bool SpheresApp::RenderJobPass()
 {
-	XMVECTOR camOrigin = XMVectorSet(12.f, 2.f, -2.5f, 1.f);
-	XMVECTOR camLookAt = XMVectorSet(0, 1, 0, 1.f);
+	OnRenderPass(nullptr);
 
-	m_camera = std::make_unique<Camera>(
-		camOrigin,
-		camLookAt,
-		AppSettings::k_verticalFov,
-		AppSettings::k_aspectRatio,
-		XMVectorGetX(XMVector3Length(camOrigin - camLookAt)),
-		AppSettings::k_aperture);
+	const bool samplesLeft = m_options.sampleLimit == 0 || m_sampleCount < m_options.sampleLimit;
+	const bool timeLeft = m_options.timeLimit <= 0.0 || GetRenderSeconds() < m_options.timeLimit;
+	return samplesLeft && timeLeft;
+}
 
-	m_exposure = -15;
+double SpheresApp::GetRenderSeconds() const
+{
+	std::lock_guard<std::mutex> lock(m_passStatsMutex);
+	return m_passStats.totalSeconds;
 }
 
-void SpheresApp::InitScene()
+bool SpheresApp::WriteOutputs() const
 {
-	static std::random_device device;
-	static std::ranlux24_base generator(device());
-	static std::uniform_real_distribution<float> uniformDist(0.f, 1.f);
+	bool written = true;
+	for (uint32_t view = 0; view < m_views.size(); ++view)
+	{
+		if (!m_views[view].outputPath.empty())
+		{
+			const Framebuffer& image = GetImage(view);
+			written &= ImageIO::WritePfm(m_views[view].outputPath, GetTexels(image), image.GetWidth(), image.GetHeight());
+		}
+	}
 
-	m_scene.reserve(500);
+	return written;
+}
 
-	// Floor
-	m_textures.push_back(std::make_unique<CheckerTexture>(XMCOLOR{ 0.9f, 0.9f, 0.9f, 1.f }, XMCOLOR{ 0.2f, 0.3f, 0.1f, 1.f }, 2500.f));
-	m_scene.push_back(std::make_unique<Sphere>(XMVECTORF32{ 0, -1000, 0 }, 1000.f, std::make_unique<DielectricOpaque>(m_textures.back().get(), XMVectorReplicate(16.f))));
+bool SpheresApp::AppendRunStats() const
+{
+	const bool isNew = !std::ifstream(m_options.runStatsPath).good();
 
-	// Random small spheres
-	for (int a = -11; a < 11; ++a)
+	std::ofstream file(m_options.runStatsPath, std::ios::app);
+	if (isNew)
 	{
-		for (int b = -11; b < 11; ++b)
+		file << "views,width,height,samples per pixel,scene build ms,render seconds,Mrays/s\n";
+	}
+
+	std::lock_guard<std::mutex> lock(m_passStatsMutex);
+	const double mraysPerSecond = m_passStats.totalSeconds > 0.0 ? m_passStats.totalRayCount * 1e-6 / m_passStats.totalSeconds : 0.0;
+
+	file << m_views.size() << "," << m_options.width << "," << m_options.height << "," << m_sampleCount << "," <<
+		m_scene->GetBuildMs() << "," << m_passStats.totalSeconds << "," << mraysPerSecond << "\n";
+
+	return static_cast<bool>(file);
+}
+
+std::vector<XMFLOAT3> SpheresApp::GetTexels(const Framebuffer& image)
+{
+	std::vector<XMFLOAT3> texels(static_cast<size_t>(image.GetWidth()) * image.GetHeight());
+	for (uint32_t y = 0; y < image.GetHeight(); ++y)
+	{
+		for (uint32_t x = 0; x < image.GetWidth(); ++x)
 		{
-			const float chooseMat = uniformDist(generator);
-			XMVECTORF32 center{ a + 0.9f * uniformDist(generator), 0.2f, b + 0.9f * uniformDist(generator) };
+			XMStoreFloat3(&texels[static_cast<size_t>(y) * image.GetWidth() + x], image.GetPixel(x, y));
+		}
+	}
 
-			if (chooseMat < 0.8f)
-			{
-				m_textures.push_back(std::make_unique<ConstTexture>(
-					XMCOLOR{
-						uniformDist(generator) * uniformDist(generator),
-						uniformDist(generator) * uniformDist(generator),
-						uniformDist(generator) * uniformDist(generator),
-						1.f
-					}));
+	return texels;
+}
 
-				float smoothness = 8.f * (4.f + uniformDist(generator));
+void SpheresApp::OnInitialize(HWND hWnd)
+{
+	InitViews();
 
-				m_scene.push_back(std::make_unique<Sphere>(center, 0.2f, std::make_unique<DielectricOpaque>(m_textures.back().get(), XMVectorReplicate(smoothness))));
-			}
-			else if (chooseMat < 0.95f)
-			{
-				m_textures.push_back(std::make_unique<ConstTexture>(
-					XMCOLOR{
-						0.5f * (1.f + uniformDist(generator)),
-						0.5f * (1.f + uniformDist(generator)),
-						0.5f * (1.f + uniformDist(generator)),
-						1.f
-					}
-				));
+	// A render server job brings its scene from the server's cache
+	if (!m_scene)
+	{
+		m_scene = std::make_shared<const SpheresScene>(m_options.sceneSeed, m_workers, m_options.lighting, m_options.texturePath);
+	}
 
-				m_scene.push_back(std::make_unique<Sphere>(center, 0.2f, std::make_unique<Metal>(m_textures.back().get(), XM_Zero)));
-			}
-			else
-			{
-				float smoothness = 8.f * (4.f + uniformDist(generator));
+	// Narrowest integrator variant that covers everything in the scene
+	static constexpr auto hitColorTable = MakeHitColorTable(std::make_index_sequence<SceneFeature::CombinationCount>());
+	m_hitColor = hitColorTable[m_scene->GetFeatures()];
+
+	if (m_options.pathGuiding)
+	{
+		XMFLOAT3 sceneMin, sceneMax;
+		m_scene->GetBvh().GetBounds(sceneMin, sceneMax);
+		m_pathGuide = std::make_unique<PathGuide>(PathGuideSettings{}, sceneMin, sceneMax);
+	}
+
+	if (m_options.radianceCacheSamples > 0)
+	{
+		RadianceCacheSettings cacheSettings;
+		cacheSettings.cellSize = m_options.radianceCacheCellSize;
+		cacheSettings.convergedSamples = m_options.radianceCacheSamples;
+		m_radianceCache = std::make_unique<RadianceCache>(cacheSettings);
+	}
+
+	// Only shown in the window title
+	if (hWnd)
+	{
+		MeasureBvhTraversal();
+	}
+
+	// The render goes on unshared; windowed runs show the failure in the title bar
+	if (!m_options.shareName.empty() && !ShareFramebuffer(m_options.shareName))
+	{
+		m_shareFailed = true;
+		std::wcerr << L"could not create shared framebuffer " << m_options.shareName << L"\n";
+	}
 
-				m_scene.emplace_back(std::make_unique<Sphere>(center, 0.2f, std::make_unique<DielectricTransparent>(XMVectorReplicate(smoothness), 1.5f)));
+	// Only the displayed view feeds the denoiser
+	m_backbufferHdr.Resize(m_options.width, m_options.height, m_options.denoise);
+	for (uint32_t view = 1; view < m_views.size(); ++view)
+	{
+		m_views[view].hdr.Resize(m_options.width, m_options.height);
+	}
+
+	m_tileOrder = MakeTileOrder(m_backbufferHdr, m_crop, m_options.tileOrder, m_options.focus);
+	const auto tileCount = static_cast<uint32_t>(m_tileOrder.size());
+
+	// Each tile is first touched by a worker of the node that traces it, which places its pages on that node.
+	// Nodes are dealt tiles by their position in the tile order, so a later focus click moves tiles between
+	// nodes; that only costs remote accesses, not correctness.
+	m_workers.ParallelFor(tileCount * static_cast<uint32_t>(m_views.size()), [this, tileCount](uint32_t item, uint32_t)
+	{
+		GetFramebuffer(item / tileCount).ClearTile(m_tileOrder[item % tileCount]);
+		return uint64_t{ 0 };
+	}, false);
+
+	// Tiles outside the crop window are never traced
+	std::vector<bool> traced(m_backbufferHdr.GetTileCount(), false);
+	for (const uint32_t tileIndex : m_tileOrder)
+	{
+		traced[tileIndex] = true;
+	}
+
+	for (uint32_t view = 0; view < m_views.size(); ++view)
+	{
+		for (uint32_t tileIndex = 0; tileIndex < m_backbufferHdr.GetTileCount(); ++tileIndex)
+		{
+			if (!traced[tileIndex])
+			{
+				GetFramebuffer(view).ClearTile(tileIndex);
 			}
 		}
 	}
+}
 
-	// Large spheres
-	m_scene.push_back(std::make_unique<Sphere>(XMVECTORF32{ 0, 1, 0 }, 1.f, std::make_unique<DielectricTransparent>(XMVectorReplicate(16.f), 1.5f)));
+void SpheresApp::OnRenderPass(XMCOLOR* ldr)
+{
+	const auto start = std::chrono::high_resolution_clock::now();
 
-	m_textures.push_back(std::make_unique<ConstTexture>(XMCOLOR{ 0.4f, 0.2f, 0.1f, 1.f }));
-	m_scene.push_back(std::make_unique<Sphere>(XMVECTORF32{ -4, 1, 0 }, 1.f, std::make_unique<DielectricOpaque>(m_textures.back().get(), XMVectorReplicate(16.f))));
+	if (m_sampleCount == 0)
+	{
+		m_renderStart = std::chrono::steady_clock::now();
+	}
+
+	// A click re-centres the remaining passes on the clicked pixel
+	if (const uint64_t focus = m_pendingFocus.exchange(k_noFocus); focus != k_noFocus)
+	{
+		const XMUINT2 pixel{ static_cast<uint32_t>(focus >> 32), static_cast<uint32_t>(focus) };
+		m_tileOrder = MakeTileOrder(m_backbufferHdr, m_crop, TileOrder::Focus, pixel);
+	}
 
-	m_textures.push_back(std::make_unique<ConstTexture>(XMCOLOR{ 0.7f, 0.6f, 0.5f, 1.f }));
-	m_scene.push_back(std::make_unique<Sphere>(XMVECTORF32{ 4, 1, 0 }, 1.f, std::make_unique<Metal>(m_textures.back().get(), XM_Zero)));
+	double firstPixelMs = 0.0;
+	const size_t rayCount = TracePass(ldr, firstPixelMs);
 
-	// Construct BVH
-	m_bvh = std::make_unique<BvhNode>(m_scene.begin(), m_scene.end());
+	const auto stop = std::chrono::high_resolution_clock::now();
+	const std::chrono::duration<double, std::micro> duration = stop - start;
 
-	// Sky
-	m_textures.push_back(std::make_unique<ConstTexture>(XMCOLOR{ 0.85f, 0.91f, 0.98f, 1.f }));
-	m_skyMaterial = std::make_unique<Emissive>(8000.f, m_textures.back().get());
+	const PathGuide::Stats guideStats = m_pathGuide ? m_pathGuide->GetStats() : PathGuide::Stats{};
 
-	// Sun
-	auto lightOcclusionTest = [this](const Ray& ray) -> bool
-	{ 
-		Payload dummy{};
-		return m_bvh->Intersect(ray, dummy); 
-	};
-	m_lights.push_back(std::make_unique<DirectionalLight>(XMVECTORF32{ 1.f, 1.f, 1.f }, XMCOLOR{ 1.f, 0.97f, 0.88f, 1.f }, 40000.f, lightOcclusionTest));
+	std::lock_guard<std::mutex> lock(m_passStatsMutex);
+	m_passStats.sampleCount = m_sampleCount;
+	m_passStats.rayCount = rayCount;
+	m_passStats.totalRayCount += rayCount;
+	m_passStats.passMicroseconds = duration.count();
+	m_passStats.totalSeconds += duration.count() * 1e-6;
+	m_passStats.denoiseMs = m_denoiseTimeMs;
+	m_passStats.firstPixelMs = firstPixelMs;
+	m_passStats.guide = guideStats;
+
+	if (ldr && m_passStats.firstImageMs == 0.0)
+	{
+		m_passStats.firstImageMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_renderStart).count();
+	}
 }
 
-std::vector<std::pair<Ray, int>> SpheresApp::GenerateRays() const
+void SpheresApp::OnClick(int x, int y)
 {
-	std::vector<std::pair<Ray, int>> rays;
-	rays.reserve(AppSettings::k_backbufferWidth * AppSettings::k_backbufferHeight);
+	const auto px = static_cast<uint32_t>(std::clamp(x, 0, static_cast<int>(m_options.width) - 1));
+	const auto py = static_cast<uint32_t>(std::clamp(y, 0, static_cast<int>(m_options.height) - 1));
+	m_pendingFocus = (static_cast<uint64_t>(px) << 32) | py;
+}
 
-	const auto xsize = static_cast<float>(AppSettings::k_backbufferWidth);
-	const auto ysize = static_cast<float>(AppSettings::k_backbufferHeight);
+void SpheresApp::OnPresent(HWND hWnd)
+{
+	DisplayStats(hWnd);
+}
 
-	XMFLOAT2 jitterOffset = Random::HaltonSample2D(m_sampleCount, 2, 3);
+void SpheresApp::InitViews()
+{
+	m_views.clear();
 
-	int rayId = 0;
+	for (const ViewDesc& desc : m_options.views)
+	{
+		const XMVECTOR camOrigin = XMVectorSetW(XMLoadFloat3(&desc.origin), 1.f);
+		const XMVECTOR camLookAt = XMVectorSetW(XMLoadFloat3(&desc.lookAt), 1.f);
+
+		View view;
+		view.camera = std::make_unique<Camera>(
+			camOrigin,
+			camLookAt,
+			desc.verticalFov,
+			static_cast<float>(m_options.width) / m_options.height,
+			XMVectorGetX(XMVector3Length(camOrigin - camLookAt)),
+			AppSettings::k_aperture);
+		view.pixelSpread = 2.f * std::tan(0.5f * desc.verticalFov * XM_PI / 180.f) / m_options.height;
+		view.outputPath = desc.outputPath;
+		// Views after the first get their own sample sequences, so their noise is independent
+		view.sampleSeed = m_options.sampleSeed ^ (static_cast<uint32_t>(m_views.size()) * 0x9e3779b9u);
+
+		m_views.push_back(std::move(view));
+	}
 
-	for (auto j = 0; j < AppSettings::k_backbufferHeight; ++j)
+	// A reference is an image of the first view
+	if (!m_options.referencePath.empty())
 	{
-		for (auto i = 0; i < AppSettings::k_backbufferWidth; ++i)
-		{
-			XMFLOAT2 uv;
-			uv.x = static_cast<float>(i + jitterOffset.x) / xsize;
-			uv.y = static_cast<float>(j + jitterOffset.y) / ysize;
+		m_views[0].outputPath = m_options.referencePath;
+	}
 
-			const XMFLOAT2 offset = Random::HaltonSampleDisk(m_sampleCount + i + j, 4, 5);
+	m_exposure = -15;
+}
+
+void SpheresApp::MeasureBvhTraversal()
+{
+	// Pinhole rays through a coarse grid of pixel centers, enough to compare builds of the same scene
+	constexpr uint32_t k_probeWidth = 64;
+	constexpr uint32_t k_probeHeight = 36;
 
-			const Ray ray = m_camera->GetRay(uv, offset);
+	m_bvhTraversal = {};
+	m_bvhProbeRayCount = k_probeWidth * k_probeHeight;
 
-			rays.push_back(std::make_pair(ray, rayId++));
+	for (uint32_t j = 0; j < k_probeHeight; ++j)
+	{
+		for (uint32_t i = 0; i < k_probeWidth; ++i)
+		{
+			const XMFLOAT2 uv{ (i + 0.5f) / k_probeWidth, (j + 0.5f) / k_probeHeight };
+			Payload payload;
+			m_scene->GetBvh().Intersect(m_views[0].camera->GetRay(uv, XMFLOAT2{ 0.f, 0.f }), payload, &m_bvhTraversal);
 		}
 	}
+}
+
+void SpheresApp::GenerateRays(const View& view, const PixelRect& block, uint32_t sampleIndex, RayPacket& outPacket) const
+{
+	const auto xsize = static_cast<float>(m_options.width);
+	const auto ysize = static_cast<float>(m_options.height);
+
+	// Camera samples are generated for the whole block at once
+	std::array<uint32_t, RayPacket::k_maxRays> pixelSeeds;
+	std::array<XMFLOAT2, RayPacket::k_maxRays> jitterSamples;
+	std::array<XMFLOAT2, RayPacket::k_maxRays> lensSamples;
+	std::array<XMFLOAT2, RayPacket::k_maxRays> uvs;
+
+	const uint32_t width = block.right - block.left;
+	const uint32_t count = width * (block.bottom - block.top);
+	assert(count <= RayPacket::k_maxRays && L"Rays are generated per packet");
+
+	// Seeds follow the full-frame pixel index, so a pixel gets the same samples whatever is traced around it
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		pixelSeeds[i] = Sampler::PixelSeed((block.top + i / width) * m_options.width + block.left + i % width, view.sampleSeed);
+	}
+
+	Sampler::Get2D(pixelSeeds.data(), count, sampleIndex, 0, jitterSamples.data());
+	Sampler::Get2D(pixelSeeds.data(), count, sampleIndex, 1, lensSamples.data());
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uvs[i].x = static_cast<float>(block.left + i % width + jitterSamples[i].x) / xsize;
+		uvs[i].y = static_cast<float>(block.top + i / width + jitterSamples[i].y) / ysize;
+		lensSamples[i] = Sampler::SampleDisk(lensSamples[i]);
+	}
 
-	return rays;
+	view.camera->GetRays(uvs.data(), lensSamples.data(), count, outPacket);
+	outPacket.coneWidth = 0.f;
+	outPacket.coneSpread = view.pixelSpread;
 }
 
-size_t SpheresApp::DrawBitmap(HWND hWnd)
+size_t SpheresApp::TracePass(XMCOLOR* ldr, double& outFirstPixelMs)
 {
 	using namespace DirectX;
 	using namespace DirectX::PackedVector;
 
 	++m_sampleCount;
 
-	// Rays
-	std::vector<std::pair<Ray, int>> rayBuffer = GenerateRays();
+	const auto start = std::chrono::steady_clock::now();
+	std::atomic<bool> firstTileDone{ false };
+	std::chrono::steady_clock::time_point firstTileTime = start;
 
 	// Exposure for the scene
 	const float exposureAdjustment = std::pow(2, m_exposure);
 
-	// Trace
-	std::for_each(
-		std::execution::par,
-		rayBuffer.cbegin(), rayBuffer.cend(), 
-		[this, exposureAdjustment](const std::pair<Ray, int>& r)
+	// Denoising needs the whole image, so only the plain resolve runs per tile
+	XMCOLOR* tileLdr = m_options.denoise ? nullptr : ldr;
+
+	const auto tileCount = static_cast<uint32_t>(m_tileOrder.size());
+
+	// Trace one framebuffer tile per task so that no two threads write to the same cache line. Tiles are
+	// dealt to the NUMA nodes in the same rounds that placed their memory, so every node works its way through
+	// the tile order alongside the others and the spiral or focus order holds across nodes. The tiles of all
+	// views form one queue, so no core idles at the end of a view. Primary rays are generated by the worker
+	// that traces the tile, so the first pixels land without waiting for a full-frame ray buffer, and go out
+	// in packets of 8x8 pixels that find their first hits in one BVH traversal. Resolving a tile right after
+	// its flush overlaps tonemapping with the tracing of other tiles and reads the tile while it is still in
+	// cache.
+	m_workers.ParallelFor(
+		tileCount * static_cast<uint32_t>(m_views.size()),
+		[this, tileCount, exposureAdjustment, tileLdr, &firstTileDone, &firstTileTime, sampleIndex = static_cast<uint32_t>(m_sampleCount - 1)](uint32_t item, uint32_t)
 		{
-			XMVECTOR& colorVec = m_backbufferHdr[r.second];
-			colorVec += GetHitColor(r.first, 0) * exposureAdjustment;
-		});
+			// Skipped tiles keep their sample count, so a cancelled pass leaves the accumulation consistent
+			if (m_renderLoop.IsStopRequested())
+			{
+				return uint64_t{ 0 };
+			}
 
-	// ACES tonemapping parameters
-	static const float a = 2.51f;
-	static const float b = 0.03f;
-	static const float c = 2.43f;
-	static const float d = 0.59f;
-	static const float e = 0.14f;
+			const uint32_t viewIndex = item / tileCount;
+			const View& view = m_views[viewIndex];
+			Framebuffer& hdr = GetFramebuffer(viewIndex);
 
-	// Gamma
-	static XMVECTORF32 invGamma{ 1 / 2.2f, 1 / 2.2f, 1 / 2.2f };
+			const uint32_t tileIndex = m_tileOrder[item % tileCount];
+			const PixelRect tileRect = hdr.GetTileRect(tileIndex);
+			const PixelRect rect{
+				std::max(tileRect.left, m_crop.left),
+				std::max(tileRect.top, m_crop.top),
+				std::min(tileRect.right, m_crop.right),
+				std::min(tileRect.bottom, m_crop.bottom) };
 
-	std::transform(
-		std::execution::par,
-		m_backbufferHdr.cbegin(), m_backbufferHdr.cend(),
-		m_backbufferLdr.begin(),
-		[n = m_sampleCount](const XMVECTOR& hdrColor) -> XMCOLOR
-		{
-			XMVECTOR color = hdrColor / static_cast<float>(n);
+			const XMVECTOR viewOrigin = view.camera->GetOrigin();
+			const Bvh& bvh = m_scene->GetBvh();
+
+			// Pixels of the tile outside the crop window accumulate nothing and stay black
+			Framebuffer::TileAccumulator accumulator{};
+			accumulator.sampleCount = 1;
+
+			RayPacket packet;
+			std::array<std::optional<Payload>, RayPacket::k_maxRays> primaryHits;
+
+			for (uint32_t blockTop = rect.top; blockTop < rect.bottom; blockTop += RayPacket::k_size)
+			{
+				for (uint32_t blockLeft = rect.left; blockLeft < rect.right; blockLeft += RayPacket::k_size)
+				{
+					const PixelRect block{
+						blockLeft,
+						blockTop,
+						std::min(blockLeft + RayPacket::k_size, rect.right),
+						std::min(blockTop + RayPacket::k_size, rect.bottom) };
+
+					GenerateRays(view, block, sampleIndex, packet);
+
+					if (AppSettings::k_primaryRayPackets)
+					{
+						bvh.IntersectPacket(packet, primaryHits.data());
+					}
+					else
+					{
+						for (uint32_t i = 0; i < packet.count; ++i)
+						{
+							primaryHits[i] = GetClosestIntersection(packet.GetRay(i));
+						}
+					}
+
+					const uint32_t blockWidth = block.right - block.left;
+
+					for (uint32_t i = 0; i < packet.count; ++i)
+					{
+						const uint32_t x = block.left + i % blockWidth;
+						const uint32_t y = block.top + i / blockWidth;
+
+						SampleContext sampler{ Sampler::PixelSeed(y * m_options.width + x, view.sampleSeed), sampleIndex, k_cameraDimensions };
+
+						const uint32_t localIndex = (y - tileRect.top) * Framebuffer::k_tileSize + (x - tileRect.left);
+						const Ray ray = packet.GetRay(i);
 
-			// Tonemap
-			color = XMVectorSaturate((color*(a*color + XMVectorReplicate(b))) / (color*(c*color + XMVectorReplicate(d)) + XMVectorReplicate(e)));
+						if (hdr.HasAovs())
+						{
+							SurfaceAovs aovs;
+							accumulator.Add(localIndex, (this->*m_hitColor)(ray, primaryHits[i], viewOrigin, 0, 0.f, sampler, &aovs) * exposureAdjustment);
+							accumulator.AddAovs(localIndex, aovs);
+						}
+						else
+						{
+							accumulator.Add(localIndex, (this->*m_hitColor)(ray, primaryHits[i], viewOrigin, 0, 0.f, sampler, nullptr) * exposureAdjustment);
+						}
+					}
+				}
+			}
+
+			hdr.Flush(tileIndex, accumulator);
 
-			// Gamma correction
-			color = XMVectorPow(color, invGamma);
+			if (!firstTileDone.exchange(true, std::memory_order_relaxed))
+			{
+				firstTileTime = std::chrono::steady_clock::now();
+			}
 
-			XMCOLOR outColor;
-			XMStoreColor(&outColor, color);
+			if (tileLdr && viewIndex == 0)
+			{
+				m_resolver.ResolveTile(hdr, tileIndex, tileLdr, m_options.width);
+			}
 
-			return outColor;
+			return static_cast<uint64_t>(rect.right - rect.left) * (rect.bottom - rect.top);
 		});
 
+	// The pool's completion handshake orders the winning worker's write before this read
+	outFirstPixelMs = std::chrono::duration<double, std::milli>(firstTileTime - start).count();
+
+	// No worker reads the guide between passes
+	if (m_pathGuide)
+	{
+		m_pathGuide->EndPass();
+	}
+
+	if (ldr && m_options.denoise && !m_renderLoop.IsStopRequested())
+	{
+		ResolveDenoised(ldr);
+	}
 
-	m_backbufferBitmap->CopyFromMemory(nullptr, m_backbufferLdr.data(), sizeof(m_backbufferLdr[0]) * AppSettings::k_backbufferWidth);
+	return static_cast<size_t>(m_crop.right - m_crop.left) * (m_crop.bottom - m_crop.top) * m_views.size();
+}
 
-	m_renderTarget->DrawBitmap(m_backbufferBitmap.Get());
+void SpheresApp::ResolveDenoised(XMCOLOR* ldr)
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+	m_denoiser.Denoise(m_backbufferHdr, m_denoised);
+	m_denoiseTimeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
 
-	return rayBuffer.size();
+	m_resolver.Resolve(m_denoised, ldr, m_options.width, PixelRect{ 0, 0, m_options.width, m_options.height });
 }
 
 std::optional<Payload> SpheresApp::GetClosestIntersection(const Ray& ray) const
 {
 	Payload payload{};
 
-	if (m_bvh->Intersect(ray, payload))
+	if (m_scene->GetBvh().Intersect(ray, payload))
 	{
 		return payload;
 	}
@@ -235,48 +780,217 @@ std::optional<Payload> SpheresApp::GetClosestIntersection(const Ray& ray) const
 	}
 }
 
-XMVECTOR SpheresApp::GetHitColor(const Ray& ray, int depth) const
+template <uint32_t Features>
+XMVECTOR SpheresApp::GetHitColor(const Ray& ray, const XMVECTOR& viewOrigin, int depth, float scatterPdf, SampleContext& sampler, SurfaceAovs* outAovs) const
 {
-	if (auto hitInfo = GetClosestIntersection(ray))
+	return ShadePath<Features>(ray, GetClosestIntersection(ray), viewOrigin, depth, scatterPdf, sampler, outAovs);
+}
+
+template <uint32_t Features>
+XMVECTOR SpheresApp::ShadePath(const Ray& ray, const std::optional<Payload>& hitInfo, const XMVECTOR& viewOrigin, int depth, float scatterPdf, SampleContext& sampler, SurfaceAovs* outAovs) const
+{
+	if (hitInfo)
 	{
 		const Payload& hit = hitInfo.value();
 
+		if (outAovs)
+		{
+			// Metals have no diffuse albedo, so their reflectance guides the denoiser instead
+			const Material& material = m_scene->GetMaterials().Get(hit.materialId);
+			outAovs->albedo = material.type == MaterialType::Metal ? material.GetReflectance(hit.uv, hit.uvFootprint) : material.GetAlbedo(hit.uv, hit.uvFootprint);
+			outAovs->normal = hit.normal;
+			outAovs->depth = XMVectorGetX(hit.t);
+		}
+
+		const MaterialTable& materials = m_scene->GetMaterials();
+
+		// Outgoing radiance of diffuse surfaces varies slowly, so paths share it through the cache
+		uint32_t cacheCell = k_invalidId;
+		if (m_radianceCache && materials.Get(hit.materialId).type == MaterialType::DielectricOpaque)
+		{
+			cacheCell = m_radianceCache->FindCell(hit.pos, hit.normal);
+
+			// Only behind a diffuse bounce, whose blur hides the cell's; opaque dielectrics emit nothing
+			XMVECTOR cached;
+			if (scatterPdf > 0.f && cacheCell != k_invalidId && m_radianceCache->GetRadiance(cacheCell, cached))
+			{
+				return cached;
+			}
+		}
+
 		XMVECTOR attenuation;
 		Ray scatteredRay;
-		const bool isScattered = hit.material->Scatter(ray, hit, attenuation, scatteredRay);
-		const bool recurse = depth < AppSettings::k_recursionDepth && isScattered;
+		float pdf;
+		const bool isScattered = materials.Scatter<Features>(hit.materialId, ray, hit, sampler, attenuation, scatteredRay, pdf);
+		bool recurse = depth < AppSettings::k_recursionDepth && isScattered;
+
+		// Diffuse bounces, the only ones with a density, mix in the path guide: one sample from either the guide
+		// or the BSDF, weighted by the density of the mixture. The bounce keeps passing the BSDF density on for
+		// MIS, so its weights still sum to one with those of the light samples, which know nothing of the guide.
+		uint32_t guideLeaf = k_invalidId;
+		float bouncePdf = pdf;
+		if (m_pathGuide && pdf > 0.f && recurse)
+		{
+			guideLeaf = m_pathGuide->FindLeaf(hit.pos);
 
-		return hit.material->Emit(hit) +
-			hit.material->Shade(hit, m_lights, m_camera->GetOrigin()) +
-			(recurse ? attenuation * GetHitColor(scatteredRay, depth + 1) : XM_Zero);
+			if (const float guideProbability = m_pathGuide->GetGuideProbability(guideLeaf); guideProbability > 0.f)
+			{
+				const float choice = sampler.Next1D();
+				const XMFLOAT2 u = sampler.Next2D();
+
+				float guidePdf;
+				if (choice < guideProbability)
+				{
+					scatteredRay.direction = m_pathGuide->Sample(guideLeaf, u, guidePdf);
+				}
+				else
+				{
+					guidePdf = m_pathGuide->Pdf(guideLeaf, scatteredRay.direction);
+				}
+
+				// The guide covers the whole sphere; directions into the surface carry nothing
+				const float bsdfPdf = XMVectorGetX(XMVector3Dot(scatteredRay.direction, hit.normal)) > 0.f ? pdf : 0.f;
+				bouncePdf = guideProbability * guidePdf + (1.f - guideProbability) * bsdfPdf;
+				recurse = bsdfPdf > 0.f;
+
+				if (recurse)
+				{
+					attenuation *= bsdfPdf / bouncePdf;
+				}
+			}
+		}
+
+		// Emitters that are also sampled as area lights compete with the light's own samples
+		XMVECTOR emitted = XM_Zero;
+		if constexpr ((Features & SceneFeature::Emissive) != 0)
+		{
+			emitted = materials.Emit(hit.materialId, hit);
+			if (scatterPdf > 0.f && hit.lightId != k_invalidId)
+			{
+				emitted *= PowerHeuristic(scatterPdf, m_scene->GetLightBvh().Pmf(ray.origin, hit.lightId) * m_scene->GetLights()[hit.lightId]->Pdf(ray));
+			}
+		}
+
+		// Direct lighting draws its sampler dimensions before the bounce continues the path
+		const XMVECTOR directLighting = materials.Shade<Features>(hit.materialId, ray, hit, sampler, m_scene->GetLights(), m_scene->GetLightBvh(), viewOrigin);
+
+		const XMVECTOR incoming = recurse ? GetHitColor<Features>(scatteredRay, viewOrigin, depth + 1, pdf, sampler, nullptr) : XM_Zero;
+
+		// The guide learns the radiance the bounce carries, which leaves out the light samples' share
+		if (guideLeaf != k_invalidId)
+		{
+			XMFLOAT3 radiance;
+			XMStoreFloat3(&radiance, incoming);
+			m_pathGuide->Record(guideLeaf, scatteredRay.direction, (0.2126f * radiance.x + 0.7152f * radiance.y + 0.0722f * radiance.z) / bouncePdf);
+		}
+
+		const XMVECTOR reflected = directLighting + (recurse ? attenuation * incoming : XM_Zero);
+
+		if (cacheCell != k_invalidId)
+		{
+			m_radianceCache->AddSample(cacheCell, reflected);
+		}
+
+		return emitted + reflected;
 	}
 	else
 	{
-		return m_skyMaterial->Emit(Payload{});
+		// Rays that left a diffuse bounce compete with the environment light's own samples
+		const EnvironmentLight& environment = m_scene->GetEnvironment();
+		const float misWeight = scatterPdf > 0.f ? PowerHeuristic(scatterPdf, environment.Pdf(ray)) : 1.f;
+		return misWeight * environment.Evaluate(ray.direction);
 	}
 }
 
-void SpheresApp::DisplayStats(HWND hWnd, const size_t rayCount, const double timeElapsed) const
+void SpheresApp::DisplayStats(HWND hWnd) const
 {
-	static double totalTimeInSeconds = 0;
-	totalTimeInSeconds += timeElapsed * std::pow(10, -6);
+	PassStats pass;
+	{
+		std::lock_guard<std::mutex> lock(m_passStatsMutex);
+		pass = m_passStats;
+	}
 
-	const double mraysPerSecond = static_cast<double>(rayCount) / timeElapsed;
+	const double mraysPerSecond = pass.passMicroseconds > 0.0 ? static_cast<double>(pass.rayCount) / pass.passMicroseconds : 0.0;
 
 	std::wstring windowText = std::wstring(L"Demo") +
+		(m_shareFailed ? L"\t | Could not share " + m_options.shareName : L"") +
 		L"\t | Mrays/s: " + std::to_wstring(mraysPerSecond) +
-		L"\t | spp: " + std::to_wstring(m_sampleCount) + 
-		L"\t | Time (seconds): " + std::to_wstring(totalTimeInSeconds);
+		L"\t | spp: " + std::to_wstring(pass.sampleCount) + 
+		L"\t | Time (seconds): " + std::to_wstring(pass.totalSeconds) +
+		L"\t | Presents: " + std::to_wstring(m_renderLoop.GetPresentCount()) +
+		L"\t | First pixel ms: " + std::to_wstring(pass.firstPixelMs) +
+		L"\t | First image ms: " + std::to_wstring(pass.firstImageMs) +
+		L"\t | Framebuffer B/px: " + std::to_wstring(m_backbufferHdr.GetBytesPerPixel());
+
+	// Scene memory, to size jobs: arena bytes per primitive (spheres plus their share of the BVH), per node and per material
+	const Bvh& bvh = m_scene->GetBvh();
+	if (const uint32_t primitiveCount = bvh.GetSphereCount(); primitiveCount > 0)
+	{
+		windowText += L"\t | Scene KB: " + std::to_wstring(m_scene->GetArenaBytes() >> 10) +
+			L" x" + std::to_wstring(m_scene->GetCopyCount()) +
+			L"\t | B/prim: " + std::to_wstring(static_cast<double>(m_scene->GetArenaBytes()) / primitiveCount) +
+			L"\t | BVH KB: " + std::to_wstring(bvh.GetMemoryUsage() >> 10) +
+			L"\t | B/BVH node: " + std::to_wstring(bvh.GetNodeSize()) +
+			L"\t | BVH refs/sphere: " + std::to_wstring(static_cast<double>(bvh.GetReferenceCount()) / primitiveCount) +
+			L"\t | BVH nodes/ray: " + std::to_wstring(static_cast<double>(m_bvhTraversal.nodes) / m_bvhProbeRayCount) +
+			L"\t | Materials: " + std::to_wstring(m_scene->GetMaterials().GetCount()) + L" x " + std::to_wstring(sizeof(Material)) + L" B";
+	}
+
+	if (m_options.denoise)
+	{
+		windowText += L"\t | Denoise ms: " + std::to_wstring(pass.denoiseMs);
+	}
+
+	// Throughput of each node's workers while they were busy, to check scaling across sockets
+	const std::vector<WorkerPool::NodeStats> nodeStats = m_workers.GetStats();
+	if (nodeStats.size() > 1)
+	{
+		for (size_t node = 0; node < nodeStats.size(); ++node)
+		{
+			const WorkerPool::NodeStats& stats = nodeStats[node];
+			// Tiles report their pixel count as work, one camera sample each
+			const double mpixelsPerCoreSecond = stats.busySeconds > 0.0 ? stats.work * 1e-6 / stats.busySeconds : 0.0;
+
+			windowText += L"\t | Node " + std::to_wstring(node) +
+				L" Mpixels/s: " + std::to_wstring(mpixelsPerCoreSecond * stats.workerCount) +
+				L" stolen %: " + std::to_wstring(stats.items > 0 ? 100.0 * stats.stolenItems / stats.items : 0.0);
+		}
+	}
+
+	const TextureCache::Stats texStats = TextureCache::Instance().GetStats();
+	if (const uint64_t lookups = texStats.hits + texStats.misses; lookups > 0)
+	{
+		windowText += L"\t | Tex cache hit %: " + std::to_wstring(100.0 * texStats.hits / lookups) +
+			L"\t | Tex cache MB: " + std::to_wstring(texStats.residentBytes >> 20) + L"/" + std::to_wstring(texStats.capacityBytes >> 20);
+	}
+
+	if (m_pathGuide && pass.guide.spatialLeaves > 0)
+	{
+		windowText += L"\t | Guide iteration: " + std::to_wstring(pass.guide.iteration) +
+			L"\t | Guide leaves: " + std::to_wstring(pass.guide.spatialLeaves) +
+			L"\t | Guide nodes/leaf: " + std::to_wstring(static_cast<double>(pass.guide.directionalNodes) / pass.guide.spatialLeaves);
+	}
+
+	if (m_radianceCache)
+	{
+		const RadianceCache::Stats cacheStats = m_radianceCache->GetStats();
+		windowText += L"\t | Radiance cache cells %: " + std::to_wstring(100.0 * cacheStats.usedCells / cacheStats.cellCount);
+	}
 
 	SetWindowText(hWnd, windowText.c_str());
 }
 
 int SpheresApp::GetBackBufferWidth() const
 {
-	return AppSettings::k_backbufferWidth;
+	return static_cast<int>(m_options.width);
 }
 
 int SpheresApp::GetBackBufferHeight() const
 {
-	return AppSettings::k_backbufferHeight;
+	return static_cast<int>(m_options.height);
+}
+
+std::chrono::milliseconds SpheresApp::GetPresentInterval() const
+{
+	return std::chrono::milliseconds(AppSettings::k_displayIntervalMs);
 }
\ No newline at end of file
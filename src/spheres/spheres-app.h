@@ -4,40 +4,225 @@
 
 namespace AppSettings
 {
-	constexpr int k_backbufferWidth = 1280;
+	constexpr int k_backbufferWidth = 1280;	// defaults, see RenderOptions
 	constexpr int k_backbufferHeight = 720; 
 	constexpr int k_recursionDepth = 50;
 	constexpr float k_verticalFov = 25.f;
 	constexpr float k_aperture = 0.4f;
-	constexpr float k_aspectRatio = k_backbufferWidth / static_cast<float>(k_backbufferHeight);
+	constexpr const char* k_environmentMapPath = "sky.hdr"; // lat-long Radiance HDR, constant sky color if missing
+	constexpr bool k_sampleAreaLights = true;		// next event estimation for emissive spheres; false only finds them by chance
+	constexpr float k_emissiveSphereFraction = 0.f;	// fraction of the small spheres that are replaced by lamps
+	constexpr float k_emissiveSphereLuminance = 40000.f;
+	constexpr int k_pointLightCount = 0;
+	constexpr float k_pointLightIntensity = 20000.f;
+	constexpr int k_displayIntervalMs = 100;	// accumulated samples are resolved and presented at most this often; 0 = every pass
+	constexpr bool k_denoise = false;	// default of RenderOptions::denoise
+	constexpr uint32_t k_seed = 1;	// default of RenderOptions::sceneSeed and sampleSeed; the scene layout and the render samples are pure functions of these
+	constexpr BvhLayout k_bvhLayout = BvhLayout::Full;	// quantized layouts trade some traversal work for a much smaller tree
+	constexpr bool k_bvhSpatialSplits = true;	// SBVH: split large spheres into the parts on either side of a node boundary
+	constexpr bool k_replicateScenePerNode = true;	// copy the BVH and spheres into every NUMA node's local memory
+	constexpr TileOrder k_tileOrder = TileOrder::Spiral;	// clicking the image switches to TileOrder::Focus around the click
+	constexpr bool k_primaryRayPackets = true;	// primary rays of 8x8 pixel blocks traverse the BVH together
+	constexpr size_t k_sceneCacheSize = 4;	// scenes a render server keeps built, see SceneCache
+	constexpr uint32_t k_radianceCacheSamples = 0;	// default of RenderOptions::radianceCacheSamples, 0 = no radiance cache
+	constexpr float k_radianceCacheCellSize = 0.05f;
+	constexpr bool k_pathGuiding = false;	// default of RenderOptions::pathGuiding
 }
 
+class SpheresScene;
+
+// Lamps of a scene layout, by default the AppSettings ones. Those add none, so -lamps sets up scenes that exercise
+// light sampling.
+struct SceneLighting
+{
+	float emissiveSphereFraction = AppSettings::k_emissiveSphereFraction;
+	int pointLightCount = AppSettings::k_pointLightCount;
+	bool sampleAreaLights = AppSettings::k_sampleAreaLights;
+};
+
+// Camera of one view. Views of a job share the scene, BVH and worker pool; each accumulates its own image.
+struct ViewDesc
+{
+	XMFLOAT3 origin{ 12.f, 2.f, -2.5f };
+	XMFLOAT3 lookAt{ 0.f, 1.f, 0.f };
+	float verticalFov = AppSettings::k_verticalFov;
+	std::string outputPath;	// headless runs write the view's mean here as PFM
+};
+
+// Settings chosen per run, e.g. on the command line
+struct RenderOptions
+{
+	uint32_t width = AppSettings::k_backbufferWidth;
+	uint32_t height = AppSettings::k_backbufferHeight;
+	// Only pixels inside the crop window are traced, with the camera still mapping the full frame, so crops of
+	// one frame rendered separately match the full render exactly. Pixels outside the window stay black.
+	std::optional<PixelRect> crop;
+	TileOrder tileOrder = AppSettings::k_tileOrder;
+	XMUINT2 focus{ 0, 0 };	// pixel for TileOrder::Focus
+	uint32_t sceneSeed = AppSettings::k_seed;
+	uint32_t sampleSeed = AppSettings::k_seed;
+	SceneLighting lighting;
+	// Image on the large diffuse sphere, a tiled image or a PPM that is converted to one. The sphere keeps its
+	// flat color when the image cannot be loaded.
+	std::string texturePath;
+	std::wstring shareName;	// also publish display images in this named section, see SharedFramebuffer
+
+	// Paths end in the RadianceCache after a diffuse bounce once the cell they reach has averaged this many
+	// samples; 0 traces every path in full. Fewer samples and larger cells are faster and more biased.
+	uint32_t radianceCacheSamples = AppSettings::k_radianceCacheSamples;
+	float radianceCacheCellSize = AppSettings::k_radianceCacheCellSize;
+	// Learn where light comes from over the first passes and sample diffuse bounces towards it, see PathGuide
+	bool pathGuiding = AppSettings::k_pathGuiding;
+	// Filter the accumulated image guided by first-hit albedo, normal and depth before display. Benchmarks
+	// then also measure the filtered image and the time plain accumulation takes to match it.
+	bool denoise = AppSettings::k_denoise;
+
+	// The window shows the first view. Views with output paths make a headless multi-view job: stereo pairs,
+	// turntables or cube maps rendered in one run, with tiles of all views in one scheduler queue.
+	std::vector<ViewDesc> views{ ViewDesc{} };
+
+	// Headless runs, see SpheresApp::RunHeadless
+	std::string referencePath;		// render sampleLimit samples per pixel of the first view and write the mean here as PFM
+	uint32_t sampleLimit = 4096;	// samples per pixel of reference and multi-view renders, at most those of a benchmark
+	double timeLimit = 0.0;			// seconds of rendering after which any of those end early, 0 = no limit
+	std::string runStatsPath;		// those append their view count, scene build and render time and ray rate here as CSV
+	std::string benchmarkReference;	// measure time to quality against this PFM reference
+	std::string benchmarkOutput = "time-to-quality.csv";
+	std::vector<double> timeBudgets{ 1, 2, 5, 10, 30, 60 };
+	std::vector<uint32_t> sampleCheckpoints{ 1, 2, 4, 8, 16, 32, 64, 128, 256 };
+
+	// Render server, see RenderServer
+	std::wstring serveName;	// serve jobs on this pipe instead of rendering
+	int priority = 0;		// jobs with a higher priority run first
+
+	// Command line syntax, also used for render server jobs
+	static RenderOptions Parse(const std::string& args);
+};
+
 class SpheresApp : public RayTracingApp
 {
+public:
+	explicit SpheresApp(const RenderOptions& options = RenderOptions{});
+	// Job of a render server: traces on the server's workers and renders one of its cached scenes
+	SpheresApp(const RenderOptions& options, WorkerPool& workers, std::shared_ptr<const SpheresScene> scene);
+
+	bool IsHeadless() const
+	{
+		return !m_options.referencePath.empty() || !m_options.benchmarkReference.empty() ||
+			std::any_of(m_options.views.cbegin(), m_options.views.cend(), [](const ViewDesc& view) { return !view.outputPath.empty(); });
+	}
+
+	// After InitializeHeadless: writes the reference or every view's image, or renders until every benchmark
+	// checkpoint was measured and writes the error curve. Returns the process exit code.
+	int RunHeadless();
+
+	// Render server jobs, after InitializeHeadless: one pass on the calling thread. Returns false once the
+	// sample or time limit is reached.
+	bool RenderJobPass();
+	size_t GetSampleCount() const { return m_sampleCount; }
+	double GetRenderSeconds() const;
+
+	// Writes the views that have an output path
+	bool WriteOutputs() const;
+	// Appends one line to runStatsPath, so multi-view jobs can be compared with one run per view
+	bool AppendRunStats() const;
+	uint32_t GetViewCount() const { return static_cast<uint32_t>(m_views.size()); }
+	const std::string& GetOutputPath(uint32_t view) const { return m_views[view].outputPath; }
+	const Framebuffer& GetImage(uint32_t view) const { return view == 0 ? m_backbufferHdr : m_views[view].hdr; }
+	// Mean radiance in row-major order, as written to PFM
+	static std::vector<XMFLOAT3> GetTexels(const Framebuffer& image);
+
 private:
+	SpheresApp(const RenderOptions& options, std::unique_ptr<WorkerPool> workers);
+
 	void OnInitialize(HWND hWnd) override;
-	void OnRender(HWND hWnd) override;
+	void OnRenderPass(XMCOLOR* ldr) override;
+	void OnPresent(HWND hWnd) override;
 	int GetBackBufferWidth() const override;
 	int GetBackBufferHeight() const override;
+	std::chrono::milliseconds GetPresentInterval() const override;
+	void OnClick(int x, int y) override;
 
-	void InitScene();
-	void InitCamera();
+	void InitViews();
+	void MeasureBvhTraversal();
 
-	size_t DrawBitmap(HWND hWnd);
-	void DisplayStats(HWND hWnd, size_t rayCount, double timeElapsed) const;
+	// Traces one sample per pixel of every view. With an ldr image each tile of the first view is also resolved
+	// by the worker that traced it.
+	size_t TracePass(XMCOLOR* ldr, double& outFirstPixelMs);
+	void ResolveDenoised(XMCOLOR* ldr);
+	void DisplayStats(HWND hWnd) const;
 
 	std::optional<Payload> GetClosestIntersection(const Ray& ray) const;
-	XMVECTOR GetHitColor(const Ray& ray, int depth) const;
+	// Path tracing integrator, instantiated for every SceneFeature combination
+	template <uint32_t Features>
+	XMVECTOR GetHitColor(const Ray& ray, const XMVECTOR& viewOrigin, int depth, float scatterPdf, SampleContext& sampler, SurfaceAovs* outAovs) const;
+	// The same for a ray whose closest hit is already known, e.g. from a primary ray packet
+	template <uint32_t Features>
+	XMVECTOR ShadePath(const Ray& ray, const std::optional<Payload>& hitInfo, const XMVECTOR& viewOrigin, int depth, float scatterPdf, SampleContext& sampler, SurfaceAovs* outAovs) const;
+
+	using HitColorFunction = XMVECTOR(SpheresApp::*)(const Ray&, const std::optional<Payload>&, const XMVECTOR&, int, float, SampleContext&, SurfaceAovs*) const;
+
+	template <size_t... Features>
+	static constexpr std::array<HitColorFunction, sizeof...(Features)> MakeHitColorTable(std::index_sequence<Features...>)
+	{
+		return { &SpheresApp::ShadePath<Features>... };
+	}
+
+	struct View
+	{
+		std::unique_ptr<Camera> camera;
+		float pixelSpread;	// angle subtended by one pixel, the spread of primary ray cones
+		uint32_t sampleSeed;
+		Framebuffer hdr;	// unused by the first view, which accumulates into m_backbufferHdr
+		std::string outputPath;
+	};
+
+	Framebuffer& GetFramebuffer(uint32_t view) { return view == 0 ? m_backbufferHdr : m_views[view].hdr; }
+
+	// Primary rays for the pixels of a block of at most RayPacket::k_size squared, in row-major order
+	void GenerateRays(const View& view, const PixelRect& block, uint32_t sampleIndex, RayPacket& outPacket) const;
+
+	// Sampler dimensions consumed by GenerateRays (pixel jitter and lens); paths continue from here
+	static constexpr uint32_t k_cameraDimensions = 2;
+
+	// Written by the render thread after every pass, read by the UI thread when it presents
+	struct PassStats
+	{
+		size_t sampleCount = 0;
+		size_t rayCount = 0;
+		double passMicroseconds = 0.0;
+		double totalSeconds = 0.0;
+		size_t totalRayCount = 0;
+		double denoiseMs = 0.0;
+		double firstPixelMs = 0.0;	// from the start of the pass until its first tile was flushed
+		double firstImageMs = 0.0;	// from the start of rendering until the first image was complete
+		PathGuide::Stats guide{};	// the guide changes between passes, so the UI thread only sees this copy
+	};
 
-	std::vector<std::pair<Ray, int>> GenerateRays() const;
+	static constexpr uint64_t k_noFocus = ~uint64_t{ 0 };
 
 private:
-	std::unique_ptr<Camera> m_camera;
-	std::vector<std::unique_ptr<Hitable>> m_scene;
-	std::vector<std::unique_ptr<Texture>> m_textures;
-	std::vector<std::unique_ptr<Light>> m_lights;
-	std::unique_ptr<BvhNode> m_bvh;
-	std::unique_ptr<Material> m_skyMaterial;
+	RenderOptions m_options;
+	PixelRect m_crop;	// whole frame without a crop window
+	std::vector<uint32_t> m_tileOrder;	// tiles overlapping m_crop, the same for every view; render thread only
+	std::atomic<uint64_t> m_pendingFocus{ k_noFocus };	// clicked pixel, x in the high half, for the render thread
+	std::chrono::steady_clock::time_point m_renderStart;
+	std::vector<View> m_views;
+	std::unique_ptr<WorkerPool> m_ownWorkers;	// unless a render server lends its workers
+	WorkerPool& m_workers;
+	std::shared_ptr<const SpheresScene> m_scene;	// built in OnInitialize unless a render server lends it
+	Bvh::TraversalStats m_bvhTraversal;	// primary ray costs measured after the build, windowed runs only
+	uint32_t m_bvhProbeRayCount = 0;
+	HitColorFunction m_hitColor = &SpheresApp::ShadePath<SceneFeature::All>;
+	std::unique_ptr<RadianceCache> m_radianceCache;	// per job, since its bias is a job setting
+	std::unique_ptr<PathGuide> m_pathGuide;	// trained by the job's own first passes
 	float m_exposure;
 	size_t m_sampleCount = 0;
+	Resolver m_resolver;
+	Denoiser m_denoiser{ DenoiserSettings{} };
+	Framebuffer m_denoised;
+	double m_denoiseTimeMs = 0.0;
+	bool m_shareFailed = false;	// the -share section could not be created, e.g. because the name is taken
+	mutable std::mutex m_passStatsMutex;
+	PassStats m_passStats;
 };
@@ -0,0 +1,214 @@
+#include "spheres-scene.h"
+
+SpheresScene::SpheresScene(const uint32_t seed, WorkerPool& workers, const SceneLighting& lighting, const std::string& texturePath) :
+	m_seed{ seed },
+	m_lighting{ lighting },
+	m_texturePath{ texturePath }
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	Random::Stream generator(seed);
+	auto uniform = [&generator]() { return generator.NextFloat(); };
+
+	m_spheres.reserve(500);
+
+	// Floor
+	const uint32_t floorMaterial = m_materials.Add(Material::DielectricOpaque(Texture::Checker(XMCOLOR{ 0.9f, 0.9f, 0.9f, 1.f }, XMCOLOR{ 0.2f, 0.3f, 0.1f, 1.f }, 2500.f), 16.f));
+	AddSphere(XMVECTORF32{ 0, -1000, 0 }, 1000.f, floorMaterial);
+
+	// Random small spheres
+	for (int a = -11; a < 11; ++a)
+	{
+		for (int b = -11; b < 11; ++b)
+		{
+			const float chooseMat = uniform();
+			XMVECTORF32 center{ a + 0.9f * uniform(), 0.2f, b + 0.9f * uniform() };
+
+			// Only draw from the generator when enabled so the default scene stays the same
+			if (m_lighting.emissiveSphereFraction > 0.f && uniform() < m_lighting.emissiveSphereFraction)
+			{
+				AddSphere(center, 0.2f, m_materials.Add(Material::Emissive(AppSettings::k_emissiveSphereLuminance, Texture::Const(XMCOLOR{ 1.f, 0.85f, 0.6f, 1.f }))));
+			}
+			else if (chooseMat < 0.8f)
+			{
+				const Texture albedo = Texture::Const(
+					XMCOLOR{
+						uniform() * uniform(),
+						uniform() * uniform(),
+						uniform() * uniform(),
+						1.f
+					});
+
+				float smoothness = 8.f * (4.f + uniform());
+
+				AddSphere(center, 0.2f, m_materials.Add(Material::DielectricOpaque(albedo, smoothness)));
+			}
+			else if (chooseMat < 0.95f)
+			{
+				const Texture reflectance = Texture::Const(
+					XMCOLOR{
+						0.5f * (1.f + uniform()),
+						0.5f * (1.f + uniform()),
+						0.5f * (1.f + uniform()),
+						1.f
+					}
+				);
+
+				AddSphere(center, 0.2f, m_materials.Add(Material::Metal(reflectance, 0.f)));
+			}
+			else
+			{
+				float smoothness = 8.f * (4.f + uniform());
+
+				AddSphere(center, 0.2f, m_materials.Add(Material::DielectricTransparent(smoothness, 1.5f)));
+			}
+		}
+	}
+
+	// Large spheres
+	AddSphere(XMVECTORF32{ 0, 1, 0 }, 1.f, m_materials.Add(Material::DielectricTransparent(16.f, 1.5f)));
+
+	// The brown sphere wears the -texture image, whose tiles stream in through the TextureCache
+	const uint32_t imageId = m_texturePath.empty() ? k_invalidId : LoadTexture(m_texturePath);
+	const Texture bigAlbedo = imageId != k_invalidId ? Texture::Image(imageId) : Texture::Const(XMCOLOR{ 0.4f, 0.2f, 0.1f, 1.f });
+	AddSphere(XMVECTORF32{ -4, 1, 0 }, 1.f, m_materials.Add(Material::DielectricOpaque(bigAlbedo, 16.f)));
+	AddSphere(XMVECTORF32{ 4, 1, 0 }, 1.f, m_materials.Add(Material::Metal(Texture::Const(XMCOLOR{ 0.7f, 0.6f, 0.5f, 1.f }), 0.f)));
+
+	// Construct BVH. The arena holds the only copy of the spheres from here on.
+	BvhSettings bvhSettings;
+	bvhSettings.layout = AppSettings::k_bvhLayout;
+	bvhSettings.spatialSplits = AppSettings::k_bvhSpatialSplits;
+
+	m_bvh.Build(m_spheres, m_sceneArena, bvhSettings);
+	m_spheres = {};
+
+	// Each node's copy is written by one of its own workers so its pages are local to that node
+	if (AppSettings::k_replicateScenePerNode && workers.GetNodeCount() > 1)
+	{
+		m_nodeArenas.resize(workers.GetNodeCount());
+		m_nodeBvhs.resize(workers.GetNodeCount());
+
+		workers.ForEachNode([this](uint32_t node)
+		{
+			m_nodeArenas[node] = std::make_unique<Arena>();
+			m_nodeBvhs[node] = m_bvh.CopyTo(*m_nodeArenas[node]);
+		});
+	}
+
+	auto lightOcclusionTest = [this](const Ray& ray) -> bool
+	{
+		Payload dummy{};
+		return GetBvh().Intersect(ray, dummy);
+	};
+
+	auto closestIntersection = [this](const Ray& ray, Payload& payload) -> bool
+	{
+		return GetBvh().Intersect(ray, payload);
+	};
+
+	// Sun
+	m_lights.push_back(std::make_unique<DirectionalLight>(XMVECTORF32{ 1.f, 1.f, 1.f }, XMCOLOR{ 1.f, 0.97f, 0.88f, 1.f }, 40000.f, lightOcclusionTest));
+
+	// Sky
+	std::vector<XMFLOAT3> skyRadiance;
+	uint32_t skyWidth, skyHeight;
+	if (!ImageIO::ReadRadianceHdr(AppSettings::k_environmentMapPath, skyRadiance, skyWidth, skyHeight))
+	{
+		// Constant sky color
+		skyWidth = 64;
+		skyHeight = 32;
+		skyRadiance.assign(skyWidth * skyHeight, XMFLOAT3{ 0.85f, 0.91f, 0.98f });
+	}
+
+	auto sky = std::make_unique<EnvironmentLight>(std::move(skyRadiance), skyWidth, skyHeight, 8000.f, lightOcclusionTest);
+	m_environment = sky.get();
+	m_lights.push_back(std::move(sky));
+
+	// Street lamps
+	for (int i = 0; i < m_lighting.pointLightCount; ++i)
+	{
+		const XMVECTORF32 pos{ 22.f * uniform() - 11.f, 0.5f + uniform(), 22.f * uniform() - 11.f };
+		m_lights.push_back(std::make_unique<PointLight>(pos, XMCOLOR{ 1.f, 0.8f, 0.5f, 1.f }, AppSettings::k_pointLightIntensity, closestIntersection));
+	}
+
+	m_lightBvh.Build(m_lights);
+
+	m_features = m_materials.GetFeatures() | (m_lightBvh.GetNodeCount() > 0 ? SceneFeature::BoundedLights : 0u);
+
+	m_buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void SpheresScene::AddSphere(const XMVECTOR& center, const float radius, const uint32_t materialId)
+{
+	Sphere sphere(center, radius, materialId);
+
+	// Emissive spheres are sampled explicitly as area lights
+	if (m_lighting.sampleAreaLights && m_materials.Get(materialId).type == MaterialType::Emissive)
+	{
+		auto closestIntersection = [this](const Ray& ray, Payload& payload) -> bool
+		{
+			return GetBvh().Intersect(ray, payload);
+		};
+
+		sphere.lightId = static_cast<uint32_t>(m_lights.size());
+		m_lights.push_back(std::make_unique<SphereLight>(sphere, sphere.lightId, m_materials, closestIntersection));
+	}
+
+	m_spheres.push_back(sphere);
+}
+
+uint32_t SpheresScene::LoadTexture(const std::string& texturePath)
+{
+	TextureCache& textures = TextureCache::Instance();
+
+	if (const uint32_t imageId = textures.AddImage(texturePath); imageId != k_invalidId)
+	{
+		return imageId;
+	}
+
+	// A PPM is converted once; delete the tiled file to pick up changes to the PPM
+	const std::string tiledPath = texturePath + ".tiles";
+	if (const uint32_t imageId = textures.AddImage(tiledPath); imageId != k_invalidId)
+	{
+		return imageId;
+	}
+
+	return TiledImage::Convert(texturePath, tiledPath) ? textures.AddImage(tiledPath) : k_invalidId;
+}
+
+const Bvh& SpheresScene::GetBvh() const
+{
+	const uint32_t node = WorkerPool::GetCurrentNode();
+	return node < m_nodeBvhs.size() ? m_nodeBvhs[node] : m_bvh;
+}
+
+SceneCache::SceneCache(const size_t capacity, WorkerPool& workers) :
+	m_capacity{ std::max<size_t>(capacity, 1) },
+	m_workers{ workers }
+{
+}
+
+std::shared_ptr<const SpheresScene> SceneCache::Get(const uint32_t seed, const SceneLighting& lighting, const std::string& texturePath)
+{
+	const Key key = GetKey(seed, lighting, texturePath);
+
+	if (const auto it = m_lookup.find(key); it != m_lookup.end())
+	{
+		++m_stats.hits;
+		m_lru.splice(m_lru.begin(), m_lru, it->second);
+		return *it->second;
+	}
+
+	++m_stats.misses;
+
+	if (m_lru.size() >= m_capacity)
+	{
+		++m_stats.evictions;
+		m_lookup.erase(GetKey(m_lru.back()->GetSeed(), m_lru.back()->GetLighting(), m_lru.back()->GetTexturePath()));
+		m_lru.pop_back();
+	}
+
+	m_lru.push_front(std::make_shared<const SpheresScene>(seed, m_workers, lighting, texturePath));
+	m_lookup[key] = m_lru.begin();
+	return m_lru.front();
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "spheres-app.h"
+
+// Geometry, materials and lights of one scene layout with its BVH and the BVH's per-node replicas. Nothing
+// changes after the build, so any number of jobs render one scene at the same time.
+class SpheresScene
+{
+public:
+	// Lays out the scene from seed. Replicas are written by the workers of each node.
+	SpheresScene(uint32_t seed, WorkerPool& workers, const SceneLighting& lighting = SceneLighting{}, const std::string& texturePath = {});
+
+	SpheresScene(const SpheresScene&) = delete;
+	SpheresScene& operator=(const SpheresScene&) = delete;
+
+	uint32_t GetSeed() const { return m_seed; }
+	const SceneLighting& GetLighting() const { return m_lighting; }
+	const std::string& GetTexturePath() const { return m_texturePath; }
+
+	// Copy of the BVH local to the calling worker's NUMA node
+	const Bvh& GetBvh() const;
+	const MaterialTable& GetMaterials() const { return m_materials; }
+	const std::vector<std::unique_ptr<Light>>& GetLights() const { return m_lights; }
+	const LightBvh& GetLightBvh() const { return m_lightBvh; }
+	const EnvironmentLight& GetEnvironment() const { return *m_environment; }
+	// SceneFeature flags covering everything in the scene
+	uint32_t GetFeatures() const { return m_features; }
+
+	size_t GetArenaBytes() const { return m_sceneArena.GetBytesUsed(); }
+	uint32_t GetCopyCount() const { return 1 + static_cast<uint32_t>(m_nodeBvhs.size()); }
+	double GetBuildMs() const { return m_buildMs; }
+
+private:
+	void AddSphere(const XMVECTOR& center, float radius, uint32_t materialId);
+	// TextureCache image for texturePath, k_invalidId when it cannot be loaded
+	static uint32_t LoadTexture(const std::string& texturePath);
+
+private:
+	uint32_t m_seed;
+	SceneLighting m_lighting;
+	std::string m_texturePath;
+	std::vector<Sphere> m_spheres;	// build input, released once the BVH holds the spheres
+	Arena m_sceneArena;
+	Bvh m_bvh;
+	std::vector<std::unique_ptr<Arena>> m_nodeArenas;
+	std::vector<Bvh> m_nodeBvhs;	// indexed by NUMA node, empty unless replicated
+	MaterialTable m_materials;
+	std::vector<std::unique_ptr<Light>> m_lights;
+	LightBvh m_lightBvh;
+	const EnvironmentLight* m_environment = nullptr;
+	uint32_t m_features = SceneFeature::All;
+	double m_buildMs = 0.0;
+};
+
+// Recently used scenes of a render server, keyed by seed, lighting and texture. Jobs hold their scene, so evicting one that is still
+// being rendered only drops the cache's reference.
+class SceneCache
+{
+public:
+	struct Stats
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+	};
+
+	SceneCache(size_t capacity, WorkerPool& workers);
+
+	// Builds the scene on a miss
+	std::shared_ptr<const SpheresScene> Get(uint32_t seed, const SceneLighting& lighting, const std::string& texturePath);
+	Stats GetStats() const { return m_stats; }
+
+private:
+	using Key = std::tuple<uint32_t, float, int, bool, std::string>;
+
+	static Key GetKey(uint32_t seed, const SceneLighting& lighting, const std::string& texturePath)
+	{
+		return { seed, lighting.emissiveSphereFraction, lighting.pointLightCount, lighting.sampleAreaLights, texturePath };
+	}
+
+private:
+	size_t m_capacity;
+	WorkerPool& m_workers;
+	std::list<std::shared_ptr<const SpheresScene>> m_lru;	// most recently used at the front
+	std::map<Key, std::list<std::shared_ptr<const SpheresScene>>::iterator> m_lookup;
+	Stats m_stats{};
+};
\ No newline at end of file
@@ -3,7 +3,20 @@
 #include "app.h"
 #include "camera.h"
 #include "ray-tracing.h"
+#include "arena.h"
+#include "bvh.h"
 #include "quasi-random.h"
+#include "sampler.h"
 #include "light.h"
+#include "light-bvh.h"
 #include "material.h"
 #include "texture.h"
+#include "texture-cache.h"
+#include "image-io.h"
+#include "resolve.h"
+#include "denoiser.h"
+#include "radiance-cache.h"
+#include "path-guide.h"
+#include "worker-pool.h"
+#include "tile-order.h"
+#include "quality-harness.h"